@@ -0,0 +1,231 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Audio Mixer, fixed pool of voices on top of the loaded sounds
+*
+*   A raylib Sound can only play once at a time, calling PlaySound() on a playing sound
+*   restarts it. To let explosions overlap every effect gets a number of voices that are
+*   aliases of the loaded sound (sharing the sample data). All voices are created up front
+*   so nothing gets allocated while playing. When all voices are busy the oldest voice of
+*   the lowest priority is stolen.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+//----------------------------------------------------------------------------------
+// Mixer Definition
+//----------------------------------------------------------------------------------
+
+// Higher priority effects can steal voices from lower priority ones
+typedef struct EffectConfig {
+    int polyphony;      // Amount of voices reserved for this effect
+    int priority;
+} EffectConfig;
+
+static EffectConfig effectConfig[SOUND_MAX] = {
+    { 4, 3 },   // SOUND_BANG_LARGE
+    { 4, 3 },   // SOUND_BANG_MEDIUM
+    { 6, 2 },   // SOUND_BANG_SMALL
+    { 1, 5 },   // SOUND_BEAT_1
+    { 1, 5 },   // SOUND_BEAT_2
+    { 1, 4 },   // SOUND_EXTRA_SHIP
+    { 4, 1 },   // SOUND_FIRE
+    { 1, 4 },   // SOUND_SAUCER_LARGE
+    { 1, 4 },   // SOUND_SAUCER_SMALL
+    { 1, 4 },   // SOUND_THRUST
+};
+
+#define MIXER_MAX_VOICES 32
+#define MIXER_MAX_ACTIVE 16     // Voices that may play at the same time over all effects
+
+typedef struct Voice {
+    Sound sound;
+    bool isAlias;           // The first voice of an effect uses the loaded sound itself
+    bool looping;           // Gets restarted by UpdateAudioMixer() when it runs out
+    unsigned int started;   // Serial of the last start, lower is older
+} Voice;
+
+typedef struct Mixer {
+    Voice voices[MIXER_MAX_VOICES];
+    int first[SOUND_MAX];   // Index of the first voice for each effect
+    int count[SOUND_MAX];   // Number of voices for each effect
+    int voiceCount;
+    unsigned int serial;
+    int dropped;            // Plays that could not get a voice
+} Mixer;
+
+static Mixer mixer = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static int GetEffectOfVoice(int voice)
+{
+    for (int effect = 0; effect < SOUND_MAX; ++effect) {
+        if (voice >= mixer.first[effect] && voice < mixer.first[effect] + mixer.count[effect]) return effect;
+    }
+    return -1;
+}
+
+static bool IsVoicePlaying(int voice)
+{
+    return mixer.voices[voice].looping || IsSoundPlaying(mixer.voices[voice].sound);
+}
+
+static void StartVoice(int voice, bool looping)
+{
+    Voice* v = &mixer.voices[voice];
+    StopSound(v->sound);
+    v->looping = looping;
+    v->started = ++mixer.serial;
+    PlaySound(v->sound);
+}
+
+// Finds a voice for the effect, prefers idle voices of the effect, then the
+// oldest voice of the effect, returns -1 if there is no voice to be had
+static int AcquireVoice(int effect)
+{
+    int first = mixer.first[effect];
+    int last = first + mixer.count[effect];
+
+    int idle = -1;
+    int oldest = -1;
+    for (int i = first; i < last; ++i) {
+        if (!IsVoicePlaying(i)) {
+            idle = i;
+            break;
+        }
+        if (!mixer.voices[i].looping && (oldest < 0 || mixer.voices[i].started < mixer.voices[oldest].started)) {
+            oldest = i;
+        }
+    }
+
+    // Restarting one of our own voices doesn't change the amount of active voices
+    if (idle < 0) return oldest;
+
+    int active = 0;
+    int victim = -1;
+    int victimPriority = 0;
+    for (int i = 0; i < mixer.voiceCount; ++i) {
+        if (!IsVoicePlaying(i)) continue;
+        ++active;
+        if (mixer.voices[i].looping) continue;
+        int priority = effectConfig[GetEffectOfVoice(i)].priority;
+        if (priority > effectConfig[effect].priority) continue;
+        if (victim < 0 || priority < victimPriority ||
+            (priority == victimPriority && mixer.voices[i].started < mixer.voices[victim].started)) {
+            victim = i;
+            victimPriority = priority;
+        }
+    }
+
+    if (active < MIXER_MAX_ACTIVE) return idle;
+    if (victim < 0) return -1;
+
+    StopSound(mixer.voices[victim].sound);
+    return idle;
+}
+
+//----------------------------------------------------------------------------------
+// Mixer Functions
+//----------------------------------------------------------------------------------
+
+// Creates the voices for all effects, the sounds need to stay loaded
+// until UnloadAudioMixer() was called
+void InitAudioMixer(Sound sounds[], int soundCount)
+{
+    mixer = (Mixer){ 0 };
+    for (int effect = 0; effect < soundCount && effect < SOUND_MAX; ++effect) {
+        mixer.first[effect] = mixer.voiceCount;
+        for (int i = 0; i < effectConfig[effect].polyphony; ++i) {
+            if (mixer.voiceCount >= MIXER_MAX_VOICES) {
+                TraceLog(LOG_WARNING, "Out of voices for effect %i", effect);
+                break;
+            }
+            Voice* voice = &mixer.voices[mixer.voiceCount++];
+            voice->isAlias = (i > 0);
+            voice->sound = voice->isAlias ? LoadSoundAlias(sounds[effect]) : sounds[effect];
+            ++mixer.count[effect];
+        }
+    }
+}
+
+// Releases the aliases, call before unloading the sounds
+void UnloadAudioMixer(void)
+{
+    StopAllEffects();
+    for (int i = 0; i < mixer.voiceCount; ++i) {
+        if (mixer.voices[i].isAlias) UnloadSoundAlias(mixer.voices[i].sound);
+    }
+    mixer = (Mixer){ 0 };
+}
+
+// Plays a one shot effect
+void PlayEffect(int effect)
+{
+    if (effect < 0 || effect >= SOUND_MAX || mixer.count[effect] == 0) return;
+
+    int voice = AcquireVoice(effect);
+    if (voice < 0) {
+        ++mixer.dropped;
+        return;
+    }
+    StartVoice(voice, false);
+}
+
+// Starts an effect that keeps on playing until StopLoopingEffect() is called,
+// does nothing when the effect is already looping
+void StartLoopingEffect(int effect)
+{
+    if (effect < 0 || effect >= SOUND_MAX || mixer.count[effect] == 0) return;
+
+    for (int i = mixer.first[effect]; i < mixer.first[effect] + mixer.count[effect]; ++i) {
+        if (mixer.voices[i].looping) return;
+    }
+
+    int voice = AcquireVoice(effect);
+    if (voice < 0) {
+        ++mixer.dropped;
+        return;
+    }
+    StartVoice(voice, true);
+}
+
+void StopLoopingEffect(int effect)
+{
+    if (effect < 0 || effect >= SOUND_MAX) return;
+
+    for (int i = mixer.first[effect]; i < mixer.first[effect] + mixer.count[effect]; ++i) {
+        if (!mixer.voices[i].looping) continue;
+        mixer.voices[i].looping = false;
+        StopSound(mixer.voices[i].sound);
+    }
+}
+
+void StopAllEffects(void)
+{
+    for (int i = 0; i < mixer.voiceCount; ++i) {
+        mixer.voices[i].looping = false;
+        StopSound(mixer.voices[i].sound);
+    }
+}
+
+// Restarts looping voices that ran out, call once per frame
+void UpdateAudioMixer(void)
+{
+    for (int i = 0; i < mixer.voiceCount; ++i) {
+        Voice* voice = &mixer.voices[i];
+        if (voice->looping && !IsSoundPlaying(voice->sound)) {
+            PlaySound(voice->sound);
+        }
+    }
+}
+
+// Amount of plays that were dropped because no voice could be stolen
+int GetDroppedEffects(void)
+{
+    return mixer.dropped;
+}
@@ -0,0 +1,410 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Canvas, what the gameplay screen draws with: raylib or a software rasterizer
+*
+*   Every Canvas function draws with the raylib call of the same name while no raster is
+*   set, so the game on the GPU draws exactly as before. With SetCanvasRaster() the same
+*   calls rasterize into a CPU framebuffer instead, which needs no window and no GPU, for
+*   frame captures on build machines and for rendering recordings to video.
+*
+*   Lines are clipped to the raster first, so the inner loops don't check bounds. The
+*   line kernel steps the major axis one pixel at a time and computes the minor axis of
+*   every pixel from its index in 16.16 fixed point, there is no error term carried from
+*   pixel to pixel. Fills go row by row. Text is drawn from the glyph quads of the text
+*   layout cache, sampling the font atlas kept in CPU memory (see LoadRasterFont()).
+*
+*   Everything drawn also marks the RASTER_TILE squares it touches, so effects over the
+*   finished frame (glow.c) only need to look at the few tiles the line art is in.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Canvas Definition
+//----------------------------------------------------------------------------------
+#define RASTER_MAX_ATLASES 4
+#define RASTER_ATLAS_ID 0x40000000      // Texture ids of atlases only the rasterizer knows
+
+// Font atlas in CPU memory, always R8G8B8A8
+typedef struct RasterAtlas {
+    unsigned int id;
+    Image image;
+} RasterAtlas;
+
+static Raster* canvasRaster = NULL;
+static RasterAtlas rasterAtlases[RASTER_MAX_ATLASES] = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static bool IsOpaque(Color color)
+{
+    return color.a == 255;
+}
+
+// src over dst, exact to one step of 255
+static Color BlendPixel(Color dst, Color src)
+{
+    unsigned int a = src.a;
+    unsigned int na = 255 - a;
+    return (Color){
+        (unsigned char)(((src.r * a + dst.r * na + 128) * 257) >> 16),
+        (unsigned char)(((src.g * a + dst.g * na + 128) * 257) >> 16),
+        (unsigned char)(((src.b * a + dst.b * na + 128) * 257) >> 16),
+        (unsigned char)(a + ((dst.a * na + 128) * 257 >> 16)) };
+}
+
+// Tiles of pixels x0..x1 of row y, which has to be inside the raster
+static void MarkTiles(Raster* raster, int x0, int x1, int y)
+{
+    unsigned char* tiles = raster->tiles + (y / RASTER_TILE) * raster->tileWidth;
+    for (int t = x0 / RASTER_TILE; t <= x1 / RASTER_TILE; ++t) tiles[t] = 1;
+}
+
+static void PlotPixel(Raster* raster, int x, int y, Color color)
+{
+    if (x < 0 || y < 0 || x >= raster->width || y >= raster->height) return;
+    Color* pixel = &raster->pixels[y * raster->width + x];
+    *pixel = IsOpaque(color) ? color : BlendPixel(*pixel, color);
+    raster->tiles[(y / RASTER_TILE) * raster->tileWidth + x / RASTER_TILE] = 1;
+}
+
+// Pixels x0..x1 of row y, clipped
+static void FillSpan(Raster* raster, int x0, int x1, int y, Color color)
+{
+    if (y < 0 || y >= raster->height) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= raster->width) x1 = raster->width - 1;
+    if (x0 > x1) return;
+    MarkTiles(raster, x0, x1, y);
+    Color* row = &raster->pixels[y * raster->width];
+    if (IsOpaque(color)) {
+        for (int x = x0; x <= x1; ++x) row[x] = color;
+    }
+    else {
+        for (int x = x0; x <= x1; ++x) row[x] = BlendPixel(row[x], color);
+    }
+}
+
+// Liang-Barsky, cuts the line down to the part inside 0..maxX, 0..maxY
+static bool ClipLine(Vector2* start, Vector2* end, float maxX, float maxY)
+{
+    float dx = end->x - start->x;
+    float dy = end->y - start->y;
+    float p[4] = { -dx, dx, -dy, dy };
+    float q[4] = { start->x, maxX - start->x, start->y, maxY - start->y };
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) return false;
+            continue;
+        }
+        float t = q[i] / p[i];
+        if (p[i] < 0.0f) {
+            if (t > t1) return false;
+            if (t > t0) t0 = t;
+        }
+        else {
+            if (t < t0) return false;
+            if (t < t1) t1 = t;
+        }
+    }
+    *end = (Vector2){ start->x + t1 * dx, start->y + t1 * dy };
+    *start = (Vector2){ start->x + t0 * dx, start->y + t0 * dy };
+    return true;
+}
+
+static int ClampPixel(float value, int max)
+{
+    int pixel = (int)value;
+    return (pixel < 0) ? 0 : (pixel > max) ? max : pixel;
+}
+
+static void RasterLine(Raster* raster, Vector2 start, Vector2 end, Color color)
+{
+    int maxX = raster->width - 1;
+    int maxY = raster->height - 1;
+    if (!ClipLine(&start, &end, (float)maxX, (float)maxY)) return;
+
+    int x0 = ClampPixel(start.x, maxX);
+    int y0 = ClampPixel(start.y, maxY);
+    int x1 = ClampPixel(end.x, maxX);
+    int y1 = ClampPixel(end.y, maxY);
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    int steps = (abs(dx) > abs(dy)) ? abs(dx) : abs(dy);
+    if (steps == 0) {
+        PlotPixel(raster, x0, y0, color);
+        return;
+    }
+
+    // The major axis moves exactly one pixel per step, the minor one stays between
+    // its end points, so every pixel is inside the raster
+    int stepX = dx * 65536 / steps;
+    int stepY = dy * 65536 / steps;
+    int fixedX = x0 * 65536 + 32768;
+    int fixedY = y0 * 65536 + 32768;
+    Color* pixels = raster->pixels;
+    unsigned char* tiles = raster->tiles;
+    int width = raster->width;
+    int tileWidth = raster->tileWidth;
+    if (IsOpaque(color)) {
+        for (int i = 0; i <= steps; ++i) {
+            int x = (fixedX + i * stepX) >> 16;
+            int y = (fixedY + i * stepY) >> 16;
+            pixels[y * width + x] = color;
+            tiles[(y / RASTER_TILE) * tileWidth + x / RASTER_TILE] = 1;
+        }
+    }
+    else {
+        for (int i = 0; i <= steps; ++i) {
+            int x = (fixedX + i * stepX) >> 16;
+            int y = (fixedY + i * stepY) >> 16;
+            Color* pixel = &pixels[y * width + x];
+            *pixel = BlendPixel(*pixel, color);
+            tiles[(y / RASTER_TILE) * tileWidth + x / RASTER_TILE] = 1;
+        }
+    }
+}
+
+static const RasterAtlas* FindRasterAtlas(unsigned int id)
+{
+    for (int i = 0; i < RASTER_MAX_ATLASES; ++i) {
+        if (rasterAtlases[i].id == id && id != 0) return &rasterAtlases[i];
+    }
+    return NULL;
+}
+
+// Nearest texel of source for every pixel whose center is inside dest, tinted
+static void RasterTexture(Raster* raster, const RasterAtlas* atlas, Rectangle source, Rectangle dest, Color tint)
+{
+    if (dest.width <= 0 || dest.height <= 0) return;
+    int x0 = (int)ceilf(dest.x - 0.5f);
+    int y0 = (int)ceilf(dest.y - 0.5f);
+    int x1 = (int)ceilf(dest.x + dest.width - 0.5f) - 1;
+    int y1 = (int)ceilf(dest.y + dest.height - 0.5f) - 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= raster->width) x1 = raster->width - 1;
+    if (y1 >= raster->height) y1 = raster->height - 1;
+
+    const Color* texels = (const Color*)atlas->image.data;
+    int texWidth = atlas->image.width;
+    int texHeight = atlas->image.height;
+    float scaleX = source.width / dest.width;
+    float scaleY = source.height / dest.height;
+    for (int y = y0; y <= y1; ++y) {
+        int v = (int)(source.y + (y + 0.5f - dest.y) * scaleY);
+        if (v < 0 || v >= texHeight) continue;
+        MarkTiles(raster, x0, x1, y);
+        Color* row = &raster->pixels[y * raster->width];
+        for (int x = x0; x <= x1; ++x) {
+            int u = (int)(source.x + (x + 0.5f - dest.x) * scaleX);
+            if (u < 0 || u >= texWidth) continue;
+            Color texel = texels[v * texWidth + u];
+            if (texel.a == 0) continue;
+            Color color = { (unsigned char)(texel.r * tint.r / 255), (unsigned char)(texel.g * tint.g / 255),
+                (unsigned char)(texel.b * tint.b / 255), (unsigned char)(texel.a * tint.a / 255) };
+            row[x] = IsOpaque(color) ? color : BlendPixel(row[x], color);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------
+// Raster Functions
+//----------------------------------------------------------------------------------
+
+Raster LoadRaster(int width, int height)
+{
+    Raster raster = { 0 };
+    int tileWidth = (width + RASTER_TILE - 1) / RASTER_TILE;
+    int tileHeight = (height + RASTER_TILE - 1) / RASTER_TILE;
+    raster.pixels = (Color*)RL_CALLOC((size_t)width * height, sizeof(Color));
+    raster.tiles = (unsigned char*)RL_CALLOC((size_t)tileWidth * tileHeight, 1);
+    if (raster.pixels == NULL || raster.tiles == NULL) {
+        RL_FREE(raster.pixels);
+        RL_FREE(raster.tiles);
+        return (Raster){ 0 };
+    }
+    raster.width = width;
+    raster.height = height;
+    raster.tileWidth = tileWidth;
+    return raster;
+}
+
+void UnloadRaster(Raster* raster)
+{
+    if (canvasRaster == raster) canvasRaster = NULL;
+    RL_FREE(raster->pixels);
+    RL_FREE(raster->tiles);
+    *raster = (Raster){ 0 };
+}
+
+// Fills the first row, the others are copies of it. Black leaves no tile marked
+void ClearRaster(Raster* raster, Color color)
+{
+    if (raster->height <= 0) return;
+    int tileHeight = (raster->height + RASTER_TILE - 1) / RASTER_TILE;
+    memset(raster->tiles, (color.r | color.g | color.b) != 0, (size_t)raster->tileWidth * tileHeight);
+    for (int x = 0; x < raster->width; ++x) raster->pixels[x] = color;
+    size_t rowSize = (size_t)raster->width * sizeof(Color);
+    for (int y = 1; y < raster->height; ++y) {
+        memcpy(&raster->pixels[y * raster->width], raster->pixels, rowSize);
+    }
+}
+
+bool ExportRaster(const Raster* raster, const char* fileName)
+{
+    Image image = { raster->pixels, raster->width, raster->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+    return ExportImage(image, fileName);
+}
+
+// The Canvas functions draw into the raster from now on, NULL draws with raylib again
+void SetCanvasRaster(Raster* raster)
+{
+    canvasRaster = raster;
+}
+
+// Loads a font the way LoadFontEx() does, but keeps the atlas in CPU memory for the
+// rasterizer. It needs no GPU, its texture id only names the atlas for the rasterizer,
+// so it can't be drawn with raylib
+Font LoadRasterFont(const char* fileName, int fontSize)
+{
+    Font font = { 0 };
+    int slot = 0;
+    while (slot < RASTER_MAX_ATLASES && rasterAtlases[slot].id != 0) ++slot;
+    if (slot == RASTER_MAX_ATLASES) return font;
+
+    int dataSize = 0;
+    unsigned char* fileData = LoadFileData(fileName, &dataSize);
+    if (fileData == NULL) return font;
+    font.baseSize = fontSize;
+    font.glyphCount = 95;
+    font.glyphPadding = 4;
+    font.glyphs = LoadFontData(fileData, dataSize, fontSize, NULL, font.glyphCount, FONT_DEFAULT);
+    UnloadFileData(fileData);
+    if (font.glyphs == NULL) return (Font){ 0 };
+
+    Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, font.glyphCount, fontSize, font.glyphPadding, 0);
+    ImageFormat(&atlas, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    rasterAtlases[slot] = (RasterAtlas){ RASTER_ATLAS_ID + slot, atlas };
+    font.texture = (Texture2D){ RASTER_ATLAS_ID + slot, atlas.width, atlas.height, 1, atlas.format };
+    return font;
+}
+
+void UnloadRasterFont(Font font)
+{
+    for (int i = 0; i < RASTER_MAX_ATLASES; ++i) {
+        if (rasterAtlases[i].id == font.texture.id && font.texture.id != 0) {
+            UnloadImage(rasterAtlases[i].image);
+            rasterAtlases[i] = (RasterAtlas){ 0 };
+        }
+    }
+    UnloadFontData(font.glyphs, font.glyphCount);
+    RL_FREE(font.recs);
+}
+
+//----------------------------------------------------------------------------------
+// Canvas Functions
+//----------------------------------------------------------------------------------
+
+void CanvasLine(Vector2 start, Vector2 end, Color color)
+{
+    if (canvasRaster == NULL) DrawLineV(start, end, color);
+    else RasterLine(canvasRaster, start, end, color);
+}
+
+void CanvasLineStrip(const Vector2* points, int pointCount, Color color)
+{
+    if (canvasRaster == NULL) {
+        DrawLineStrip((Vector2*)points, pointCount, color);
+        return;
+    }
+    for (int i = 1; i < pointCount; ++i) {
+        RasterLine(canvasRaster, points[i - 1], points[i], color);
+    }
+}
+
+void CanvasCircle(int centerX, int centerY, float radius, Color color)
+{
+    if (canvasRaster == NULL) {
+        DrawCircle(centerX, centerY, radius, color);
+        return;
+    }
+    int r = (int)radius;
+    for (int y = -r; y <= r; ++y) {
+        int half = (int)sqrtf(radius * radius - (float)(y * y));
+        FillSpan(canvasRaster, centerX - half, centerX + half, centerY + y, color);
+    }
+}
+
+void CanvasCircleLines(int centerX, int centerY, float radius, Color color)
+{
+    if (canvasRaster == NULL) {
+        DrawCircleLines(centerX, centerY, radius, color);
+        return;
+    }
+
+    // Midpoint circle, eight octants at a time
+    int x = (int)radius;
+    int y = 0;
+    int error = 1 - x;
+    while (x >= y) {
+        int octants[8][2] = { { x, y }, { y, x }, { -y, x }, { -x, y }, { -x, -y }, { -y, -x }, { y, -x }, { x, -y } };
+        for (int o = 0; o < 8; ++o) PlotPixel(canvasRaster, centerX + octants[o][0], centerY + octants[o][1], color);
+        ++y;
+        if (error < 0) error += 2 * y + 1;
+        else {
+            --x;
+            error += 2 * (y - x) + 1;
+        }
+    }
+}
+
+void CanvasRectangleLines(int posX, int posY, int width, int height, Color color)
+{
+    if (canvasRaster == NULL) {
+        DrawRectangleLines(posX, posY, width, height, color);
+        return;
+    }
+    if (width <= 0 || height <= 0) return;
+    FillSpan(canvasRaster, posX, posX + width - 1, posY, color);
+    FillSpan(canvasRaster, posX, posX + width - 1, posY + height - 1, color);
+    for (int y = posY + 1; y < posY + height - 1; ++y) {
+        PlotPixel(canvasRaster, posX, y, color);
+        PlotPixel(canvasRaster, posX + width - 1, y, color);
+    }
+}
+
+void CanvasTexture(Texture2D texture, Rectangle source, Rectangle dest, Color tint)
+{
+    if (canvasRaster == NULL) {
+        DrawTexturePro(texture, source, dest, (Vector2){ 0, 0 }, 0.0f, tint);
+        return;
+    }
+    const RasterAtlas* atlas = FindRasterAtlas(texture.id);
+    if (atlas != NULL) RasterTexture(canvasRaster, atlas, source, dest, tint);
+}
+
+// Text that isn't in the layout cache, the rasterizer draws at most TEXT_LAYOUT_MAX_GLYPHS
+// glyphs of it
+void CanvasText(Font font, const char* text, Vector2 position, float fontSize, float spacing, Color tint)
+{
+    if (canvasRaster == NULL) {
+        DrawTextEx(font, text, position, fontSize, spacing, tint);
+        return;
+    }
+    static TextLayout layout = { 0 };
+    if (LayoutText(&layout, font, TextSubtext(text, 0, TEXT_LAYOUT_MAX_GLYPHS), fontSize, spacing)) {
+        DrawTextLayout(&layout, position, tint);
+    }
+}
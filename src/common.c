@@ -4,150 +4,167 @@
 #include "raylib.h"
 #include "screens.h"
 
-// Local Function to fill scores with default values
-static void SetDefaultScores(Highscore scores[], int maxScores)
+// Utility function to draw a text line that's centered horizontally on the screen
+void DrawTextLineCentered(Font font, const char* text, float y, float spacing)
 {
-    int high = 15000;
-    for (int i = 0; i < maxScores; ++i) {
-        
-        TextCopy(scores[i].name, "HAS");
-        TextCopy(scores[i].score, TextFormat("%i", high));
-        high -= 2000;
-    }
+    Vector2 pos = MeasureTextCached(font, text, (float)font.baseSize * 1.0f, 1.0f);
+    pos.y = y;
+    pos.x = (VIEW_WIDTH - pos.x) / 2.0f;
+    DrawTextCached(font, text, pos, (float)font.baseSize, 1.0f, WHITE);
 }
 
-// Loads values for key board input from file into given map array
-void LoadControlMap(const char* fileName, int map[], int maxEntries) {
-    int size = 0;
-    unsigned char *mapData = LoadFileData(fileName, &size);
-    if (mapData == 0) {
-        TraceLog(LOG_WARNING, "Could not load control map file %s/%s", GetWorkingDirectory(), fileName);
-        return;
-    }
-    // Copy into local memory
-    if (size == sizeof(int) * maxEntries) {
-        int *dataCast = (int*)mapData;
-        for (int i = 0; i < maxEntries; ++i) {
-            map[i] = dataCast[i];
-        }
-    }
-    else {
-        TraceLog(LOG_WARNING, "Mapfile has different size %i, expected was %i", size, sizeof(int) * maxEntries);
-    }
+// Draw the Highscore table
+void DrawHighscores(Font font, float top, float lineSpace, float gap, const HighscoreTable* table, int maxScores)
+{
+    Vector2 sizeName = MeasureTextCached(font, "AAA", (float)font.baseSize, 1.0);
+    
+    DrawTextLineCentered(font, "HIGHSCORES", top, 1.0f);
+    top = top + font.baseSize * 1.1f;
 
-    UnloadFileData(mapData);
+    float textXpos = ((float)VIEW_WIDTH - gap) / 2.0f - sizeName.x;
+    float numberXpos = ((float)VIEW_WIDTH + gap) / 2.0f;
+    float y = top;
+    for (int i = 0; i < maxScores && i < table->count; ++i) {
+        DrawTextCached(font, table->entries[i].name, (Vector2) { textXpos, y }, (float)font.baseSize, 1.0, WHITE);
+        DrawTextCached(font, TextFormat("%i", table->entries[i].score), (Vector2) { numberXpos, y }, (float)font.baseSize, 1.0, WHITE);
+        y += lineSpace;
+    }
 }
 
-// Writes values for keyboard input into file
-// SaveFileData already reports errors if this fails
-void WriteControlMap(const char* fileName, int map[], int maxEntries) {
-    bool success = SaveFileData(fileName, map, sizeof(int) * maxEntries);
-}
+//----------------------------------------------------------------------------------
+// Text Layout Cache
+//----------------------------------------------------------------------------------
 
-// Load highscores from file, expects comma separated list of name,score pairs 
-void LoadHigscores(const char* fileName, Highscore scores[], int maxScores) {
-    char* highscoreText = LoadFileText(fileName);
-    if (highscoreText == 0) {
-        TraceLog(LOG_WARNING, "Could not load highscores file %s/%s", GetWorkingDirectory(), fileName);
-        SetDefaultScores(scores, maxScores);
-        return;
-    }
+// Most of the text on screen never changes, or changes rarely (score), so rather
+// than measuring and walking the glyphs every frame the quads for a string are
+// calculated once and drawn straight from the cache afterwards
+#define TEXT_CACHE_SIZE 32
 
-    int count = 0;
-    char** splits = TextSplit(highscoreText, ',', &count);
+static TextLayout textCache[TEXT_CACHE_SIZE] = { 0 };
+static int textCacheNext = 0;   // Next slot to be replaced when the cache is full
 
-    if (count < 2 || count % 2 != 0) {
-        TraceLog(LOG_WARNING, "Invalid forma for highscore file");
-        SetDefaultScores(scores, maxScores);
-        count = 0;
+// FNV-1a, only used to make the cache lookup cheap
+static unsigned int HashText(const char* text)
+{
+    unsigned int hash = 2166136261u;
+    while (*text != 0) {
+        hash = (hash ^ (unsigned char)*text++) * 16777619u;
     }
+    return hash;
+}
 
-    int i = 0;
-    while (i < count && i / 2 < maxScores) {
-        TextCopy(scores[i / 2].name, splits[i]);
-        TextCopy(scores[i / 2].score, splits[i + 1]);
-        i += 2;
-    }
-    
-    UnloadFileText(highscoreText);
+static bool IsLayoutOf(const TextLayout* layout, Font font, const char* text, unsigned int hash, float fontSize, float spacing)
+{
+    return layout->valid && layout->hash == hash && layout->texture.id == font.texture.id &&
+        layout->fontSize == fontSize && layout->spacing == spacing && TextIsEqual(layout->text, text);
 }
 
-// Finds a new scores position in the highscore table, returns -1 if its
-// not a new highscore in the give table
-int GetHighscorePosition(Highscore scores[], int maxScores, int score) {
-    int found = -1;
-    for (int i = maxScores - 1; i >= 0; --i) {
-        if (score < TextToInteger(scores[i].score)) {
-            break;
+// Calculates the glyph quads for the text, this follows what DrawTextEx() and
+// DrawTextCodepoint() do so the result is pixel identical, only recalculates when
+// the input changed. Returns false if the text is too long to be laid out
+bool LayoutText(TextLayout* layout, Font font, const char* text, float fontSize, float spacing)
+{
+    unsigned int hash = HashText(text);
+    if (IsLayoutOf(layout, font, text, hash, fontSize, spacing)) return true;
+
+    layout->valid = false;
+    if (TextLength(text) > TEXT_LAYOUT_MAX_GLYPHS) return false;
+
+    TextCopy(layout->text, text);
+    layout->hash = hash;
+    layout->texture = font.texture;
+    layout->fontSize = fontSize;
+    layout->spacing = spacing;
+    layout->size = MeasureTextEx(font, text, fontSize, spacing);
+    layout->quadCount = 0;
+
+    float scaleFactor = fontSize / (float)font.baseSize;
+    float padding = (float)font.glyphPadding;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+    int i = 0;
+    while (text[i] != 0) {
+        int byteCount = 0;
+        int codepoint = GetCodepointNext(&text[i], &byteCount);
+        int index = GetGlyphIndex(font, codepoint);
+        i += byteCount;
+
+        if (codepoint == '\n') {
+            offsetY += TEXT_LINE_SPACING;
+            offsetX = 0.0f;
+            continue;
+        }
+
+        Rectangle rec = font.recs[index];
+        GlyphInfo glyph = font.glyphs[index];
+        if (codepoint != ' ' && codepoint != '\t') {
+            layout->source[layout->quadCount] = (Rectangle){ rec.x - padding, rec.y - padding,
+                rec.width + 2.0f * padding, rec.height + 2.0f * padding };
+            layout->dest[layout->quadCount] = (Rectangle){ offsetX + (glyph.offsetX - padding) * scaleFactor,
+                offsetY + (glyph.offsetY - padding) * scaleFactor,
+                (rec.width + 2.0f * padding) * scaleFactor,
+                (rec.height + 2.0f * padding) * scaleFactor };
+            ++layout->quadCount;
         }
-        found = i;
+
+        float advance = (glyph.advanceX == 0) ? rec.width : (float)glyph.advanceX;
+        offsetX += advance * scaleFactor + spacing;
     }
-    return found;
+
+    layout->valid = true;
+    return true;
 }
 
-// Inserts a new higscore into the highscore table 
-void InsertHighscore(Highscore scores[], int maxScores, int at, char* name, int score)
+// Returns the shared layout for this text, lays it out if it isn't in the cache
+// yet, NULL if the text is too long to be cached
+const TextLayout* GetTextLayout(Font font, const char* text, float fontSize, float spacing)
 {
-    if (at < 0 || at >= maxScores) {
-        TraceLog(LOG_WARNING, "Invalid High Score Position");
-        return;
-    }
-    if (TextLength(name) > 3) {
-        TraceLog(LOG_WARNING, "Name is too long for highscore table '%s'", name);
-        return;
-    }
-
-    // Move all entries below 'at' down by one spot, overwriting the
-    // last entry in the table, by going in reverse no temp variables
-    // are needed
-    for (int i = maxScores - 1; i >= at + 1; --i) {
-        TextCopy(scores[i].name, scores[i - 1].name);
-        TextCopy(scores[i].score, scores[i - 1].score);
+    unsigned int hash = HashText(text);
+    for (int i = 0; i < TEXT_CACHE_SIZE; ++i) {
+        if (IsLayoutOf(&textCache[i], font, text, hash, fontSize, spacing)) return &textCache[i];
     }
 
-    TextCopy(scores[at].name, name);
-    TextCopy(scores[at].score, TextFormat("%i", score));
+    TextLayout* layout = &textCache[textCacheNext];
+    if (!LayoutText(layout, font, text, fontSize, spacing)) return NULL;
+    textCacheNext = (textCacheNext + 1) % TEXT_CACHE_SIZE;
+    return layout;
 }
 
-// Writes Highscores as simple comma separated list
-void WriteHigscores(const char* fileName, Highscore scores[], int maxScores)
+// Drops all cached layouts, needs to be called before a font gets unloaded
+void ClearTextLayoutCache(void)
 {
-    char buffer[1024] = { 0 };
-    int position = 0;
-    for (int i = 0; i < maxScores; ++i) {
-        TextAppend(buffer, scores[i].name, &position);
-        TextAppend(buffer, ",", &position);
-        TextAppend(buffer, scores[i].score, &position);
-        if (i < maxScores - 1) {
-            TextAppend(buffer, ",", &position);
-        }
+    for (int i = 0; i < TEXT_CACHE_SIZE; ++i) {
+        textCache[i].valid = false;
     }
-    SaveFileText(fileName, buffer);
+    textCacheNext = 0;
 }
 
-// Utility function to draw a text line that's centered horizontally on the screen
-void DrawTextLineCentered(Font font, const char* text, float y, float spacing)
+// Draws the precalculated quads of a layout at the given position
+void DrawTextLayout(const TextLayout* layout, Vector2 position, Color tint)
 {
-    Vector2 pos = MeasureTextEx(font, text, (float)font.baseSize * 1.0f, 1.0f);
-    pos.y = y;
-    pos.x = (GetScreenWidth() - pos.x) / 2.0f;
-    DrawTextEx(font,text, pos, (float)font.baseSize, 1.0f, WHITE);
+    for (int i = 0; i < layout->quadCount; ++i) {
+        Rectangle dest = layout->dest[i];
+        dest.x += position.x;
+        dest.y += position.y;
+        CanvasTexture(layout->texture, layout->source[i], dest, tint);
+    }
 }
 
-// Draw the Highscore table
-void DrawHighscores(Font font, float top, float lineSpace, float gap, Highscore* scores, int maxScores)
+// Same as DrawTextEx() but goes through the layout cache
+void DrawTextCached(Font font, const char* text, Vector2 position, float fontSize, float spacing, Color tint)
 {
-    Vector2 sizeName = MeasureTextEx(font, "AAA", (float)font.baseSize, 1.0);
-    
-    DrawTextLineCentered(font, "HIGHSCORES", top, 1.0f);
-    top = top + font.baseSize * 1.1f;
-
-    float textXpos = ((float)GetScreenWidth() - gap) / 2.0f - sizeName.x;
-    float numberXpos = ((float)GetScreenWidth() + gap) / 2.0f;
-    float y = top;
-    for (int i = 0; i < maxScores; ++i) {
-        DrawTextEx(font, scores[i].name, (Vector2) { textXpos, y }, (float)font.baseSize, 1.0, WHITE);
-        DrawTextEx(font, scores[i].score, (Vector2) { numberXpos, y }, (float)font.baseSize, 1.0, WHITE);
-        y += lineSpace;
+    const TextLayout* layout = GetTextLayout(font, text, fontSize, spacing);
+    if (layout == NULL) {
+        CanvasText(font, text, position, fontSize, spacing, tint);
+        return;
     }
+    DrawTextLayout(layout, position, tint);
+}
+
+// Same as MeasureTextEx() but goes through the layout cache
+Vector2 MeasureTextCached(Font font, const char* text, float fontSize, float spacing)
+{
+    const TextLayout* layout = GetTextLayout(font, text, fontSize, spacing);
+    if (layout == NULL) return MeasureTextEx(font, text, fontSize, spacing);
+    return layout->size;
 }
\ No newline at end of file
@@ -0,0 +1,380 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Control bindings, keys and gamepad buttons and axes for every control and their file format
+*
+*   Every control can have up to CONTROL_MAX_BINDINGS bindings, each one a key, a button
+*   or one side of an axis, of one gamepad or of all connected ones (GAMEPAD_ANY). The
+*   gamepads report the standard layout, see gamepads.c. control.bin stores the bindings
+*   as tagged entries in little endian byte order:
+*
+*       header  "RCTL", u16 version, u16 entry size, u16 entry count, u16 reserved
+*       entry   u8 control tag, u8 device, u8 gamepad, u8 reserved, u16 code, u16 reserved
+*
+*   Controls are found by their tag, not by their position, the tags never change and
+*   are never reused. Controls the file doesn't mention keep their defaults, so adding a
+*   control doesn't lose the other bindings. Newer versions may only add tags, devices
+*   and bytes at the end of the entries, anything else needs a new magic. So files of
+*   newer versions get read too: entries with unknown tags or devices are kept with all
+*   their bytes and written back, the file then keeps their entry size and the known
+*   entries get zeros at the end. Version 0 doesn't exist and isn't read. The raw int
+*   array of older versions gets imported.
+*
+*   For reading the input the bindings get flattened into a ControlLookup: one entry per
+*   distinct key, button or axis with the outputs of all controls bound to it, so every
+*   binding gets polled exactly once. Every frame the bindings get sampled into an
+*   InputState, presses are queued with the time they were seen and every step takes
+*   the oldest press of each output. A tap that is over before the next frame still
+*   reaches the simulation, several taps of the same control reach successive steps.
+*   raylib only polls the system events once per frame, the times are those of the
+*   sampling, not of the key press itself.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Control Map Definition
+//----------------------------------------------------------------------------------
+#define CONTROL_MAP_MAGIC "RCTL"
+#define CONTROL_MAP_VERSION 1
+#define CONTROL_HEADER_SIZE 12
+#define CONTROL_ENTRY_SIZE 8
+
+// File tag of each control, new controls get the next free tag
+static const unsigned char controlTags[CONTROL_MAX] = {
+    [CONTROL_LEFT] = 1,
+    [CONTROL_RIGHT] = 2,
+    [CONTROL_THRUST] = 3,
+    [CONTROL_FIRE] = 4,
+    [CONTROL_HYPERSPACE] = 5,
+};
+
+// Gamepad bindings take any gamepad, the sticks work like the buttons
+static const ControlBinding defaultBindings[CONTROL_MAX][CONTROL_MAX_BINDINGS] = {
+    [CONTROL_LEFT] = {
+        { BINDING_KEY, 0, KEY_A },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_LEFT_TRIGGER_1 },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_LEFT_FACE_LEFT },
+        { BINDING_GAMEPAD_AXIS, GAMEPAD_ANY, GAMEPAD_AXIS_LEFT_X | AXIS_NEGATIVE },
+    },
+    [CONTROL_RIGHT] = {
+        { BINDING_KEY, 0, KEY_D },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_RIGHT_TRIGGER_1 },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_LEFT_FACE_RIGHT },
+        { BINDING_GAMEPAD_AXIS, GAMEPAD_ANY, GAMEPAD_AXIS_LEFT_X },
+    },
+    [CONTROL_THRUST] = {
+        { BINDING_KEY, 0, KEY_W },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_RIGHT_FACE_DOWN },
+        { BINDING_GAMEPAD_AXIS, GAMEPAD_ANY, GAMEPAD_AXIS_LEFT_Y | AXIS_NEGATIVE },
+        { BINDING_GAMEPAD_AXIS, GAMEPAD_ANY, GAMEPAD_AXIS_RIGHT_TRIGGER },
+    },
+    [CONTROL_FIRE] = {
+        { BINDING_KEY, 0, KEY_SPACE },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_RIGHT_FACE_LEFT },
+    },
+    [CONTROL_HYPERSPACE] = {
+        { BINDING_KEY, 0, KEY_S },
+        { BINDING_GAMEPAD_BUTTON, GAMEPAD_ANY, GAMEPAD_BUTTON_LEFT_FACE_DOWN },
+    },
+};
+
+// Presses taken by steps since the last latency report
+static double takenPressTimes = 0;
+static int takenPresses = 0;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static unsigned int ReadU16(const unsigned char* data)
+{
+    return (unsigned int)data[0] | ((unsigned int)data[1] << 8);
+}
+
+static void WriteU16(unsigned char* data, unsigned int value)
+{
+    data[0] = (unsigned char)(value & 0xff);
+    data[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static int FindControlTag(unsigned char tag)
+{
+    for (int c = 0; c < CONTROL_MAX; ++c) {
+        if (controlTags[c] == tag) return c;
+    }
+    return -1;
+}
+
+static bool IsKnownDevice(int device)
+{
+    return device == BINDING_KEY || device == BINDING_GAMEPAD_BUTTON || device == BINDING_GAMEPAD_AXIS;
+}
+
+static bool IsGamepadBindingDown(ControlBinding binding, int gamepad)
+{
+    if (binding.device == BINDING_GAMEPAD_BUTTON) return IsGamepadButtonDown(gamepad, binding.code);
+
+    float value = GetGamepadAxisMovement(gamepad, binding.code & ~AXIS_NEGATIVE);
+    return ((binding.code & AXIS_NEGATIVE) != 0) ? value < -INPUT_AXIS_THRESHOLD : value > INPUT_AXIS_THRESHOLD;
+}
+
+static bool IsBindingDown(ControlBinding binding)
+{
+    if (binding.device == BINDING_KEY) return IsKeyDown(binding.code);
+    if (binding.gamepad != GAMEPAD_ANY) return IsGamepadAvailable(binding.gamepad) && IsGamepadBindingDown(binding, binding.gamepad);
+
+    for (int g = 0; g < INPUT_MAX_GAMEPADS; ++g) {
+        if (IsGamepadAvailable(g) && IsGamepadBindingDown(binding, g)) return true;
+    }
+    return false;
+}
+
+// Adds the binding to the first free slot of the control, false if there is none
+static bool AddBinding(ControlMap* map, int control, ControlBinding binding)
+{
+    for (int b = 0; b < CONTROL_MAX_BINDINGS; ++b) {
+        if (map->bindings[control][b].device == BINDING_NONE) {
+            map->bindings[control][b] = binding;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The raw int[CONTROL_MAX] of older versions, one key per control in native byte order
+static bool ImportLegacyControlMap(ControlMap* map, const unsigned char* data, int size)
+{
+    const int legacyControls = 5;
+    if (size != legacyControls * (int)sizeof(int)) return false;
+
+    for (int c = 0; c < legacyControls; ++c) {
+        int key = 0;
+        memcpy(&key, data + c * sizeof(int), sizeof(int));
+        if (key > 0 && key < 0xffff) SetControlKey(map, c, key);
+    }
+    TraceLog(LOG_INFO, "CONTROLS: Imported the key map of an older version");
+    return true;
+}
+
+static bool ParseControlMap(ControlMap* map, const unsigned char* data, int size)
+{
+    if (size < CONTROL_HEADER_SIZE || memcmp(data, CONTROL_MAP_MAGIC, 4) != 0) return false;
+    unsigned int version = ReadU16(data + 4);
+    unsigned int entrySize = ReadU16(data + 6);
+    unsigned int count = ReadU16(data + 8);
+    if (version == 0) {
+        TraceLog(LOG_WARNING, "CONTROLS: Control map version 0 isn't supported");
+        return false;
+    }
+    if (entrySize < CONTROL_ENTRY_SIZE || CONTROL_HEADER_SIZE + count * entrySize > (unsigned int)size) return false;
+    if (version > CONTROL_MAP_VERSION) TraceLog(LOG_INFO, "CONTROLS: Control map of the newer version %i, keeping what it adds", version);
+
+    // The first entry of a control replaces its defaults
+    bool seen[CONTROL_MAX] = { 0 };
+    for (unsigned int i = 0; i < count; ++i) {
+        const unsigned char* entry = data + CONTROL_HEADER_SIZE + i * entrySize;
+        int control = FindControlTag(entry[0]);
+        ControlBinding binding = { entry[1], entry[2], (unsigned short)ReadU16(entry + 4) };
+
+        if (control < 0 || !IsKnownDevice(binding.device)) {
+            if (map->unknownCount < CONTROL_MAX_UNKNOWN && entrySize <= CONTROL_MAX_ENTRY_SIZE) {
+                memcpy(map->unknown[map->unknownCount++], entry, entrySize);
+                map->unknownSize = (int)entrySize;
+            }
+            else TraceLog(LOG_WARNING, "CONTROLS: Dropped an entry of a newer version, it doesn't fit");
+            continue;
+        }
+        if (!seen[control]) {
+            memset(map->bindings[control], 0, sizeof(map->bindings[control]));
+            seen[control] = true;
+        }
+        AddBinding(map, control, binding);
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------------
+// Control Map Functions
+//----------------------------------------------------------------------------------
+
+void SetDefaultControls(ControlMap* map)
+{
+    memcpy(map->bindings, defaultBindings, sizeof(map->bindings));
+    map->unknownCount = 0;
+    map->unknownSize = CONTROL_ENTRY_SIZE;
+    ++map->revision;
+}
+
+// Loads the bindings from file, anything that can't be read keeps the defaults
+void LoadControlMap(const char* fileName, ControlMap* map)
+{
+    SetDefaultControls(map);
+    if (!FileExists(fileName)) return;
+
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    if (data == NULL) return;
+
+    // Only files without the magic can be a key map of an older version
+    bool isControlMap = (size >= 4 && memcmp(data, CONTROL_MAP_MAGIC, 4) == 0);
+    if (isControlMap ? !ParseControlMap(map, data, size) : !ImportLegacyControlMap(map, data, size)) {
+        TraceLog(LOG_WARNING, "CONTROLS: %s is no control map, using the default controls", fileName);
+    }
+    UnloadFileData(data);
+    ++map->revision;
+}
+
+// SaveFileData already reports errors if this fails. Kept entries of a newer version
+// keep their size, all entries of a file have the same size
+bool WriteControlMap(const char* fileName, const ControlMap* map)
+{
+    unsigned char data[CONTROL_HEADER_SIZE + (CONTROL_MAX * CONTROL_MAX_BINDINGS + CONTROL_MAX_UNKNOWN) * CONTROL_MAX_ENTRY_SIZE] = { 0 };
+    int entrySize = (map->unknownCount > 0) ? map->unknownSize : CONTROL_ENTRY_SIZE;
+    int count = 0;
+    for (int c = 0; c < CONTROL_MAX; ++c) {
+        for (int b = 0; b < CONTROL_MAX_BINDINGS; ++b) {
+            const ControlBinding* binding = &map->bindings[c][b];
+            if (binding->device == BINDING_NONE) continue;
+            unsigned char* entry = data + CONTROL_HEADER_SIZE + count++ * entrySize;
+            entry[0] = controlTags[c];
+            entry[1] = binding->device;
+            entry[2] = binding->gamepad;
+            WriteU16(entry + 4, binding->code);
+        }
+    }
+    for (int i = 0; i < map->unknownCount; ++i) {
+        memcpy(data + CONTROL_HEADER_SIZE + count++ * entrySize, map->unknown[i], entrySize);
+    }
+
+    memcpy(data, CONTROL_MAP_MAGIC, 4);
+    WriteU16(data + 4, CONTROL_MAP_VERSION);
+    WriteU16(data + 6, entrySize);
+    WriteU16(data + 8, count);
+    return SaveFileData(fileName, data, CONTROL_HEADER_SIZE + count * entrySize);
+}
+
+// The first key bound to the control, 0 if there is none
+int GetControlKey(const ControlMap* map, int control)
+{
+    for (int b = 0; b < CONTROL_MAX_BINDINGS; ++b) {
+        if (map->bindings[control][b].device == BINDING_KEY) return map->bindings[control][b].code;
+    }
+    return 0;
+}
+
+// Replaces the first key bound to the control, gamepad bindings stay
+void SetControlKey(ControlMap* map, int control, int key)
+{
+    ControlBinding binding = { BINDING_KEY, 0, (unsigned short)key };
+    ++map->revision;
+    for (int b = 0; b < CONTROL_MAX_BINDINGS; ++b) {
+        if (map->bindings[control][b].device == BINDING_KEY) {
+            map->bindings[control][b] = binding;
+            return;
+        }
+    }
+    if (!AddBinding(map, control, binding)) map->bindings[control][0] = binding;
+}
+
+// Flattens the bindings, outputs holds what each control adds to the input. Controls
+// in pressedControls (bit per control) only trigger on the frame they get pressed
+void BuildControlLookup(ControlLookup* lookup, const ControlMap* map, const int outputs[CONTROL_MAX], int pressedControls)
+{
+    lookup->count = 0;
+    lookup->revision = map->revision;
+    for (int c = 0; c < CONTROL_MAX; ++c) {
+        bool pressed = (pressedControls & (1 << c)) != 0;
+        for (int b = 0; b < CONTROL_MAX_BINDINGS; ++b) {
+            ControlBinding binding = map->bindings[c][b];
+            if (binding.device == BINDING_NONE) continue;
+
+            ControlLookupEntry* entry = NULL;
+            for (int i = 0; i < lookup->count; ++i) {
+                ControlLookupEntry* other = &lookup->entries[i];
+                if (other->binding.device == binding.device && other->binding.gamepad == binding.gamepad &&
+                    other->binding.code == binding.code) entry = other;
+            }
+            if (entry == NULL) {
+                entry = &lookup->entries[lookup->count++];
+                *entry = (ControlLookupEntry){ .binding = binding };
+            }
+            if (pressed) entry->pressedOutput |= outputs[c];
+            else entry->heldOutput |= outputs[c];
+        }
+    }
+}
+
+// Polls every bound key, button and axis once. Key presses come from the queue of
+// raylib, that queue also holds keys that got pressed and released again since the last
+// poll, gamepads only have their state. Presses are kept until a step takes them
+void SampleInput(InputState* state, const ControlLookup* lookup, double time)
+{
+    if (state->revision != lookup->revision) {
+        memset(state->down, 0, sizeof(state->down));
+        state->revision = lookup->revision;
+    }
+
+    for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed()) {
+        int output = 0;
+        for (int i = 0; i < lookup->count; ++i) {
+            const ControlLookupEntry* entry = &lookup->entries[i];
+            if (entry->binding.device == BINDING_KEY && entry->binding.code == key) {
+                output |= entry->heldOutput | entry->pressedOutput;
+            }
+        }
+        if (output != 0 && state->pressCount < INPUT_MAX_PRESSES) {
+            state->presses[state->pressCount++] = (InputPress){ time, output };
+        }
+    }
+
+    state->held = 0;
+    for (int i = 0; i < lookup->count; ++i) {
+        const ControlLookupEntry* entry = &lookup->entries[i];
+        bool isKey = entry->binding.device == BINDING_KEY;
+        bool down = IsBindingDown(entry->binding);
+        if (down) state->held |= entry->heldOutput;
+
+        if (!isKey && down && !state->down[i] && state->pressCount < INPUT_MAX_PRESSES) {
+            state->presses[state->pressCount++] = (InputPress){ time, entry->heldOutput | entry->pressedOutput };
+        }
+        state->down[i] = down;
+    }
+}
+
+// The input of the next step: everything held down plus the oldest press of each
+// output. Further presses of the same output wait for the following steps, so fast
+// taps within one frame still all count
+int TakeStepInput(InputState* state)
+{
+    int output = state->held;
+    int taken = 0;
+    int kept = 0;
+    for (int i = 0; i < state->pressCount; ++i) {
+        InputPress press = state->presses[i];
+        if ((press.output & taken) == 0) {
+            output |= press.output;
+            taken |= press.output;
+            takenPressTimes += press.time;
+            ++takenPresses;
+        }
+        else state->presses[kept++] = press;
+    }
+    state->pressCount = kept;
+    return output;
+}
+
+// Called once the frame is on screen, reports the time from sampling the presses the
+// steps of this frame took until now
+void ReportInputLatency(void)
+{
+    if (takenPresses == 0) return;
+    AddTelemetry(TELEMETRY_INPUT_PRESSES, takenPresses);
+    AddTelemetry(TELEMETRY_INPUT_LATENCY, (long long)((GetTime() * takenPresses - takenPressTimes) * 1e6));
+    takenPressTimes = 0;
+    takenPresses = 0;
+}
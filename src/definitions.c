@@ -0,0 +1,418 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Game definitions, shapes, speeds, scores and level rules loaded from a file
+*
+*   resources/definitions.txt holds one value per line, a key followed by its numbers,
+*   keys that are missing keep their built in value. Parsing the text gives a packed
+*   table, that table also gets written as a binary file next to the text together
+*   with the modification time of the text. Later starts load the binary file as long
+*   as the text didn't change since.
+*
+*   The definitions are shared by all worlds. The game watches the text file (inotify on
+*   Linux, the modification time elsewhere) and takes changes over between two steps,
+*   the worlds keep running. Shapes may change but not their amount of points, objects
+*   keep the vertex buffers they have. Both sides of a versus game need the same
+*   definitions, there is no reloading in versus.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && !defined(PLATFORM_WEB)
+    #include <sys/inotify.h>
+    #include <unistd.h>
+    #define DEFINITIONS_INOTIFY
+#endif
+
+//----------------------------------------------------------------------------------
+// Definitions Table
+//----------------------------------------------------------------------------------
+#define DEFINITIONS_MAGIC 0x53464544    // "DEFS"
+#define DEFINITIONS_VERSION 1
+#define DEFINITIONS_POLL_CALLS 30       // Without inotify the file time is checked every this many calls
+
+#if defined(_MSC_VER)
+    #define DEFINITIONS_ALIGNED __declspec(align(64))
+#else
+    #define DEFINITIONS_ALIGNED __attribute__((aligned(64)))
+#endif
+
+// Data: see https://www.retrogamedeconstructionzone.com/2019/10/asteroids-by-numbers.html
+DEFINITIONS_ALIGNED GameDefinitions definitions = {
+    .shipAccelerationFactor = .1f,
+    .shipRotationFactor = 2.0f,
+    .shipDecelerationFactor = .995f,
+    .shipMaxSpeed = 14.0f,
+    .shipSpeedCutoff = 0.05f,
+    .bulletInitialLifetime = 3.0f,
+    .bulletInitialVelocity = 14.0f,
+    .asteroidVelocity = { 4, 5, 6 },
+    .asteroidRadius = { 1.2f, 0.6f, 0.3f },
+    .levelSpeedIncrease = 0.1f,
+    .hyperspaceDuration = 0.75f,
+    .saucerSpawnFrequency = 5.0f,
+    .saucerSpawnChance = 0.1f,
+    .saucerActionTime = 3.0f,
+
+    .startingAsteroids = 2,
+    .maxAsteroids = 8,
+    .saucerLimit = 1,
+    .nextShipInterval = 5000,
+    .nextHyperSpaceInverval = 2500,
+    .asteroidScore = { 20, 50, 100 },
+    .saucerScore = { 200, 1000 },
+
+    // A simple triangle, for size and scaling the ship is 1 unit long
+    .shipVertexCount = 4,
+    .shipVertices = {
+        {-0.25f, 0.5f},
+        {0.0f, -0.5f},
+        {0.25f, 0.5f},
+        {-0.25f, 0.5f},
+    },
+    // Large Asteroid 2.4 x 2.4
+    .asteroidVertexCount = 11,
+    .asteroidVerticesLarge = {
+        {-0.5f, 1.2f},
+        {-1.2f, 0.6f},
+        {-1.2f, -0.9f},
+        {-0.5f, -1.2f},
+        {0.0f, -0.9f},
+        {0.5f, -1.2f},
+        {1.2f, -0.9f},
+        {1.0f, 0.3f},
+        {1.2f, 0.6f},
+        {0.5f, 1.2f},
+        {-0.5f, 1.2f}
+    },
+    .saucerVertexCount = 13,
+    .saucerDataLarge = {
+        {-0.75f, 0.2f}, // Bottom CCW
+        {-0.4f, 0.5f},
+        {0.4f, 0.5f},
+        {0.75f, 0.2f},
+        {-0.75f, 0.2f},
+        {-0.4f, -0.1f}, // Middle CW
+        {0.4f, -0.1f},
+        {0.75f, 0.2f},
+        {-0.75f, 0.2f},
+        {-0.4f, -0.1f}, // Repeated (as we're drawing linestrip)
+        {-0.3f, -0.5f}, // Top
+        {0.3f, -0.5f},
+        {0.4f, -0.1f}
+    },
+};
+
+typedef enum DefinitionType {
+    DEFINITION_FLOAT,
+    DEFINITION_INT,
+    DEFINITION_SHAPE,
+} DefinitionType;
+
+typedef struct DefinitionKey {
+    const char* name;
+    DefinitionType type;
+    int offset;
+    int count;              // Numbers for floats and ints, most vertices for shapes
+    int countOffset;        // Where shapes keep their vertex count
+} DefinitionKey;
+
+#define FLOATS(name, field, count) { name, DEFINITION_FLOAT, offsetof(GameDefinitions, field), count, 0 }
+#define INTS(name, field, count) { name, DEFINITION_INT, offsetof(GameDefinitions, field), count, 0 }
+#define SHAPE(name, field, countField) { name, DEFINITION_SHAPE, offsetof(GameDefinitions, field), DEFINITION_MAX_VERTICES, offsetof(GameDefinitions, countField) }
+
+static const DefinitionKey definitionKeys[] = {
+    FLOATS("ship.acceleration", shipAccelerationFactor, 1),
+    FLOATS("ship.rotation", shipRotationFactor, 1),
+    FLOATS("ship.deceleration", shipDecelerationFactor, 1),
+    FLOATS("ship.max_speed", shipMaxSpeed, 1),
+    FLOATS("ship.speed_cutoff", shipSpeedCutoff, 1),
+    FLOATS("ship.hyperspace_duration", hyperspaceDuration, 1),
+    INTS("ship.extra_ship_every", nextShipInterval, 1),
+    INTS("ship.extra_hyperspace_every", nextHyperSpaceInverval, 1),
+    SHAPE("ship.shape", shipVertices, shipVertexCount),
+    FLOATS("bullet.lifetime", bulletInitialLifetime, 1),
+    FLOATS("bullet.speed", bulletInitialVelocity, 1),
+    FLOATS("asteroid.speed", asteroidVelocity, 3),
+    FLOATS("asteroid.radius", asteroidRadius, 3),
+    INTS("asteroid.score", asteroidScore, 3),
+    SHAPE("asteroid.shape", asteroidVerticesLarge, asteroidVertexCount),
+    INTS("level.starting_asteroids", startingAsteroids, 1),
+    INTS("level.max_asteroids", maxAsteroids, 1),
+    FLOATS("level.speed_increase", levelSpeedIncrease, 1),
+    FLOATS("saucer.spawn_frequency", saucerSpawnFrequency, 1),
+    FLOATS("saucer.spawn_chance", saucerSpawnChance, 1),
+    FLOATS("saucer.action_time", saucerActionTime, 1),
+    INTS("saucer.limit", saucerLimit, 1),
+    INTS("saucer.score", saucerScore, 2),
+    SHAPE("saucer.shape", saucerDataLarge, saucerVertexCount),
+};
+
+#define DEFINITION_KEY_COUNT (int)(sizeof(definitionKeys) / sizeof(definitionKeys[0]))
+
+// Header of the binary form, followed by the table
+typedef struct DefinitionsHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int size;
+    long long sourceTime;       // Modification time of the text it was made from
+} DefinitionsHeader;
+
+typedef struct DefinitionsFile {
+    char fileName[512];
+    char binaryFile[512];
+    long long sourceTime;
+    bool hasBuiltIn;
+    GameDefinitions builtIn;    // Values of keys missing in the file
+    bool watching;
+    int notify;                 // inotify descriptor
+    int pollCalls;
+} DefinitionsFile;
+
+static DefinitionsFile definitionsFile = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static const char* SkipSpaces(const char* text)
+{
+    while (*text == ' ' || *text == '\t' || *text == '\r') ++text;
+    return text;
+}
+
+// Reads up to maxNumbers numbers until the end of the line, returns how many
+static int ParseNumbers(const char** text, float* numbers, int maxNumbers)
+{
+    int count = 0;
+    const char* at = SkipSpaces(*text);
+    while (*at != '\n' && *at != '\0' && *at != '#') {
+        char* end = NULL;
+        float value = strtof(at, &end);
+        if (end == at || count >= maxNumbers) {
+            count = -1;
+            break;
+        }
+        numbers[count++] = value;
+        at = SkipSpaces(end);
+    }
+    while (*at != '\n' && *at != '\0') ++at;
+    *text = at;
+    return count;
+}
+
+static bool ApplyDefinition(GameDefinitions* defs, const DefinitionKey* key, const float* numbers, int count)
+{
+    unsigned char* field = (unsigned char*)defs + key->offset;
+    switch (key->type) {
+    case DEFINITION_FLOAT:
+        if (count != key->count) return false;
+        for (int i = 0; i < count; ++i) ((float*)field)[i] = numbers[i];
+        return true;
+    case DEFINITION_INT:
+        if (count != key->count) return false;
+        for (int i = 0; i < count; ++i) ((int*)field)[i] = (int)numbers[i];
+        return true;
+    case DEFINITION_SHAPE:
+        // Pairs of x y, a line strip needs two points at least
+        if (count % 2 != 0 || count < 4 || count / 2 > key->count) return false;
+        for (int i = 0; i < count / 2; ++i) ((Vector2*)field)[i] = (Vector2){ numbers[2 * i], numbers[2 * i + 1] };
+        *(int*)((unsigned char*)defs + key->countOffset) = count / 2;
+        return true;
+    }
+    return false;
+}
+
+// Parses the text over the values already in defs, lines that can't be read are
+// reported and skipped
+static void ParseDefinitions(GameDefinitions* defs, const char* text, const char* fileName)
+{
+    int line = 1;
+    const char* at = text;
+    while (*at != '\0') {
+        at = SkipSpaces(at);
+        if (*at != '#' && *at != '\n' && *at != '\0') {
+            const char* name = at;
+            while (*at != ' ' && *at != '\t' && *at != '\r' && *at != '\n' && *at != '\0') ++at;
+            int nameLength = (int)(at - name);
+
+            float numbers[2 * DEFINITION_MAX_VERTICES];
+            int count = ParseNumbers(&at, numbers, 2 * DEFINITION_MAX_VERTICES);
+
+            const DefinitionKey* key = NULL;
+            for (int k = 0; k < DEFINITION_KEY_COUNT; ++k) {
+                if ((int)strlen(definitionKeys[k].name) == nameLength && strncmp(definitionKeys[k].name, name, nameLength) == 0) {
+                    key = &definitionKeys[k];
+                    break;
+                }
+            }
+            if (key == NULL) TraceLog(LOG_WARNING, "DEFINITIONS: %s:%i unknown key", fileName, line);
+            else if (count < 0 || !ApplyDefinition(defs, key, numbers, count)) {
+                TraceLog(LOG_WARNING, "DEFINITIONS: %s:%i wrong values for %s", fileName, line, key->name);
+            }
+        }
+        while (*at != '\n' && *at != '\0') ++at;
+        if (*at == '\n') {
+            ++at;
+            ++line;
+        }
+    }
+}
+
+static bool LoadDefinitionsBinary(const char* fileName, long long sourceTime)
+{
+    if (!FileExists(fileName)) return false;
+
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    const DefinitionsHeader* header = (const DefinitionsHeader*)data;
+    bool valid = data != NULL && size == (int)(sizeof(DefinitionsHeader) + sizeof(GameDefinitions)) &&
+        header->magic == DEFINITIONS_MAGIC && header->version == DEFINITIONS_VERSION &&
+        header->size == sizeof(GameDefinitions) && header->sourceTime == sourceTime;
+    if (valid) memcpy(&definitions, data + sizeof(DefinitionsHeader), sizeof(GameDefinitions));
+    UnloadFileData(data);
+    return valid;
+}
+
+static void SaveDefinitionsBinary(const char* fileName, long long sourceTime)
+{
+    unsigned char data[sizeof(DefinitionsHeader) + sizeof(GameDefinitions)];
+    DefinitionsHeader header = { DEFINITIONS_MAGIC, DEFINITIONS_VERSION, sizeof(GameDefinitions), sourceTime };
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), &definitions, sizeof(GameDefinitions));
+    if (!SaveFileData(fileName, data, sizeof(data))) {
+        TraceLog(LOG_WARNING, "DEFINITIONS: Could not write %s", fileName);
+    }
+}
+
+// Parses the text file over the built in values
+static bool ParseDefinitionsFile(GameDefinitions* defs)
+{
+    char* text = LoadFileText(definitionsFile.fileName);
+    if (text == NULL) return false;
+    *defs = definitionsFile.builtIn;
+    ParseDefinitions(defs, text, definitionsFile.fileName);
+    UnloadFileText(text);
+    return true;
+}
+
+// A shape with a different amount of points would need new vertex buffers, it stays as it is
+static void KeepShapeSize(int* count, Vector2* vertices, int currentCount, const Vector2* current, const char* name)
+{
+    if (*count == currentCount) return;
+    TraceLog(LOG_WARNING, "DEFINITIONS: %s needs to keep %i points until the next start", name, currentCount);
+    *count = currentCount;
+    memcpy(vertices, current, sizeof(Vector2) * DEFINITION_MAX_VERTICES);
+}
+
+// True when the watched file got written since the last call
+static bool HasDefinitionsFileChanged(void)
+{
+#if defined(DEFINITIONS_INOTIFY)
+    if (definitionsFile.notify >= 0) {
+        bool changed = false;
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        int size = 0;
+        while ((size = (int)read(definitionsFile.notify, events, sizeof(events))) > 0) {
+            for (int at = 0; at < size; ) {
+                const struct inotify_event* event = (const struct inotify_event*)(events + at);
+                if (event->len > 0 && strcmp(event->name, GetFileName(definitionsFile.fileName)) == 0) changed = true;
+                at += (int)sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+    if (++definitionsFile.pollCalls < DEFINITIONS_POLL_CALLS) return false;
+    definitionsFile.pollCalls = 0;
+    return FileExists(definitionsFile.fileName) && GetFileModTime(definitionsFile.fileName) != definitionsFile.sourceTime;
+}
+
+//----------------------------------------------------------------------------------
+// Definitions Functions
+//----------------------------------------------------------------------------------
+
+// Loads the definitions from the text file, or its binary form when that is up to date,
+// has to be called before the first game starts. Without the file the built in values stay
+void LoadDefinitions(const char* fileName)
+{
+    if (!definitionsFile.hasBuiltIn) {
+        definitionsFile.builtIn = definitions;
+        definitionsFile.hasBuiltIn = true;
+    }
+    snprintf(definitionsFile.fileName, sizeof(definitionsFile.fileName), "%s", fileName);
+    snprintf(definitionsFile.binaryFile, sizeof(definitionsFile.binaryFile), "%s/%s.bin", GetDirectoryPath(fileName), GetFileNameWithoutExt(fileName));
+
+    if (!FileExists(fileName)) {
+        TraceLog(LOG_INFO, "DEFINITIONS: No %s, using the built in values", fileName);
+        return;
+    }
+
+    definitionsFile.sourceTime = GetFileModTime(fileName);
+    if (LoadDefinitionsBinary(definitionsFile.binaryFile, definitionsFile.sourceTime)) {
+        TraceLog(LOG_INFO, "DEFINITIONS: Loaded %s", definitionsFile.binaryFile);
+        return;
+    }
+
+    GameDefinitions parsed;
+    if (!ParseDefinitionsFile(&parsed)) return;
+    definitions = parsed;
+    TraceLog(LOG_INFO, "DEFINITIONS: Parsed %s", fileName);
+
+    SaveDefinitionsBinary(definitionsFile.binaryFile, definitionsFile.sourceTime);
+}
+
+// Starts watching the file of the last LoadDefinitions() for changes
+void WatchDefinitions(void)
+{
+    if (definitionsFile.watching || definitionsFile.fileName[0] == '\0') return;
+    definitionsFile.notify = -1;
+    definitionsFile.pollCalls = 0;
+#if defined(DEFINITIONS_INOTIFY)
+    // Editors often write a new file and rename it, so the directory gets watched
+    definitionsFile.notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (definitionsFile.notify >= 0 &&
+        inotify_add_watch(definitionsFile.notify, GetDirectoryPath(definitionsFile.fileName), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(definitionsFile.notify);
+        definitionsFile.notify = -1;
+    }
+#endif
+    definitionsFile.watching = true;
+}
+
+void UnwatchDefinitions(void)
+{
+#if defined(DEFINITIONS_INOTIFY)
+    if (definitionsFile.notify >= 0) close(definitionsFile.notify);
+#endif
+    definitionsFile.notify = -1;
+    definitionsFile.watching = false;
+}
+
+// Reads the file again when it changed, returns true if the definitions changed. Only to
+// be called between steps, on the thread that runs them
+bool ReloadChangedDefinitions(void)
+{
+    if (!definitionsFile.watching || !HasDefinitionsFileChanged()) return false;
+
+    definitionsFile.sourceTime = GetFileModTime(definitionsFile.fileName);
+    GameDefinitions parsed;
+    if (!ParseDefinitionsFile(&parsed)) return false;
+
+    KeepShapeSize(&parsed.shipVertexCount, parsed.shipVertices, definitions.shipVertexCount, definitions.shipVertices, "ship.shape");
+    KeepShapeSize(&parsed.asteroidVertexCount, parsed.asteroidVerticesLarge, definitions.asteroidVertexCount, definitions.asteroidVerticesLarge, "asteroid.shape");
+    KeepShapeSize(&parsed.saucerVertexCount, parsed.saucerDataLarge, definitions.saucerVertexCount, definitions.saucerDataLarge, "saucer.shape");
+    if (memcmp(&parsed, &definitions, sizeof(GameDefinitions)) == 0) return false;
+
+    definitions = parsed;
+    SaveDefinitionsBinary(definitionsFile.binaryFile, definitionsFile.sourceTime);
+    TraceLog(LOG_INFO, "DEFINITIONS: Reloaded %s", definitionsFile.fileName);
+    return true;
+}
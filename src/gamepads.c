@@ -0,0 +1,341 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Gamepad mappings, resolves every connected gamepad in gamecontrollerdb.txt
+*
+*   The database gets parsed once into a hash table from GUID to mapping line, keeping
+*   only the lines of the platform the game runs on. The table and the lines are saved
+*   next to the text (gamecontrollerdb.bin) and loaded from there while the text doesn't
+*   change, so a start doesn't parse thousands of lines. A gamepad that gets connected
+*   is looked up by its GUID and its mapping handed to raylib, which then reports its
+*   buttons and axes in the standard layout the control bindings use.
+*
+*   raylib has no GUID accessor, the GUID comes from GLFW. Only a raylib that links GLFW
+*   in statically exports it, the build checks for that and defines GAMEPAD_GLFW. Without
+*   it (a shared raylib or a Windows DLL) gamepads are looked up by the name raylib
+*   reports, every line is in the table under its name as well. Web and mobile builds use
+*   the mappings of the browser or system.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB) || defined(PLATFORM_ANDROID) || defined(PLATFORM_DRM)
+    #undef GAMEPAD_GLFW
+#else
+    #define GAMEPAD_LOOKUP
+#endif
+#if defined(GAMEPAD_GLFW)
+    // raylib doesn't export the GLFW header, the functions needed are declared here
+    int glfwJoystickPresent(int jid);
+    const char* glfwGetJoystickGUID(int jid);
+#endif
+
+#if defined(_WIN32)
+    #define GAMEPAD_PLATFORM "Windows"
+#elif defined(__APPLE__)
+    #define GAMEPAD_PLATFORM "Mac OS X"
+#elif defined(PLATFORM_ANDROID) || defined(__ANDROID__)
+    #define GAMEPAD_PLATFORM "Android"
+#else
+    #define GAMEPAD_PLATFORM "Linux"
+#endif
+
+//----------------------------------------------------------------------------------
+// Gamepad Database Definition
+//----------------------------------------------------------------------------------
+#define GAMEPAD_DB_MAGIC 0x42445047     // "GPDB"
+#define GAMEPAD_DB_VERSION 2
+#define GAMEPAD_GUID_SIZE 16
+
+// Header of the binary form, followed by the slots and the mapping lines
+typedef struct GamepadDbHeader {
+    unsigned int magic;
+    unsigned int version;
+    int slotCount;              // Power of two
+    int textSize;
+    long long sourceTime;       // Modification time of the text it was made from
+} GamepadDbHeader;
+
+typedef struct GamepadMappingSlot {
+    unsigned char guid[GAMEPAD_GUID_SIZE];  // Or the key of the name, see NameKey()
+    int offset;                 // Of the mapping line in the text, each line ends with '\0'
+    int length;                 // 0 for a free slot
+} GamepadMappingSlot;
+
+typedef struct GamepadDb {
+    unsigned char* data;        // Header, slots and text in the layout of the binary form
+    GamepadMappingSlot* slots;
+    const char* text;
+    int slotCount;
+    bool connected[INPUT_MAX_GAMEPADS];
+} GamepadDb;
+
+static GamepadDb gamepadDb = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static unsigned int HashGuid(const unsigned char* guid)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < GAMEPAD_GUID_SIZE; ++i) {
+        hash = (hash ^ guid[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 32 hex digits, anything else (like the "xinput" line of SDL) isn't a GUID
+static bool ParseGuid(const char* text, unsigned char* guid)
+{
+    for (int i = 0; i < GAMEPAD_GUID_SIZE; ++i) {
+        int high = HexValue(text[2 * i]);
+        int low = (high >= 0) ? HexValue(text[2 * i + 1]) : -1;
+        if (low < 0) return false;
+        guid[i] = (unsigned char)(high * 16 + low);
+    }
+    return text[2 * GAMEPAD_GUID_SIZE] == ',' || text[2 * GAMEPAD_GUID_SIZE] == '\0';
+}
+
+// Key of a gamepad name in the same table as the GUIDs, four FNV-1a hashes with
+// different seeds. The 0xff in the last byte keeps it apart from the SDL GUIDs,
+// which end in a zero byte
+static void NameKey(const char* name, int length, unsigned char* key)
+{
+    for (int h = 0; h < 4; ++h) {
+        unsigned int hash = 2166136261u + (unsigned int)h * 0x9e3779b9u;
+        for (int i = 0; i < length; ++i) {
+            hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+        }
+        memcpy(key + 4 * h, &hash, 4);
+    }
+    key[GAMEPAD_GUID_SIZE - 1] = 0xff;
+}
+
+// The slot of the GUID, or the free slot it would go into. NULL if the GUID isn't in
+// a table without free slots, the probe never goes round more than once
+static GamepadMappingSlot* FindSlot(GamepadMappingSlot* slots, int slotCount, const unsigned char* guid)
+{
+    unsigned int index = HashGuid(guid) & (unsigned int)(slotCount - 1);
+    for (int probe = 0; probe < slotCount; ++probe) {
+        if (slots[index].length == 0 || memcmp(slots[index].guid, guid, GAMEPAD_GUID_SIZE) == 0) return &slots[index];
+        index = (index + 1) & (unsigned int)(slotCount - 1);
+    }
+    return NULL;
+}
+
+static bool IsPlatformLine(const char* line, int length)
+{
+    const char* tag = "platform:" GAMEPAD_PLATFORM ",";
+    int tagLength = (int)strlen(tag);
+    for (int i = 0; i + tagLength <= length; ++i) {
+        if (memcmp(line + i, tag, tagLength) == 0) return true;
+    }
+    return false;
+}
+
+static void SetGamepadDb(unsigned char* data)
+{
+    const GamepadDbHeader* header = (const GamepadDbHeader*)data;
+    gamepadDb.data = data;
+    gamepadDb.slotCount = header->slotCount;
+    gamepadDb.slots = (GamepadMappingSlot*)(data + sizeof(GamepadDbHeader));
+    gamepadDb.text = (const char*)(gamepadDb.slots + header->slotCount);
+}
+
+// Builds the table from the text, every line goes in under its GUID and under its name.
+// Later lines replace earlier ones of the same GUID or name
+static unsigned char* ParseGamepadDb(const char* text, long long sourceTime, int* size)
+{
+    int textLength = (int)strlen(text);
+    int lines = 1;
+    for (int i = 0; i < textLength; ++i) {
+        if (text[i] == '\n') ++lines;
+    }
+    int slotCount = 16;
+    while (slotCount < 4 * lines) slotCount *= 2;
+
+    int capacity = (int)(sizeof(GamepadDbHeader) + slotCount * sizeof(GamepadMappingSlot)) + textLength + lines;
+    unsigned char* data = (unsigned char*)RL_CALLOC(capacity, 1);
+    if (data == NULL) return NULL;
+    GamepadMappingSlot* slots = (GamepadMappingSlot*)(data + sizeof(GamepadDbHeader));
+    char* mappings = (char*)(slots + slotCount);
+
+    int textSize = 0;
+    int count = 0;
+    for (const char* at = text; *at != '\0'; ) {
+        const char* line = at;
+        while (*at != '\n' && *at != '\0') ++at;
+        int length = (int)(at - line);
+        if (*at == '\n') ++at;
+        while (length > 0 && line[length - 1] == '\r') --length;
+
+        unsigned char guid[GAMEPAD_GUID_SIZE];
+        if (length <= 2 * GAMEPAD_GUID_SIZE || !ParseGuid(line, guid) || !IsPlatformLine(line, length)) continue;
+
+        GamepadMappingSlot* slot = FindSlot(slots, slotCount, guid);
+        if (slot == NULL) continue;
+        if (slot->length == 0) ++count;
+        *slot = (GamepadMappingSlot){ .offset = textSize, .length = length };
+        memcpy(slot->guid, guid, GAMEPAD_GUID_SIZE);
+
+        // The name runs from after the GUID to the next comma
+        const char* name = line + 2 * GAMEPAD_GUID_SIZE + 1;
+        int nameLength = 0;
+        while (name + nameLength < line + length && name[nameLength] != ',') ++nameLength;
+        unsigned char key[GAMEPAD_GUID_SIZE];
+        NameKey(name, nameLength, key);
+        slot = FindSlot(slots, slotCount, key);
+        if (slot != NULL) {
+            *slot = (GamepadMappingSlot){ .offset = textSize, .length = length };
+            memcpy(slot->guid, key, GAMEPAD_GUID_SIZE);
+        }
+
+        memcpy(mappings + textSize, line, length);
+        textSize += length + 1;
+    }
+
+    GamepadDbHeader header = { GAMEPAD_DB_MAGIC, GAMEPAD_DB_VERSION, slotCount, textSize, sourceTime };
+    memcpy(data, &header, sizeof(header));
+    *size = (int)(sizeof(GamepadDbHeader) + slotCount * sizeof(GamepadMappingSlot)) + textSize;
+    TraceLog(LOG_INFO, "GAMEPAD: %i mappings for %s", count, GAMEPAD_PLATFORM);
+    return data;
+}
+
+static unsigned char* LoadGamepadDbBinary(const char* fileName, long long sourceTime)
+{
+    if (!FileExists(fileName)) return NULL;
+
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    if (data == NULL) return NULL;
+
+    GamepadDbHeader header = { 0 };
+    if (size >= (int)sizeof(header)) memcpy(&header, data, sizeof(header));
+    // The slot count is bounded by the file size before it gets multiplied and the text
+    // size is compared to what is left, a damaged header can't overflow either
+    bool valid = header.magic == GAMEPAD_DB_MAGIC && header.version == GAMEPAD_DB_VERSION &&
+        header.sourceTime == sourceTime && header.slotCount > 0 && (header.slotCount & (header.slotCount - 1)) == 0 &&
+        header.slotCount <= (size - (int)sizeof(header)) / (int)sizeof(GamepadMappingSlot) &&
+        header.textSize == size - (int)(sizeof(header) + header.slotCount * sizeof(GamepadMappingSlot));
+
+    // Every line has to end inside the text, lookups hand them to raylib as they are
+    // A table without a free slot is damaged, the table is made with twice the slots needed
+    const GamepadMappingSlot* slots = (const GamepadMappingSlot*)(data + sizeof(header));
+    const char* text = (const char*)(slots + (valid ? header.slotCount : 0));
+    int freeSlots = 0;
+    for (int i = 0; valid && i < header.slotCount; ++i) {
+        if (slots[i].length == 0) {
+            ++freeSlots;
+            continue;
+        }
+        valid = slots[i].offset >= 0 && slots[i].length > 0 && slots[i].length < header.textSize - slots[i].offset &&
+            text[slots[i].offset + slots[i].length] == '\0';
+    }
+    valid = valid && freeSlots > 0;
+
+    if (!valid) {
+        UnloadFileData(data);
+        return NULL;
+    }
+    return data;
+}
+
+#if defined(GAMEPAD_LOOKUP)
+// Hands the mapping of the gamepad to raylib, a hash lookup by its GUID or, without
+// GLFW, by its name
+static void ResolveGamepad(int gamepad)
+{
+    unsigned char key[GAMEPAD_GUID_SIZE];
+#if defined(GAMEPAD_GLFW)
+    const char* id = glfwGetJoystickGUID(gamepad);
+    if (id == NULL || !ParseGuid(id, key)) return;
+#else
+    const char* id = GetGamepadName(gamepad);
+    if (id == NULL) return;
+    NameKey(id, (int)strlen(id), key);
+#endif
+
+    const GamepadMappingSlot* slot = FindSlot(gamepadDb.slots, gamepadDb.slotCount, key);
+    if (slot == NULL || slot->length == 0) {
+        TraceLog(LOG_INFO, "GAMEPAD: [ID %i] %s is not in the database", gamepad, id);
+        return;
+    }
+    SetGamepadMappings(gamepadDb.text + slot->offset);
+    TraceLog(LOG_INFO, "GAMEPAD: [ID %i] Mapped as %s", gamepad, GetGamepadName(gamepad));
+}
+#endif
+
+//----------------------------------------------------------------------------------
+// Gamepad Functions
+//----------------------------------------------------------------------------------
+
+// Loads the database from the text file, or its binary form when that is up to date.
+// Gamepads connected at the time get resolved by the next UpdateGamepads()
+void LoadGamepadMappings(const char* fileName)
+{
+    UnloadGamepadMappings();
+    if (!FileExists(fileName)) {
+        TraceLog(LOG_INFO, "GAMEPAD: No %s, using the built in mappings", fileName);
+        return;
+    }
+
+    char binaryFile[512];
+    snprintf(binaryFile, sizeof(binaryFile), "%s/%s.bin", GetDirectoryPath(fileName), GetFileNameWithoutExt(fileName));
+    long long sourceTime = GetFileModTime(fileName);
+
+    unsigned char* data = LoadGamepadDbBinary(binaryFile, sourceTime);
+    if (data != NULL) {
+        SetGamepadDb(data);
+        TraceLog(LOG_INFO, "GAMEPAD: Loaded %s", binaryFile);
+        return;
+    }
+
+    char* text = LoadFileText(fileName);
+    if (text == NULL) return;
+    int size = 0;
+    data = ParseGamepadDb(text, sourceTime, &size);
+    UnloadFileText(text);
+    if (data == NULL) return;
+    SetGamepadDb(data);
+
+    if (!SaveFileData(binaryFile, data, size)) {
+        TraceLog(LOG_WARNING, "GAMEPAD: Could not write %s", binaryFile);
+    }
+}
+
+void UnloadGamepadMappings(void)
+{
+    RL_FREE(gamepadDb.data);
+    memset(&gamepadDb, 0, sizeof(gamepadDb));
+}
+
+// Resolves the gamepads that got connected since the last call, once per frame
+void UpdateGamepads(void)
+{
+#if defined(GAMEPAD_LOOKUP)
+    if (gamepadDb.data == NULL) return;
+    for (int g = 0; g < INPUT_MAX_GAMEPADS; ++g) {
+#if defined(GAMEPAD_GLFW)
+        bool present = glfwJoystickPresent(g) != 0;
+#else
+        bool present = IsGamepadAvailable(g);
+#endif
+        if (present && !gamepadDb.connected[g]) ResolveGamepad(g);
+        gamepadDb.connected[g] = present;
+    }
+#endif
+}
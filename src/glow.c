@@ -0,0 +1,466 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Glow, phosphor persistence and bloom of a vector monitor over the finished frame
+*
+*   The frame gets reduced to a quarter of its resolution (two bilinear halvings, a box
+*   filter), added to an accumulation buffer that fades by half every GLOW_HALF_LIFE
+*   seconds, blurred with a separable Gaussian and added back onto the frame. Lines leave
+*   short trails and everything bright gets a halo, at 1080p all of it works on two
+*   540 line and four 270 line targets. It can be switched on and off any time, the
+*   targets are made when it is first needed.
+*
+*   Frames of the software rasterizer (canvas.c) get the same on the CPU, in brightness
+*   only so the glow is white like the phosphor: the quarter resolution buffers are 8.8
+*   fixed point, a cell per tile of the raster, and the blur is a 9 tap binomial. Line
+*   art covers only a few percent of the frame, so every step only looks at what can
+*   glow: the cells of the tiles the rasterizer marked, the span of each row between its
+*   first and last cell with glow, and the squares between cell centers bright enough to
+*   add anything when it is interpolated back up. At 1080p that is about half a
+*   millisecond a frame.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "screens.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB) || defined(PLATFORM_ANDROID) || defined(PLATFORM_DRM)
+    #define GLOW_SHADER_HEADER \
+        "#version 100\n" \
+        "precision mediump float;\n" \
+        "varying vec2 fragTexCoord;\n" \
+        "varying vec4 fragColor;\n" \
+        "#define SAMPLE texture2D\n" \
+        "#define OUTPUT gl_FragColor\n"
+#else
+    #define GLOW_SHADER_HEADER \
+        "#version 330\n" \
+        "in vec2 fragTexCoord;\n" \
+        "in vec4 fragColor;\n" \
+        "out vec4 finalColor;\n" \
+        "#define SAMPLE texture\n" \
+        "#define OUTPUT finalColor\n"
+#endif
+
+//----------------------------------------------------------------------------------
+// Glow Definition
+//----------------------------------------------------------------------------------
+#define GLOW_SCALE RASTER_TILE          // Frame pixels per glow cell on each axis, a cell per tile
+#define GLOW_HALF_LIFE 0.04f            // Seconds until a trail is half as bright
+#define GLOW_INTENSITY 3.0f             // Of the blurred glow added to the frame
+#define GLOW_FLOOR 2                    // Brightness taken off the accumulation every frame
+
+// 9 tap Gaussian in 5 bilinear samples along direction, one texel apart
+static const char* glowBlurShader = GLOW_SHADER_HEADER
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "uniform vec2 direction;\n"
+    "uniform float intensity;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 sum = SAMPLE(texture0, fragTexCoord) * 0.2270270270;\n"
+    "    sum += (SAMPLE(texture0, fragTexCoord + direction * 1.3846153846) + SAMPLE(texture0, fragTexCoord - direction * 1.3846153846)) * 0.3162162162;\n"
+    "    sum += (SAMPLE(texture0, fragTexCoord + direction * 3.2307692308) + SAMPLE(texture0, fragTexCoord - direction * 3.2307692308)) * 0.0702702703;\n"
+    "    OUTPUT = vec4(sum.rgb * intensity, 1.0) * colDiffuse * fragColor;\n"
+    "}\n";
+
+// Binomial weights of the CPU blur, they add up to 256
+static const int glowWeights[9] = { 1, 8, 28, 56, 70, 56, 28, 8, 1 };
+
+// Cells first..last of a row of the CPU buffers may have glow, all others are black.
+// An empty span has first > last
+typedef struct GlowSpan {
+    int first;
+    int last;
+} GlowSpan;
+
+typedef struct Glow {
+    bool enabled;
+    bool reset;                         // The accumulation is stale, clear it first
+
+    Shader blur;
+    int directionLoc;
+    int intensityLoc;
+    RenderTexture2D half;
+    RenderTexture2D accum[2];           // Previous and current frame
+    RenderTexture2D blurred;            // After the horizontal pass
+    RenderTexture2D bloom;              // After the vertical pass
+    int current;
+    int sceneWidth;                     // Size the targets were made for
+    int sceneHeight;
+
+    unsigned short* cells;              // CPU accumulation, brightness in 8.8 fixed point
+    unsigned short* blurredCells;
+    unsigned short* bloomCells;
+    GlowSpan* spans;                    // Of the rows of all three, in one allocation
+    GlowSpan* cellSpans;
+    GlowSpan* blurredSpans;
+    GlowSpan* bloomSpans;
+    int* line;                          // Sums of one row of cells
+    int cellWidth;
+    int cellHeight;
+} Glow;
+
+static Glow glow = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static void UnloadGlowTargets(void)
+{
+    if (glow.sceneWidth == 0) return;
+    UnloadRenderTexture(glow.half);
+    UnloadRenderTexture(glow.accum[0]);
+    UnloadRenderTexture(glow.accum[1]);
+    UnloadRenderTexture(glow.blurred);
+    UnloadRenderTexture(glow.bloom);
+    glow.sceneWidth = 0;
+    glow.sceneHeight = 0;
+}
+
+static RenderTexture2D LoadGlowTarget(int width, int height)
+{
+    RenderTexture2D target = LoadRenderTexture(width, height);
+    SetTextureFilter(target.texture, TEXTURE_FILTER_BILINEAR);
+    SetTextureWrap(target.texture, TEXTURE_WRAP_CLAMP);
+    return target;
+}
+
+static void LoadGlowTargets(int width, int height)
+{
+    UnloadGlowTargets();
+    glow.half = LoadGlowTarget(width / 2, height / 2);
+    glow.accum[0] = LoadGlowTarget(width / GLOW_SCALE, height / GLOW_SCALE);
+    glow.accum[1] = LoadGlowTarget(width / GLOW_SCALE, height / GLOW_SCALE);
+    glow.blurred = LoadGlowTarget(width / GLOW_SCALE, height / GLOW_SCALE);
+    glow.bloom = LoadGlowTarget(width / GLOW_SCALE, height / GLOW_SCALE);
+    glow.sceneWidth = width;
+    glow.sceneHeight = height;
+    glow.reset = true;
+}
+
+// Stretches a render texture over the whole target, render textures are upside down
+static void DrawStretched(RenderTexture2D target, Texture2D texture, Color tint)
+{
+    Rectangle source = { 0, 0, (float)texture.width, -(float)texture.height };
+    Rectangle dest = { 0, 0, (float)target.texture.width, (float)target.texture.height };
+    DrawTexturePro(texture, source, dest, (Vector2){ 0, 0 }, 0.0f, tint);
+}
+
+static void BlurInto(RenderTexture2D target, Texture2D texture, Vector2 direction, float intensity)
+{
+    BeginTextureMode(target);
+    ClearBackground(BLACK);
+    BeginShaderMode(glow.blur);
+    SetShaderValue(glow.blur, glow.directionLoc, &direction, SHADER_UNIFORM_VEC2);
+    SetShaderValue(glow.blur, glow.intensityLoc, &intensity, SHADER_UNIFORM_FLOAT);
+    DrawStretched(target, texture, WHITE);
+    EndShaderMode();
+    EndTextureMode();
+}
+
+static void UnloadGlowCells(void)
+{
+    RL_FREE(glow.cells);
+    RL_FREE(glow.blurredCells);
+    RL_FREE(glow.bloomCells);
+    RL_FREE(glow.spans);
+    RL_FREE(glow.line);
+    glow.cells = glow.blurredCells = glow.bloomCells = NULL;
+    glow.spans = NULL;
+    glow.line = NULL;
+    glow.cellWidth = 0;
+    glow.cellHeight = 0;
+}
+
+static bool LoadGlowCells(int cellWidth, int cellHeight)
+{
+    UnloadGlowCells();
+    int count = cellWidth * cellHeight;
+    glow.cells = (unsigned short*)RL_CALLOC(count, sizeof(unsigned short));
+    glow.blurredCells = (unsigned short*)RL_CALLOC(count, sizeof(unsigned short));
+    glow.bloomCells = (unsigned short*)RL_CALLOC(count, sizeof(unsigned short));
+    glow.spans = (GlowSpan*)RL_CALLOC(3 * cellHeight, sizeof(GlowSpan));
+    glow.line = (int*)RL_CALLOC(cellWidth, sizeof(int));
+    if (glow.cells == NULL || glow.blurredCells == NULL || glow.bloomCells == NULL || glow.spans == NULL || glow.line == NULL) {
+        UnloadGlowCells();
+        return false;
+    }
+    glow.cellSpans = glow.spans;
+    glow.blurredSpans = glow.spans + cellHeight;
+    glow.bloomSpans = glow.spans + 2 * cellHeight;
+    for (int i = 0; i < 3 * cellHeight; ++i) glow.spans[i] = (GlowSpan){ cellWidth, -1 };
+    glow.cellWidth = cellWidth;
+    glow.cellHeight = cellHeight;
+    return true;
+}
+
+// Zeroes the old span of a row, before the row gets its new one
+static void ClearSpan(unsigned short* row, GlowSpan* span, int width)
+{
+    if (span->first <= span->last) memset(row + span->first, 0, (span->last - span->first + 1) * sizeof(unsigned short));
+    *span = (GlowSpan){ width, -1 };
+}
+
+// Narrows a span down to the first and last cell with glow, the tails of the blur
+// round down to black
+static GlowSpan TrimSpan(const unsigned short* row, GlowSpan span)
+{
+    while (span.first <= span.last && row[span.first] == 0) ++span.first;
+    while (span.last >= span.first && row[span.last] == 0) --span.last;
+    return span;
+}
+
+// Box filters the brightness of the cells under the marked tiles of the raster and adds
+// it to the faded accumulation, the rest only fades. Brightness is (r + 2g + b) / 4,
+// the phosphor glows white. The floor ends the faint tails of the trails as on the GPU
+static void AccumulateCells(const Raster* raster, int decay)
+{
+    int cellWidth = glow.cellWidth;
+    for (int cy = 0; cy < glow.cellHeight; ++cy) {
+        unsigned short* cells = glow.cells + cy * cellWidth;
+        GlowSpan span = glow.cellSpans[cy];
+        for (int cx = span.first; cx <= span.last; ++cx) {
+            int value = ((cells[cx] * decay) >> 8) - (GLOW_FLOOR << 8);
+            cells[cx] = (unsigned short)((value > 0) ? value : 0);
+        }
+        span = TrimSpan(cells, span);
+
+        const unsigned char* tiles = raster->tiles + cy * raster->tileWidth;
+        const unsigned char* tile = tiles;
+        while ((tile = (const unsigned char*)memchr(tile, 1, cellWidth - (tile - tiles))) != NULL) {
+            int cx = (int)(tile++ - tiles);
+            int sum = 0;
+            for (int y = cy * GLOW_SCALE; y < (cy + 1) * GLOW_SCALE; ++y) {
+                const Color* p = raster->pixels + y * raster->width + cx * GLOW_SCALE;
+                for (int x = 0; x < GLOW_SCALE; ++x) sum += p[x].r + 2 * p[x].g + p[x].b;
+            }
+            if (sum == 0) continue;
+
+            // The pixels of the cell at 4 times the brightness, in 8.8 that is the sum
+            // times 4 for the 16 pixels of a 4x4 cell
+            int value = cells[cx] + sum * 64 / (GLOW_SCALE * GLOW_SCALE);
+            cells[cx] = (unsigned short)((value < 0xffff) ? value : 0xffff);
+            if (cx < span.first) span.first = cx;
+            if (cx > span.last) span.last = cx;
+        }
+        glow.cellSpans[cy] = span;
+    }
+}
+
+// Horizontal pass of the binomial blur, one tap at a time along the span of the row
+// and the four cells on either side. Cells outside are black
+static void BlurRows(const unsigned short* from, const GlowSpan* fromSpans, unsigned short* to, GlowSpan* toSpans, int width, int height)
+{
+    int* sums = glow.line;
+    for (int y = 0; y < height; ++y) {
+        unsigned short* out = to + y * width;
+        ClearSpan(out, &toSpans[y], width);
+        if (fromSpans[y].first > fromSpans[y].last) continue;
+
+        const unsigned short* in = from + y * width;
+        GlowSpan span = { (fromSpans[y].first > 4) ? fromSpans[y].first - 4 : 0, (fromSpans[y].last < width - 5) ? fromSpans[y].last + 4 : width - 1 };
+        memset(sums + span.first, 0, (span.last - span.first + 1) * sizeof(int));
+        for (int k = 0; k < 9; ++k) {
+            int first = (span.first + k - 4 < 0) ? 4 - k : span.first;
+            int last = (span.last + k - 4 >= width) ? width + 3 - k : span.last;
+            for (int x = first; x <= last; ++x) {
+                sums[x] += glowWeights[k] * in[x + k - 4];
+            }
+        }
+        for (int x = span.first; x <= span.last; ++x) {
+            out[x] = (unsigned short)(sums[x] >> 8);
+        }
+        toSpans[y] = TrimSpan(out, span);
+    }
+}
+
+// Vertical pass, row by row so the inner loop runs along memory. A row covers the spans
+// of the nine rows around it, and only adds up each of them along its own span
+static void BlurColumns(const unsigned short* from, const GlowSpan* fromSpans, unsigned short* to, GlowSpan* toSpans, int width, int height)
+{
+    int* sums = glow.line;
+    for (int y = 0; y < height; ++y) {
+        unsigned short* out = to + y * width;
+        ClearSpan(out, &toSpans[y], width);
+
+        GlowSpan span = { width, -1 };
+        for (int row = (y > 4) ? y - 4 : 0; row <= y + 4 && row < height; ++row) {
+            if (fromSpans[row].first < span.first) span.first = fromSpans[row].first;
+            if (fromSpans[row].last > span.last) span.last = fromSpans[row].last;
+        }
+        if (span.first > span.last) continue;
+
+        memset(sums + span.first, 0, (span.last - span.first + 1) * sizeof(int));
+        for (int k = 0; k < 9; ++k) {
+            int row = y + k - 4;
+            if (row < 0 || row >= height) continue;
+            const unsigned short* in = from + row * width;
+            for (int x = fromSpans[row].first; x <= fromSpans[row].last; ++x) {
+                sums[x] += glowWeights[k] * in[x];
+            }
+        }
+        for (int x = span.first; x <= span.last; ++x) {
+            out[x] = (unsigned short)(sums[x] >> 8);
+        }
+        toSpans[y] = TrimSpan(out, span);
+    }
+}
+
+// Saturating add of all four channels in one word, alpha gets nothing added
+static inline void AddGlowPixel(unsigned int* pixel, int value)
+{
+    unsigned int a = *pixel, b = (unsigned int)value * 0x00010101u;
+    unsigned int sum = ((a & 0x7f7f7f7fu) + (b & 0x7f7f7f7fu)) ^ ((a ^ b) & 0x80808080u);
+    unsigned int carry = ((a & b) | ((a | b) & ~sum)) & 0x80808080u;
+    *pixel = sum | ((carry >> 7) * 0xffu);
+}
+
+// Adds the glow, bilinear between the cell centers, which lie 2 pixels into the cells.
+// Goes through the squares between each four neighbouring centers along the spans of
+// their two rows. Squares whose corners are too faint to round up to any glow are
+// skipped whole, the others interpolate the left and right side of each row of pixels
+// and the pixels between them
+static void AddGlowToRaster(Raster* raster)
+{
+    int width = raster->width;
+    int height = raster->height;
+    int cellWidth = glow.cellWidth;
+    int scale = (int)(GLOW_INTENSITY * 256.0f) >> 2;
+    int faint = ((2 << 16) - 1) / (2 * GLOW_SCALE * scale);    // Corners up to this add nothing
+
+    // Above the first row of centers and below the last both rows are the same cells
+    for (int cy = -1; cy < glow.cellHeight; ++cy) {
+        int topRow = (cy < 0) ? 0 : cy;
+        int bottomRow = (cy + 1 < glow.cellHeight) ? cy + 1 : glow.cellHeight - 1;
+        GlowSpan span = glow.bloomSpans[topRow];
+        if (glow.bloomSpans[bottomRow].first < span.first) span.first = glow.bloomSpans[bottomRow].first;
+        if (glow.bloomSpans[bottomRow].last > span.last) span.last = glow.bloomSpans[bottomRow].last;
+        if (span.first > span.last) continue;
+
+        const unsigned short* top = glow.bloomCells + topRow * cellWidth;
+        const unsigned short* bottom = glow.bloomCells + bottomRow * cellWidth;
+        for (int cx = span.first - 1; cx <= span.last; ++cx) {
+            int left = (cx < 0) ? 0 : cx;
+            int right = (cx + 1 < cellWidth) ? cx + 1 : cellWidth - 1;
+            if ((top[left] | top[right] | bottom[left] | bottom[right]) <= faint) continue;
+
+            // Only the squares at the edges of the raster stick out of it
+            int x = cx * GLOW_SCALE + GLOW_SCALE / 2;
+            int y = cy * GLOW_SCALE + GLOW_SCALE / 2;
+            int firstI = (x < 0) ? -x : 0;
+            int lastI = (x + GLOW_SCALE > width) ? width - x : GLOW_SCALE;
+            int firstJ = (y < 0) ? -y : 0;
+            int lastJ = (y + GLOW_SCALE > height) ? height - y : GLOW_SCALE;
+            for (int j = firstJ; j < lastJ; ++j) {
+                // The sides hold twice the glow, the horizontal weights add up to 8 more
+                int wy = 2 * j + 1;
+                int leftGlow = ((top[left] * (2 * GLOW_SCALE - wy) + bottom[left] * wy) * scale) >> 16;
+                int rightGlow = ((top[right] * (2 * GLOW_SCALE - wy) + bottom[right] * wy) * scale) >> 16;
+                unsigned int* pixels = (unsigned int*)(raster->pixels + (y + j) * width + x);
+                for (int i = firstI; i < lastI; ++i) {
+                    int value = (leftGlow * (2 * GLOW_SCALE - 2 * i - 1) + rightGlow * (2 * i + 1)) >> 4;
+                    AddGlowPixel(&pixels[i], (value < 255) ? value : 255);
+                }
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------
+// Glow Functions
+//----------------------------------------------------------------------------------
+
+void SetGlowEnabled(bool enabled)
+{
+    // Trails from the last time it was on would flash up
+    if (enabled && !glow.enabled) glow.reset = true;
+    glow.enabled = enabled;
+}
+
+bool IsGlowEnabled(void)
+{
+    return glow.enabled;
+}
+
+// Adds the glow of the scene, a render texture, over dest in the current target.
+// dt is the time since the last frame, for the persistence
+void DrawGlow(Texture2D scene, Rectangle dest, float dt)
+{
+    if (!glow.enabled) return;
+
+    if (glow.blur.id == 0) {
+        glow.blur = LoadShaderFromMemory(NULL, glowBlurShader);
+        glow.directionLoc = GetShaderLocation(glow.blur, "direction");
+        glow.intensityLoc = GetShaderLocation(glow.blur, "intensity");
+    }
+    if (scene.width != glow.sceneWidth || scene.height != glow.sceneHeight) LoadGlowTargets(scene.width, scene.height);
+
+    RenderTexture2D previous = glow.accum[glow.current];
+    glow.current ^= 1;
+    RenderTexture2D accum = glow.accum[glow.current];
+
+    BeginTextureMode(glow.half);
+    ClearBackground(BLACK);
+    DrawStretched(glow.half, scene, WHITE);
+    EndTextureMode();
+
+    BeginTextureMode(accum);
+    ClearBackground(BLACK);
+    if (!glow.reset) {
+        unsigned char decay = (unsigned char)(255.0f * powf(0.5f, dt / GLOW_HALF_LIFE));
+        DrawStretched(accum, previous.texture, (Color){ decay, decay, decay, 255 });
+
+        // Faint values round back up to where they were, they would never fade out
+        rlSetBlendFactors(RL_ONE, RL_ONE, RL_FUNC_REVERSE_SUBTRACT);
+        BeginBlendMode(BLEND_CUSTOM);
+        DrawRectangle(0, 0, accum.texture.width, accum.texture.height, (Color){ GLOW_FLOOR, GLOW_FLOOR, GLOW_FLOOR, 0 });
+        EndBlendMode();
+    }
+    BeginBlendMode(BLEND_ADDITIVE);
+    DrawStretched(accum, glow.half.texture, WHITE);
+    EndBlendMode();
+    EndTextureMode();
+    glow.reset = false;
+
+    BlurInto(glow.blurred, accum.texture, (Vector2){ 1.0f / accum.texture.width, 0 }, 1.0f);
+    BlurInto(glow.bloom, glow.blurred.texture, (Vector2){ 0, 1.0f / accum.texture.height }, GLOW_INTENSITY);
+
+    Rectangle source = { 0, 0, (float)glow.bloom.texture.width, -(float)glow.bloom.texture.height };
+    BeginBlendMode(BLEND_ADDITIVE);
+    DrawTexturePro(glow.bloom.texture, source, dest, (Vector2){ 0, 0 }, 0.0f, WHITE);
+    EndBlendMode();
+}
+
+// The same for a frame of the software rasterizer, its size has to be a multiple of 4
+void ApplyRasterGlow(Raster* raster, float dt)
+{
+    if (!glow.enabled) return;
+
+    int cellWidth = raster->width / GLOW_SCALE;
+    int cellHeight = raster->height / GLOW_SCALE;
+    if (cellWidth != glow.cellWidth || cellHeight != glow.cellHeight) {
+        if (!LoadGlowCells(cellWidth, cellHeight)) return;
+        glow.reset = true;
+    }
+
+    int decay = glow.reset ? 0 : (int)(256.0f * powf(0.5f, dt / GLOW_HALF_LIFE));
+    glow.reset = false;
+    AccumulateCells(raster, decay);
+    BlurRows(glow.cells, glow.cellSpans, glow.blurredCells, glow.blurredSpans, cellWidth, cellHeight);
+    BlurColumns(glow.blurredCells, glow.blurredSpans, glow.bloomCells, glow.bloomSpans, cellWidth, cellHeight);
+    AddGlowToRaster(raster);
+}
+
+void UnloadGlow(void)
+{
+    UnloadGlowTargets();
+    if (glow.blur.id != 0) UnloadShader(glow.blur);
+    glow.blur = (Shader){ 0 };
+    UnloadGlowCells();
+}
@@ -0,0 +1,274 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Highscore store, sorted integer scores kept in a binary file
+*
+*   The table is an array of name and score pairs sorted from the highest score down, so
+*   the rank of a score is a binary search and the top of the table is what the title
+*   screen shows. It can hold thousands of entries, every venue (--venue <name>) gets a
+*   file of its own.
+*
+*   The file is a header with a checksum followed by the entries. It is never written in
+*   place: the new table goes to a temporary file that gets flushed to disk and then
+*   renamed over the old one, so a crash or power loss leaves either the old or the new
+*   table behind. Without a table file the old text format (high.txt) gets imported, a
+*   table that fails its checks is moved aside to <file>.bad instead of being overwritten.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB)
+    // Files live in memory, there is nothing to flush
+#elif defined(_WIN32)
+    // windows.h doesn't mix with raylib.h, the functions needed are declared here
+    #include <io.h>
+    __declspec(dllimport) int __stdcall MoveFileExA(const char* existingFileName, const char* newFileName, unsigned long flags);
+    #define MOVEFILE_REPLACE_EXISTING 0x1
+    #define MOVEFILE_WRITE_THROUGH 0x8
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Highscore File Definition
+//----------------------------------------------------------------------------------
+#define HIGHSCORE_MAGIC 0x43534948      // "HISC"
+#define HIGHSCORE_VERSION 1
+#define HIGHSCORE_LEGACY_FILE "high.txt"
+
+typedef struct HighscoreHeader {
+    unsigned int magic;
+    int version;
+    int count;
+    unsigned int checksum;      // FNV-1a over the entries
+} HighscoreHeader;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static unsigned int HashEntries(const HighscoreEntry* entries, int count)
+{
+    const unsigned char* bytes = (const unsigned char*)entries;
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < (size_t)count * sizeof(HighscoreEntry); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// The table that comes with the game
+static void SetDefaultScores(HighscoreTable* table)
+{
+    int high = 15000;
+    for (int i = 0; i < MAX_HIGHSCORES; ++i) {
+        InsertHighscore(table, "HAS", high);
+        high -= 2000;
+    }
+}
+
+// Reads the comma separated name,score pairs of older versions
+static bool ImportHighscoreText(HighscoreTable* table, const char* fileName)
+{
+    if (!FileExists(fileName)) return false;
+    char* highscoreText = LoadFileText(fileName);
+    if (highscoreText == NULL) return false;
+
+    int count = 0;
+    const char** splits = TextSplit(highscoreText, ',', &count);
+    bool valid = count >= 2 && count % 2 == 0;
+    for (int i = 0; valid && i < count; i += 2) {
+        InsertHighscore(table, splits[i], TextToInteger(splits[i + 1]));
+    }
+    UnloadFileText(highscoreText);
+
+    if (valid) TraceLog(LOG_INFO, "HIGHSCORE: Imported %i scores from %s", count / 2, fileName);
+    return valid;
+}
+
+static bool LoadHighscoreFile(HighscoreTable* table, const char* fileName)
+{
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    if (data == NULL) return false;
+
+    HighscoreHeader header = { 0 };
+    if (size >= (int)sizeof(header)) memcpy(&header, data, sizeof(header));
+    const HighscoreEntry* entries = (const HighscoreEntry*)(data + sizeof(header));
+    // The count is bounded by the file size before it gets multiplied, a damaged count can't overflow
+    bool valid = header.magic == HIGHSCORE_MAGIC && header.version == HIGHSCORE_VERSION && header.count >= 0 &&
+        header.count <= (size - (int)sizeof(header)) / (int)sizeof(HighscoreEntry) &&
+        size == (int)(sizeof(header) + header.count * sizeof(HighscoreEntry)) &&
+        HashEntries(entries, header.count) == header.checksum;
+    for (int i = 1; valid && i < header.count; ++i) {
+        valid = entries[i].score <= entries[i - 1].score;
+    }
+
+    if (valid) {
+        table->count = (header.count < table->capacity) ? header.count : table->capacity;
+        memcpy(table->entries, entries, table->count * sizeof(HighscoreEntry));
+        for (int i = 0; i < table->count; ++i) {
+            table->entries[i].name[HIGHSCORE_NAME_LENGTH] = '\0';
+        }
+    }
+    else TraceLog(LOG_WARNING, "HIGHSCORE: %s is damaged or of another version", fileName);
+
+    UnloadFileData(data);
+    return valid;
+}
+
+// Writes the data into a temporary file and flushes it to disk before it replaces the
+// file, readers see either the old or the new content but never a partial write
+static bool SaveFileAtomic(const char* fileName, const void* data, int size)
+{
+    char tempName[HIGHSCORE_FILE_NAME_SIZE + 8];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+
+    FILE* file = fopen(tempName, "wb");
+    if (file == NULL) return false;
+    bool written = fwrite(data, 1, size, file) == (size_t)size && fflush(file) == 0;
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = (fclose(file) == 0) && written;
+    if (!written) {
+        remove(tempName);
+        return false;
+    }
+
+#if defined(_WIN32) && !defined(PLATFORM_WEB)
+    bool renamed = MoveFileExA(tempName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool renamed = rename(tempName, fileName) == 0;
+#endif
+    if (!renamed) {
+        remove(tempName);
+        return false;
+    }
+
+#if !defined(PLATFORM_WEB) && !defined(_WIN32)
+    // The rename itself only survives a power loss once the directory is on disk
+    int directory = open(GetDirectoryPath(fileName), O_RDONLY);
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+#endif
+    return true;
+}
+
+//----------------------------------------------------------------------------------
+// Highscore Functions
+//----------------------------------------------------------------------------------
+
+// File of the given venue, the default table without one. Only letters, digits, '-'
+// and '_' of the venue name are used
+const char* GetHighscoreFileName(const char* venue)
+{
+    static char fileName[HIGHSCORE_FILE_NAME_SIZE];
+    if (venue == NULL || venue[0] == '\0') return "highscores.bin";
+
+    int length = snprintf(fileName, sizeof(fileName), "highscores-");
+    for (const char* c = venue; *c != '\0' && length < HIGHSCORE_FILE_NAME_SIZE - 5; ++c) {
+        bool allowed = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '-' || *c == '_';
+        if (allowed) fileName[length++] = *c;
+    }
+    memcpy(fileName + length, ".bin", 5);
+    return fileName;
+}
+
+// Loads the table of the file, keeps at most capacity entries. Without a file the
+// old text table or the default scores are used, those only get written on the
+// next insert. A damaged file is renamed to <file>.bad first, so it can be recovered
+void LoadHighscores(HighscoreTable* table, const char* fileName, int capacity)
+{
+    UnloadHighscores(table);
+    table->entries = (HighscoreEntry*)RL_CALLOC(capacity, sizeof(HighscoreEntry));
+    table->capacity = (table->entries != NULL) ? capacity : 0;
+    table->count = 0;
+    TextCopy(table->fileName, TextSubtext(fileName, 0, HIGHSCORE_FILE_NAME_SIZE - 1));
+
+    if (FileExists(fileName)) {
+        if (LoadHighscoreFile(table, fileName)) {
+            TraceLog(LOG_INFO, "HIGHSCORE: Loaded %i scores from %s", table->count, fileName);
+            return;
+        }
+
+        // The next insert writes a new table, the damaged one is kept next to it
+        char badName[HIGHSCORE_FILE_NAME_SIZE + 8];
+        snprintf(badName, sizeof(badName), "%s.bad", fileName);
+        remove(badName);
+        if (rename(fileName, badName) == 0) TraceLog(LOG_WARNING, "HIGHSCORE: Kept the damaged table as %s", badName);
+        else TraceLog(LOG_WARNING, "HIGHSCORE: Could not move the damaged table aside, it gets replaced");
+    }
+    table->count = 0;
+    if (!ImportHighscoreText(table, HIGHSCORE_LEGACY_FILE)) SetDefaultScores(table);
+}
+
+// Writes the whole table to its file, see SaveFileAtomic()
+bool SaveHighscores(const HighscoreTable* table)
+{
+    int size = (int)(sizeof(HighscoreHeader) + table->count * sizeof(HighscoreEntry));
+    unsigned char* data = (unsigned char*)RL_MALLOC(size);
+    if (data == NULL) return false;
+
+    HighscoreHeader header = { HIGHSCORE_MAGIC, HIGHSCORE_VERSION, table->count, HashEntries(table->entries, table->count) };
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), table->entries, table->count * sizeof(HighscoreEntry));
+    bool saved = SaveFileAtomic(table->fileName, data, size);
+    RL_FREE(data);
+
+    if (!saved) TraceLog(LOG_WARNING, "HIGHSCORE: Could not write %s", table->fileName);
+    return saved;
+}
+
+void UnloadHighscores(HighscoreTable* table)
+{
+    RL_FREE(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+// Position the score would get in the table, -1 if it doesn't make it into the table.
+// A new score goes above equal ones that are already in the table
+int GetHighscoreRank(const HighscoreTable* table, int score)
+{
+    if (score <= 0) return -1;
+
+    int low = 0;
+    int high = table->count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (table->entries[middle].score > score) low = middle + 1;
+        else high = middle;
+    }
+    return (low < table->capacity) ? low : -1;
+}
+
+// Inserts the score at its rank, the lowest score drops out of a full table. Returns
+// the rank or -1 if the score didn't make it into the table
+int InsertHighscore(HighscoreTable* table, const char* name, int score)
+{
+    int rank = GetHighscoreRank(table, score);
+    if (rank < 0) return -1;
+
+    int moved = ((table->count < table->capacity) ? table->count : table->capacity - 1) - rank;
+    memmove(&table->entries[rank + 1], &table->entries[rank], moved * sizeof(HighscoreEntry));
+    if (table->count < table->capacity) ++table->count;
+
+    HighscoreEntry* entry = &table->entries[rank];
+    memset(entry, 0, sizeof(HighscoreEntry));
+    TextCopy(entry->name, TextSubtext(name, 0, HIGHSCORE_NAME_LENGTH));
+    entry->score = score;
+    return rank;
+}
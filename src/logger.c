@@ -0,0 +1,291 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Game log, keeps string formatting off the game thread
+*
+*   GAME_LOG_* calls only write a small binary record into a ring buffer: the call site
+*   with its format string and up to LOG_MAX_ARGS numbers. A background thread turns the
+*   records into text and passes them on to TraceLog(). Every call site logs at most
+*   LOG_SITE_PER_SECOND messages a second, the rest is counted and reported with the next
+*   message of that site. Any thread may log, when the ring is full records get dropped
+*   and counted instead of waiting. Without the background thread (web, or before
+*   InitGameLog()) records get formatted right away.
+*
+*   Only numbers can be logged this way, %s and %p print as '?'.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(PLATFORM_WEB)
+    // No background thread
+#elif defined(_WIN32)
+    // windows.h doesn't mix with raylib.h, the few functions needed are declared here
+    #include <process.h>
+    #include <intrin.h>
+    __declspec(dllimport) void __stdcall Sleep(unsigned long msTimeout);
+    __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void* handle, unsigned long msTimeout);
+    __declspec(dllimport) int __stdcall CloseHandle(void* handle);
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Log Definition
+//----------------------------------------------------------------------------------
+#define LOG_RING_SIZE 1024                  // Records, power of two
+#define LOG_SITE_PER_SECOND 10
+#define LOG_TEXT_SIZE 256
+
+#if defined(_MSC_VER)
+    #define LogLoad(value) (*(volatile long*)(value))
+    #define LogStore(value, amount) (*(volatile long*)(value) = (amount))
+    #define LogCompareExchange(value, expected, desired) (_InterlockedCompareExchange((volatile long*)(value), (desired), (expected)) == (expected))
+    #define LogIncrement(value) _InterlockedIncrement((volatile long*)(value))
+    #define LogExchange(value, desired) _InterlockedExchange((volatile long*)(value), (desired))
+#else
+    #define LogLoad(value) __atomic_load_n((value), __ATOMIC_ACQUIRE)
+    #define LogStore(value, amount) __atomic_store_n((value), (amount), __ATOMIC_RELEASE)
+    #define LogCompareExchange(value, expected, desired) __atomic_compare_exchange_n((value), &(long){ (expected) }, (desired), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+    #define LogIncrement(value) __atomic_add_fetch((value), 1, __ATOMIC_RELAXED)
+    #define LogExchange(value, desired) __atomic_exchange_n((value), (desired), __ATOMIC_RELAXED)
+#endif
+
+// The sequence tells who owns the slot: sequence == position means it is free for the
+// producer at that position, position + 1 means it is written and can be read
+typedef struct LogRecord {
+    long sequence;
+    LogSite* site;
+    int argCount;
+    int suppressed;
+    double args[LOG_MAX_ARGS];
+} LogRecord;
+
+typedef struct GameLog {
+    LogRecord ring[LOG_RING_SIZE];
+    long head;                  // Next position to write, shared by all producers
+    long tail;                  // Next position to read, only used by the consumer
+    long dropped;               // Records lost to a full ring
+    long running;               // Written by CloseGameLog(), read by every producer
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+    void* thread;
+#else
+    pthread_t thread;
+#endif
+} GameLog;
+
+static GameLog gameLog = { 0 };
+static bool gameLogInitialized = false;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+// Formats the record with the format string of its site, each conversion takes the
+// next number, converted to what the conversion expects
+static void FormatLogRecord(const LogRecord* record, char* text, int size)
+{
+    const char* format = record->site->format;
+    int length = 0;
+    int arg = 0;
+
+    while (*format != '\0' && length < size - 1) {
+        if (*format != '%') {
+            text[length++] = *format++;
+            continue;
+        }
+        if (format[1] == '%') {
+            text[length++] = '%';
+            format += 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept, length modifiers replaced
+        char spec[24] = "%";
+        int specLength = 1;
+        ++format;
+        while (*format != '\0' && strchr("-+ #0123456789.", *format) != NULL && specLength < 16) {
+            spec[specLength++] = *format++;
+        }
+        while (*format != '\0' && strchr("hlLqjzt", *format) != NULL) ++format;
+        char conversion = *format;
+        if (conversion == '\0') break;
+        ++format;
+
+        double value = (arg < record->argCount) ? record->args[arg] : 0;
+        ++arg;
+
+        int written = 0;
+        switch (conversion) {
+        case 'd': case 'i':
+            memcpy(spec + specLength, "lld", 4);
+            written = snprintf(text + length, size - length, spec, (long long)value);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            spec[specLength++] = 'l';
+            spec[specLength++] = 'l';
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            written = snprintf(text + length, size - length, spec, (unsigned long long)(long long)value);
+            break;
+        case 'c':
+            written = snprintf(text + length, size - length, "%c", (int)value);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            written = snprintf(text + length, size - length, spec, value);
+            break;
+        default:
+            written = snprintf(text + length, size - length, "?");
+            break;
+        }
+        if (written > 0) length += written;
+    }
+    if (length > size - 1) length = size - 1;
+    text[length] = '\0';
+
+    if (record->suppressed > 0) {
+        snprintf(text + length, size - length, " (%i more suppressed)", record->suppressed);
+    }
+}
+
+static void WriteLogRecord(const LogRecord* record)
+{
+    char text[LOG_TEXT_SIZE];
+    FormatLogRecord(record, text, sizeof(text));
+    TraceLog(record->site->level, "%s", text);
+}
+
+// Consumes all records written so far, only one thread may do this at a time
+static void DrainGameLog(void)
+{
+    for (;;) {
+        LogRecord* record = &gameLog.ring[gameLog.tail & (LOG_RING_SIZE - 1)];
+        if (LogLoad(&record->sequence) != gameLog.tail + 1) break;
+
+        WriteLogRecord(record);
+        LogStore(&record->sequence, gameLog.tail + LOG_RING_SIZE);
+        ++gameLog.tail;
+    }
+
+    long dropped = LogLoad(&gameLog.dropped);
+    if (dropped > 0) {
+        // Producers keep counting, only what got reported is taken off
+        while (!LogCompareExchange(&gameLog.dropped, dropped, 0)) dropped = LogLoad(&gameLog.dropped);
+        TraceLog(LOG_WARNING, "LOG: %i messages dropped, the ring was full", (int)dropped);
+    }
+}
+
+#if !defined(PLATFORM_WEB)
+#if defined(_WIN32)
+static unsigned __stdcall RunGameLog(void* data)
+#else
+static void* RunGameLog(void* data)
+#endif
+{
+    while (LogLoad(&gameLog.running)) {
+        DrainGameLog();
+#if defined(_WIN32)
+        Sleep(5);
+#else
+        usleep(5000);
+#endif
+    }
+    return 0;
+}
+#endif
+
+//----------------------------------------------------------------------------------
+// Log Functions
+//----------------------------------------------------------------------------------
+
+// Starts the thread that formats the records
+void InitGameLog(void)
+{
+    if (gameLogInitialized) return;
+    for (long i = 0; i < LOG_RING_SIZE; ++i) {
+        gameLog.ring[i].sequence = i;
+    }
+    gameLog.head = 0;
+    gameLog.tail = 0;
+    gameLog.dropped = 0;
+    gameLogInitialized = true;
+
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+    gameLog.running = 1;
+    gameLog.thread = (void*)_beginthreadex(NULL, 0, RunGameLog, NULL, 0, NULL);
+    if (gameLog.thread == NULL) gameLog.running = 0;
+#else
+    gameLog.running = 1;
+    if (pthread_create(&gameLog.thread, NULL, RunGameLog, NULL) != 0) gameLog.running = 0;
+#endif
+}
+
+// Stops the thread and writes out what is left, later messages get written right away
+void CloseGameLog(void)
+{
+    if (!gameLogInitialized) return;
+    if (LogLoad(&gameLog.running)) {
+        LogStore(&gameLog.running, 0);
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+        WaitForSingleObject(gameLog.thread, 0xFFFFFFFF);
+        CloseHandle(gameLog.thread);
+#else
+        pthread_join(gameLog.thread, NULL);
+#endif
+    }
+    DrainGameLog();
+    gameLogInitialized = false;
+}
+
+// Called by the GAME_LOG_* macros. The rate limit of a site is shared by all threads
+// and only touched atomically, it is best effort: when the second turns over while
+// others log from the same site an extra message may slip through
+void PushGameLog(LogSite* site, const double* args, int argCount)
+{
+    long second = (long)time(NULL);
+    long siteSecond = LogLoad(&site->second);
+    if ((second != siteSecond) && LogCompareExchange(&site->second, siteSecond, second)) LogStore(&site->count, 0);
+    if (LogIncrement(&site->count) > LOG_SITE_PER_SECOND) {
+        LogIncrement(&site->suppressed);
+        return;
+    }
+
+    LogRecord local = { 0 };
+    LogRecord* record = &local;
+    long position = 0;
+    if (LogLoad(&gameLog.running)) {
+        position = LogLoad(&gameLog.head);
+        for (;;) {
+            record = &gameLog.ring[position & (LOG_RING_SIZE - 1)];
+            long difference = LogLoad(&record->sequence) - position;
+            if (difference == 0) {
+                if (LogCompareExchange(&gameLog.head, position, position + 1)) break;
+            }
+            else if (difference < 0) {
+                // Full, the message is lost but the suppressed count stays for the next one
+                LogIncrement(&gameLog.dropped);
+                return;
+            }
+            position = LogLoad(&gameLog.head);
+        }
+    }
+
+    record->site = site;
+    record->argCount = (argCount < LOG_MAX_ARGS) ? argCount : LOG_MAX_ARGS;
+    for (int i = 0; i < record->argCount; ++i) record->args[i] = args[i];
+    record->suppressed = (int)LogExchange(&site->suppressed, 0);
+
+    if (record == &local) WriteLogRecord(record);
+    else LogStore(&record->sequence, position + 1);
+}
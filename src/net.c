@@ -0,0 +1,272 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Minimal non blocking UDP sockets for netplay, and a tiny HTTP server for the
+*   telemetry endpoint
+*
+*   Kept apart from the rest of the game as the system socket headers don't mix well
+*   with raylib.h (windows.h in particular), so this file doesn't include it. Only IPv4
+*   addresses in dotted notation are supported, that is all the versus mode needs.
+*
+********************************************************************************************/
+
+#include <stdbool.h>
+
+#if defined(PLATFORM_WEB)
+    // No plain sockets in the browser, netplay is not available there
+#elif defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <pthread.h>
+    #include <sys/select.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+typedef int (*HttpTextCallback)(char* text, int size);
+
+//----------------------------------------------------------------------------------
+// Socket Functions
+//----------------------------------------------------------------------------------
+
+#if defined(PLATFORM_WEB)
+
+int OpenUdpSocket(int port) { return -1; }
+bool SendUdp(int socket, const char* host, int port, const void* data, int size) { return false; }
+int ReceiveUdp(int socket, void* data, int size) { return -1; }
+int ReceiveUdpFrom(int socket, void* data, int size, char* host, int hostSize, int* port) { return -1; }
+void CloseUdpSocket(int socket) { }
+
+bool StartHttpTextServer(int port, HttpTextCallback callback) { return false; }
+void StopHttpTextServer(void) { }
+
+#else
+
+// Binds a non blocking socket to the port on all interfaces, returns -1 on failure
+int OpenUdpSocket(int port)
+{
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return -1;
+#endif
+
+    int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) return -1;
+
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((unsigned short)port);
+
+    bool ok = bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ok = ok && ioctlsocket(sock, FIONBIO, &nonBlocking) == 0;
+    if (!ok) {
+        closesocket(sock);
+        WSACleanup();
+        return -1;
+    }
+#else
+    ok = ok && fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == 0;
+    if (!ok) {
+        close(sock);
+        return -1;
+    }
+#endif
+
+    return sock;
+}
+
+bool SendUdp(int socket, const char* host, int port, const void* data, int size)
+{
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+
+    return sendto(socket, data, size, 0, (struct sockaddr*)&addr, sizeof(addr)) == size;
+}
+
+// Returns the size of the received packet, 0 when there is nothing to read
+// and -1 on errors. When host is given the address of the sender is written
+// into host and port
+int ReceiveUdpFrom(int socket, void* data, int size, char* host, int hostSize, int* port)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addrSize = sizeof(addr);
+    int received = (int)recvfrom(socket, data, size, 0, (struct sockaddr*)&addr, &addrSize);
+    if (received >= 0) {
+        if (host != NULL) {
+            if (inet_ntop(AF_INET, &addr.sin_addr, host, hostSize) == NULL) host[0] = '\0';
+            *port = ntohs(addr.sin_port);
+        }
+        return received;
+    }
+
+#if defined(_WIN32)
+    int error = WSAGetLastError();
+    // Connection reset is reported when the other side isn't listening yet
+    if (error == WSAEWOULDBLOCK || error == WSAECONNRESET) return 0;
+#else
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED) return 0;
+#endif
+    return -1;
+}
+
+int ReceiveUdp(int socket, void* data, int size)
+{
+    return ReceiveUdpFrom(socket, data, size, NULL, 0, NULL);
+}
+
+void CloseUdpSocket(int socket)
+{
+    if (socket < 0) return;
+#if defined(_WIN32)
+    closesocket(socket);
+    WSACleanup();
+#else
+    close(socket);
+#endif
+}
+
+//----------------------------------------------------------------------------------
+// HTTP Text Server
+//----------------------------------------------------------------------------------
+#define HTTP_TEXT_SIZE 16384
+
+// One listening socket on localhost served by its own thread, every request gets the
+// text of the callback, whatever the path. The game loop never waits for it
+static int httpSocket = -1;
+static HttpTextCallback httpCallback = NULL;
+static volatile int httpRunning = 0;
+#if defined(_WIN32)
+static HANDLE httpThread = NULL;
+#else
+static pthread_t httpThread;
+#endif
+
+static void CloseSocket(int socket)
+{
+#if defined(_WIN32)
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+static void ServeHttpClient(int client, char* text)
+{
+    // A client that never sends its request doesn't hold up the server
+#if defined(_WIN32)
+    DWORD timeout = 1000;
+#else
+    struct timeval timeout = { 1, 0 };
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    char request[1024];
+    if (recv(client, request, sizeof(request), 0) <= 0) return;
+
+    int size = httpCallback(text, HTTP_TEXT_SIZE);
+    if (size < 0) size = 0;
+    char header[160];
+    int headerSize = snprintf(header, sizeof(header),
+        "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\nConnection: close\r\n\r\n", size);
+    if (send(client, header, headerSize, 0) == headerSize) send(client, text, size, 0);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI RunHttpTextServer(LPVOID data)
+#else
+static void* RunHttpTextServer(void* data)
+#endif
+{
+    static char text[HTTP_TEXT_SIZE];
+    while (httpRunning) {
+        // Wakes up regularly to see if the server got stopped
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(httpSocket, &readable);
+        struct timeval wait = { 0, 200000 };
+        if (select(httpSocket + 1, &readable, NULL, NULL, &wait) <= 0) continue;
+
+        int client = (int)accept(httpSocket, NULL, NULL);
+        if (client < 0) continue;
+        ServeHttpClient(client, text);
+        CloseSocket(client);
+    }
+    return 0;
+}
+
+// Listens on 127.0.0.1 only, callback runs on the server thread and writes at most
+// size bytes of text, returning how many it wrote
+bool StartHttpTextServer(int port, HttpTextCallback callback)
+{
+    if (httpRunning) return false;
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+#endif
+
+    int sock = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) return false;
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(sock, 4) != 0) {
+        CloseSocket(sock);
+        return false;
+    }
+
+    httpSocket = sock;
+    httpCallback = callback;
+    httpRunning = 1;
+#if defined(_WIN32)
+    httpThread = CreateThread(NULL, 0, RunHttpTextServer, NULL, 0, NULL);
+    bool started = httpThread != NULL;
+#else
+    bool started = pthread_create(&httpThread, NULL, RunHttpTextServer, NULL) == 0;
+#endif
+    if (!started) {
+        httpRunning = 0;
+        CloseSocket(sock);
+        httpSocket = -1;
+    }
+    return started;
+}
+
+void StopHttpTextServer(void)
+{
+    if (!httpRunning) return;
+    httpRunning = 0;
+#if defined(_WIN32)
+    WaitForSingleObject(httpThread, INFINITE);
+    CloseHandle(httpThread);
+#else
+    pthread_join(httpThread, NULL);
+#endif
+    CloseSocket(httpSocket);
+    httpSocket = -1;
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+#endif
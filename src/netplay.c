@@ -0,0 +1,269 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Netplay, two player versus synchronized with rollback
+*
+*   Both sides run the full simulation with a fixed time step and only exchange inputs.
+*   The input of the other player is predicted (it keeps doing what it did last), once the
+*   real input arrives and differs from the prediction the game state is restored from the
+*   snapshot of that step and all steps since get simulated again. A side never runs more
+*   than MAX_ROLLBACK steps ahead of the last confirmed input of the other side, so at most
+*   that many steps have to be simulated again within one frame.
+*
+*   Every packet carries the last inputs of the sender so lost packets don't need resends.
+*
+*   To try it on one machine start two instances:
+*       rasteroids --versus 0 7000 7001
+*       rasteroids --versus 1 7001 7000
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Netplay Definition
+//----------------------------------------------------------------------------------
+#define MAX_ROLLBACK 8                          // Steps that may be simulated again in one frame
+#define SNAPSHOT_RING (MAX_ROLLBACK + 2)
+#define INPUT_RING 32
+#define INPUTS_PER_PACKET 16
+#define NETPLAY_DT (1.0f / 60.0f)               // Both sides need to use the same time step
+
+#define NETPLAY_MAGIC 0x52415354                // 'RAST'
+
+typedef struct InputPacket {
+    unsigned int magic;
+    unsigned int seed;
+    int frame;                          // Step of the newest input in inputs
+    int count;
+    unsigned char inputs[INPUTS_PER_PACKET];    // Oldest first
+    double sendTime;
+    double echoTime;                    // sendTime of the last packet received from the other side
+} InputPacket;
+
+typedef struct Netplay {
+    bool active;
+    int socket;
+    char host[64];
+    int remotePort;
+    int localPlayer;
+    unsigned int seed;
+
+    int frame;                          // Next step to simulate
+    int remoteFrame;                    // Last step the remote input is known for, -1 for none
+    int rollbackFrame;                  // Oldest step simulated with a wrong prediction, -1 for none
+    bool waiting;
+
+    unsigned char localInputs[INPUT_RING];
+    unsigned char remoteInputs[INPUT_RING];
+    unsigned char usedRemoteInputs[INPUT_RING];     // Remote input each step was simulated with
+
+    unsigned char* snapshots[SNAPSHOT_RING];        // State before each step was simulated
+    int snapshotFrames[SNAPSHOT_RING];
+    int snapshotSize;
+
+    double lastRemoteSendTime;
+    NetplayStats stats;
+} Netplay;
+
+static Netplay netplay = { .active = false, .socket = -1 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static int GetRemoteInput(int frame)
+{
+    if (frame <= netplay.remoteFrame) return netplay.remoteInputs[frame % INPUT_RING];
+    if (netplay.remoteFrame < 0) return 0;
+    return netplay.remoteInputs[netplay.remoteFrame % INPUT_RING];
+}
+
+static void SimulateFrame(bool presentEffects)
+{
+    int frame = netplay.frame;
+    int slot = frame % SNAPSHOT_RING;
+    SaveGameplaySnapshot(netplay.snapshots[slot], netplay.snapshotSize);
+    netplay.snapshotFrames[slot] = frame;
+
+    int remote = GetRemoteInput(frame);
+    netplay.usedRemoteInputs[frame % INPUT_RING] = (unsigned char)remote;
+
+    int inputs[MAX_PLAYERS] = { 0 };
+    inputs[netplay.localPlayer] = netplay.localInputs[frame % INPUT_RING];
+    inputs[1 - netplay.localPlayer] = remote;
+    StepGameplay(inputs, NETPLAY_DT, presentEffects);
+
+    ++netplay.frame;
+}
+
+// Reads all waiting packets, new remote inputs that differ from what
+// was used for already simulated steps mark the rollback
+static void ReceiveInputs(void)
+{
+    InputPacket packet;
+    int received;
+    while ((received = ReceiveUdp(netplay.socket, &packet, sizeof(packet))) > 0) {
+        if (received != sizeof(packet) || packet.magic != NETPLAY_MAGIC) continue;
+        if (packet.seed != netplay.seed || packet.count > INPUTS_PER_PACKET) continue;
+
+        if (packet.sendTime > netplay.lastRemoteSendTime) netplay.lastRemoteSendTime = packet.sendTime;
+        if (packet.echoTime > 0) netplay.stats.ping = (int)((GetTime() - packet.echoTime) * 1000.0);
+
+        int first = packet.frame - packet.count + 1;
+        for (int i = 0; i < packet.count; ++i) {
+            int frame = first + i;
+            // Inputs are only accepted in order, older packets may arrive later
+            if (frame != netplay.remoteFrame + 1) continue;
+
+            netplay.remoteInputs[frame % INPUT_RING] = packet.inputs[i];
+            netplay.remoteFrame = frame;
+
+            bool simulated = frame < netplay.frame;
+            if (simulated && packet.inputs[i] != netplay.usedRemoteInputs[frame % INPUT_RING]) {
+                if (netplay.rollbackFrame < 0 || frame < netplay.rollbackFrame) netplay.rollbackFrame = frame;
+            }
+        }
+    }
+}
+
+// Restores the state before the first mispredicted step and simulates
+// all steps up to the current one again with the corrected inputs
+static void Rollback(void)
+{
+    int frame = netplay.rollbackFrame;
+    netplay.rollbackFrame = -1;
+
+    int slot = frame % SNAPSHOT_RING;
+    if (netplay.snapshotFrames[slot] != frame) {
+        TraceLog(LOG_WARNING, "NETPLAY: No snapshot for step %i, can't roll back", frame);
+        return;
+    }
+
+    double start = GetTime();
+    int target = netplay.frame;
+    RestoreGameplaySnapshot(netplay.snapshots[slot], netplay.snapshotSize);
+    netplay.frame = frame;
+    while (netplay.frame < target) {
+        SimulateFrame(false);
+    }
+
+    netplay.stats.rollbackFrames = target - frame;
+    netplay.stats.resimulateMs = (float)((GetTime() - start) * 1000.0);
+    ++netplay.stats.rollbacks;
+}
+
+static void SendInputs(void)
+{
+    InputPacket packet = { .magic = NETPLAY_MAGIC, .seed = netplay.seed, .frame = netplay.frame - 1 };
+    packet.count = (netplay.frame < INPUTS_PER_PACKET) ? netplay.frame : INPUTS_PER_PACKET;
+    int first = netplay.frame - packet.count;
+    for (int i = 0; i < packet.count; ++i) {
+        packet.inputs[i] = netplay.localInputs[(first + i) % INPUT_RING];
+    }
+    packet.sendTime = GetTime();
+    packet.echoTime = netplay.lastRemoteSendTime;
+
+    SendUdp(netplay.socket, netplay.host, netplay.remotePort, &packet, sizeof(packet));
+}
+
+//----------------------------------------------------------------------------------
+// Netplay Functions
+//----------------------------------------------------------------------------------
+
+// Opens the socket and allocates the snapshot buffers, localPlayer is 0 or 1 and
+// has to be different on the two sides. Both sides derive the same seed from the ports.
+bool InitNetplay(int localPlayer, int localPort, const char* host, int remotePort)
+{
+    CloseNetplay();
+
+    netplay.socket = OpenUdpSocket(localPort);
+    if (netplay.socket < 0) {
+        TraceLog(LOG_WARNING, "NETPLAY: Could not open port %i", localPort);
+        return false;
+    }
+
+    strncpy(netplay.host, host, sizeof(netplay.host) - 1);
+    netplay.host[sizeof(netplay.host) - 1] = '\0';
+    netplay.remotePort = remotePort;
+    netplay.localPlayer = (localPlayer == 0) ? 0 : 1;
+
+    int low = (localPort < remotePort) ? localPort : remotePort;
+    int high = (localPort < remotePort) ? remotePort : localPort;
+    netplay.seed = (unsigned int)(low * 65599 + high) | 1;
+
+    netplay.snapshotSize = GetGameplaySnapshotSize();
+    for (int i = 0; i < SNAPSHOT_RING; ++i) {
+        netplay.snapshots[i] = MemAlloc(netplay.snapshotSize);
+        netplay.snapshotFrames[i] = -1;
+    }
+
+    netplay.frame = 0;
+    netplay.remoteFrame = -1;
+    netplay.rollbackFrame = -1;
+    netplay.lastRemoteSendTime = 0;
+    netplay.stats = (NetplayStats){ 0 };
+    netplay.active = true;
+
+    TraceLog(LOG_INFO, "NETPLAY: Player %i on port %i, other side at %s:%i", netplay.localPlayer + 1, localPort, netplay.host, remotePort);
+    return true;
+}
+
+void CloseNetplay(void)
+{
+    if (!netplay.active) return;
+
+    CloseUdpSocket(netplay.socket);
+    for (int i = 0; i < SNAPSHOT_RING; ++i) {
+        MemFree(netplay.snapshots[i]);
+    }
+    netplay = (Netplay){ .active = false, .socket = -1 };
+}
+
+// Runs one frame of the versus game, rolls back if needed and then
+// simulates the next step unless we are too far ahead of the other side
+void UpdateNetplay(int localInput)
+{
+    ReceiveInputs();
+
+    if (netplay.rollbackFrame >= 0) Rollback();
+
+    netplay.waiting = netplay.frame - netplay.remoteFrame > MAX_ROLLBACK;
+    if (!netplay.waiting) {
+        netplay.localInputs[netplay.frame % INPUT_RING] = (unsigned char)localInput;
+        SimulateFrame(true);
+    }
+    else {
+        ++netplay.stats.stalls;
+    }
+
+    SendInputs();
+}
+
+bool IsNetplayActive(void)
+{
+    return netplay.active;
+}
+
+bool IsNetplayWaiting(void)
+{
+    return netplay.active && netplay.waiting;
+}
+
+int GetNetplayLocalPlayer(void)
+{
+    return netplay.active ? netplay.localPlayer : 0;
+}
+
+unsigned int GetNetplaySeed(void)
+{
+    return netplay.seed;
+}
+
+NetplayStats GetNetplayStats(void)
+{
+    return netplay.stats;
+}
@@ -41,15 +41,12 @@ static char* soundFiles[SOUND_MAX] = {
 };
 
 Sound sounds[SOUND_MAX] = {0};
-Highscore scores[MAX_HIGHSCORES];
-int controlKeys[CONTROL_MAX] = { 'A', 'D', 'W', ' ', 'S' };
+HighscoreTable highscores = { 0 };
+ControlMap controlMap = { 0 };
 
 //----------------------------------------------------------------------------------
 // Local Variables Definition (local to this module)
 //----------------------------------------------------------------------------------
-static const int screenWidth = 1024;
-static const int screenHeight = 768;
-
 // Required variables to manage screen transitions (fade-in, fade-out)
 static float transAlpha = 0.0f;
 static bool onTransition = false;
@@ -102,11 +99,77 @@ typedef void (*ScreenCallback)();
 //----------------------------------------------------------------------------------
 // Main entry point
 //----------------------------------------------------------------------------------
-int main(void)
+int main(int argc, char** argv)
 {
+    // Versus over the network: --versus <player 0|1> <local port> <remote port> [remote address]
+    int versusPlayer = -1;
+    int localPort = 0;
+    int remotePort = 0;
+    const char* remoteHost = "127.0.0.1";
+    // Spectators: --spectate-file <file> or --spectate <local port> <viewer port> [viewer address]
+    SpectatorStream* spectatorStream = NULL;
+    // Telemetry for kiosks: --metrics <port>, served on localhost only
+    int metricsPort = 0;
+    // Leaderboard of an arcade venue: --venue <name>, kept in highscores-<name>.bin
+    const char* venue = NULL;
+    // Finished games for balancing: --session-log <file>, --session-log off to disable
+    const char* sessionLogFile = "sessions.bin";
+    // Offscreen drawing scaled to the window: --render-height <pixels>, --fullscreen
+    int renderHeight = 0;
+    bool fullscreen = false;
+    // Vector monitor look, F7 switches it any time: --glow
+    bool glow = false;
+    // Replay of the last game for rasteroids_render --export: --record <file>
+    const char* replayFile = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (TextIsEqual(argv[i], "--versus") && i + 3 < argc) {
+            versusPlayer = TextToInteger(argv[i + 1]);
+            localPort = TextToInteger(argv[i + 2]);
+            remotePort = TextToInteger(argv[i + 3]);
+            i += 3;
+            if (i + 1 < argc && argv[i + 1][0] != '-') remoteHost = argv[++i];
+        }
+        else if (TextIsEqual(argv[i], "--spectate-file") && i + 1 < argc) {
+            spectatorStream = OpenSpectatorFile(argv[++i]);
+        }
+        else if (TextIsEqual(argv[i], "--spectate") && i + 2 < argc) {
+            int spectatePort = TextToInteger(argv[i + 1]);
+            int viewerPort = TextToInteger(argv[i + 2]);
+            i += 2;
+            const char* viewerHost = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "127.0.0.1";
+            spectatorStream = OpenSpectatorSocket(spectatePort, viewerHost, viewerPort);
+        }
+        else if (TextIsEqual(argv[i], "--metrics") && i + 1 < argc) {
+            metricsPort = TextToInteger(argv[++i]);
+        }
+        else if (TextIsEqual(argv[i], "--venue") && i + 1 < argc) {
+            venue = argv[++i];
+        }
+        else if (TextIsEqual(argv[i], "--session-log") && i + 1 < argc) {
+            sessionLogFile = argv[++i];
+        }
+        else if (TextIsEqual(argv[i], "--render-height") && i + 1 < argc) {
+            renderHeight = TextToInteger(argv[++i]);
+        }
+        else if (TextIsEqual(argv[i], "--fullscreen")) {
+            fullscreen = true;
+        }
+        else if (TextIsEqual(argv[i], "--glow")) {
+            glow = true;
+        }
+        else if (TextIsEqual(argv[i], "--record") && i + 1 < argc) {
+            replayFile = argv[++i];
+        }
+    }
+    SetGameplaySpectatorStream(spectatorStream);
+    SetReplayRecordingFile(replayFile);
+    SetGlowEnabled(glow);
+    if (metricsPort > 0) StartTelemetryEndpoint(metricsPort);
+
     // Initialization
     //---------------------------------------------------------
-    InitWindow(screenWidth, screenHeight, "rAsteroids");
+    InitGameLog();
+    InitView("rAsteroids", renderHeight, fullscreen);
 
     InitAudioDevice();      // Initialize audio device
 
@@ -114,21 +177,32 @@ int main(void)
     // font = LoadFont("resources/mecha.png");
     TraceLog(LOG_INFO, "Loading Assets from : %s", GetWorkingDirectory());
     smallFont = LoadFont("resources/Hyperspace.ttf");
-    SetTextLineSpacing(30);
+    SetTextLineSpacing(TEXT_LINE_SPACING);
     largeFont = LoadFontEx("resources/Hyperspace.ttf", 72, NULL, 0);
 
     for (int i = 0; i < SOUND_MAX; ++i) {
         sounds[i] = LoadSound(soundFiles[i]);
     }
+    InitAudioMixer(sounds, SOUND_MAX);
 
-    LoadHigscores("high.txt", scores, MAX_HIGHSCORES);
-    LoadControlMap("control.bin", controlKeys, CONTROL_MAX);
+    LoadHighscores(&highscores, GetHighscoreFileName(venue), HIGHSCORE_TABLE_SIZE);
+    if (!TextIsEqual(sessionLogFile, "off")) OpenSessionLog(sessionLogFile);
+    LoadControlMap("control.bin", &controlMap);
+    LoadGamepadMappings("resources/gamecontrollerdb.txt");
+    LoadDefinitions("resources/definitions.txt");
+    WatchDefinitions();
 
     lastGameScore = 0;
 
-    // Setup and init first screen
-    currentScreen = SCREEN_LOGO;
-    InitLogoScreen();
+    // Setup and init first screen, a versus game starts right away
+    if (versusPlayer >= 0 && InitNetplay(versusPlayer, localPort, remoteHost, remotePort)) {
+        currentScreen = SCREEN_GAMEPLAY;
+        InitGameplayScreen();
+    }
+    else {
+        currentScreen = SCREEN_LOGO;
+        InitLogoScreen();
+    }
 
 #if defined(PLATFORM_WEB)
     emscripten_set_main_loop(UpdateDrawFrame, 60, 1);
@@ -155,19 +229,33 @@ int main(void)
         default: break;
     }
 
-    WriteHigscores("high.txt", scores, MAX_HIGHSCORES);
-    WriteControlMap("control.bin", controlKeys, CONTROL_MAX);
+    WriteControlMap("control.bin", &controlMap);
+
+    SetGameplaySpectatorStream(NULL);
+    CloseSpectatorStream(spectatorStream);
+    StopTelemetryEndpoint();
+    UnwatchDefinitions();
+    UnloadGamepadMappings();
+    UnloadHighscores(&highscores);
+    CloseSessionLog();
+    CloseReplayRecording();
 
     // Unload global data loaded
+    ClearTextLayoutCache();
     UnloadFont(smallFont);
+    UnloadFont(largeFont);
     
+    UnloadAudioMixer();
     for (int i = 0; i < SOUND_MAX; ++i) {
         UnloadSound(sounds[i]);
     }
 
     CloseAudioDevice();     // Close audio context
 
+    UnloadGlow();
+    UnloadView();
     CloseWindow();          // Close window and OpenGL context
+    CloseGameLog();
     //--------------------------------------------------------------------------------------
 
     return 0;
@@ -273,12 +361,17 @@ static void UpdateTransition(void)
 // Draw transition effect (full-screen rectangle)
 static void DrawTransition(void)
 {
-    DrawRectangle(0, 0, GetScreenWidth(), GetScreenHeight(), Fade(BLACK, transAlpha));
+    DrawRectangle(0, 0, VIEW_WIDTH, VIEW_HEIGHT, Fade(BLACK, transAlpha));
 }
 
 // Update and draw game frame
 static void UpdateDrawFrame(void)
 {
+    AddTelemetry(TELEMETRY_FRAMES, 1);
+    AddTelemetry(TELEMETRY_FRAME_TIME, (long long)(GetFrameTime() * 1e6f));
+    UpdateGamepads();
+    if (IsKeyPressed(KEY_F7)) SetGlowEnabled(!IsGlowEnabled());
+
     if (!onTransition)
     {
         switch(currentScreen)
@@ -324,11 +417,14 @@ static void UpdateDrawFrame(void)
         }
     }
     else UpdateTransition();    // Update transition (fade-in, fade-out)
+
+    UpdateAudioMixer();
     //----------------------------------------------------------------------------------
 
     // Draw
     //----------------------------------------------------------------------------------
     BeginDrawing();
+    BeginView();
 
         ClearBackground(BLACK);
 
@@ -347,6 +443,8 @@ static void UpdateDrawFrame(void)
 
         //DrawFPS(10, 10);
 
+    EndView();
     EndDrawing();
+    ReportInputLatency();
     //----------------------------------------------------------------------------------
 }
@@ -0,0 +1,153 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Replays, the seed and the inputs of a game, enough to simulate it again
+*
+*   The simulation only depends on the seed, the inputs and the frame time of every step,
+*   so a replay is a ReplayHeader followed by one ReplayStep per step. The steps of the
+*   game being played are collected in memory and written when the gameplay screen
+*   unloads. Time travel drops the steps after the one it resumes from, the same way it
+*   drops them from its own history. Loading a save state or reloading the definitions
+*   changes the game outside of the steps, the replay of that game is dropped.
+*
+*   Versus games aren't recorded, rollback runs their steps more than once.
+*   tools/render.c replays a file into a video (--export).
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Recording Definition
+//----------------------------------------------------------------------------------
+#define REPLAY_INITIAL_STEPS (60 * 60)
+
+typedef struct ReplayRecording {
+    const char* fileName;       // NULL records nothing
+    bool active;                // A game is being recorded
+    ReplayHeader header;
+    ReplayStep* steps;
+    int capacity;
+} ReplayRecording;
+
+static ReplayRecording recording = { 0 };
+
+//----------------------------------------------------------------------------------
+// Replay Functions
+//----------------------------------------------------------------------------------
+
+// Games started from now on get recorded into the file, the last one replaces the
+// ones before. NULL stops recording
+void SetReplayRecordingFile(const char* fileName)
+{
+    recording.fileName = fileName;
+}
+
+void BeginReplayRecording(unsigned int seed, int playerCount)
+{
+    recording.active = recording.fileName != NULL;
+    recording.header = (ReplayHeader){ REPLAY_MAGIC, REPLAY_VERSION, seed, playerCount, 0 };
+}
+
+void RecordReplayStep(const int inputs[MAX_PLAYERS], float dt)
+{
+    if (!recording.active) return;
+
+    if (recording.header.stepCount == recording.capacity) {
+        int capacity = (recording.capacity > 0) ? 2 * recording.capacity : REPLAY_INITIAL_STEPS;
+        ReplayStep* steps = (ReplayStep*)RL_REALLOC(recording.steps, capacity * sizeof(ReplayStep));
+        if (steps == NULL) {
+            TraceLog(LOG_WARNING, "REPLAY: Out of memory, the game isn't recorded");
+            recording.active = false;
+            return;
+        }
+        recording.steps = steps;
+        recording.capacity = capacity;
+    }
+
+    ReplayStep* step = &recording.steps[recording.header.stepCount++];
+    memset(step, 0, sizeof(ReplayStep));
+    step->dt = dt;
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        step->inputs[p] = (unsigned char)inputs[p];
+    }
+}
+
+// Forgets the last steps, they got undone
+void RewindReplayRecording(int steps)
+{
+    if (!recording.active) return;
+    recording.header.stepCount = (steps < recording.header.stepCount) ? recording.header.stepCount - steps : 0;
+}
+
+// The game changed in a way the steps don't reproduce
+void DropReplayRecording(void)
+{
+    if (recording.active) TraceLog(LOG_INFO, "REPLAY: The game changed outside of its steps, it isn't recorded");
+    recording.active = false;
+}
+
+// Writes the recorded game, if there is one
+void EndReplayRecording(void)
+{
+    if (!recording.active) return;
+    recording.active = false;
+
+    int size = (int)sizeof(ReplayHeader) + recording.header.stepCount * (int)sizeof(ReplayStep);
+    unsigned char* data = (unsigned char*)RL_MALLOC(size);
+    if (data == NULL) return;
+    memcpy(data, &recording.header, sizeof(ReplayHeader));
+    if (recording.header.stepCount > 0) {
+        memcpy(data + sizeof(ReplayHeader), recording.steps, recording.header.stepCount * sizeof(ReplayStep));
+    }
+    if (SaveFileData(recording.fileName, data, size)) {
+        TraceLog(LOG_INFO, "REPLAY: %i steps written to %s", recording.header.stepCount, recording.fileName);
+    }
+    RL_FREE(data);
+}
+
+void CloseReplayRecording(void)
+{
+    RL_FREE(recording.steps);
+    memset(&recording, 0, sizeof(recording));
+}
+
+bool LoadReplay(const char* fileName, Replay* replay)
+{
+    memset(replay, 0, sizeof(Replay));
+
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    if (data == NULL) return false;
+
+    ReplayHeader header = { 0 };
+    if (size >= (int)sizeof(header)) memcpy(&header, data, sizeof(header));
+    bool valid = header.magic == REPLAY_MAGIC && header.version == REPLAY_VERSION &&
+        header.playerCount >= 1 && header.playerCount <= MAX_PLAYERS && header.stepCount >= 0 &&
+        (long long)header.stepCount * (long long)sizeof(ReplayStep) == (long long)size - (long long)sizeof(header);
+    if (valid && header.stepCount > 0) {
+        replay->steps = (ReplayStep*)RL_MALLOC(header.stepCount * sizeof(ReplayStep));
+        valid = replay->steps != NULL;
+        if (valid) memcpy(replay->steps, data + sizeof(header), header.stepCount * sizeof(ReplayStep));
+    }
+    UnloadFileData(data);
+
+    if (!valid) {
+        TraceLog(LOG_WARNING, "REPLAY: %s is not a replay", fileName);
+        return false;
+    }
+    replay->seed = header.seed;
+    replay->playerCount = header.playerCount;
+    replay->stepCount = header.stepCount;
+    return true;
+}
+
+void UnloadReplay(Replay* replay)
+{
+    RL_FREE(replay->steps);
+    memset(replay, 0, sizeof(Replay));
+}
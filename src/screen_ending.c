@@ -38,8 +38,9 @@ static char availableCharacters[CHAR_COUNT] = "   ";
 static int cursorPos = 0;
 static char *inputChars = "   ";
 static int currentChar = 0;
-static char* text[2] = { "You qualified for a high score, enter it",
-"using the left and right keys and shot to confirm." };
+static char rankText[64] = { 0 };
+static char* text[3] = { "You qualified for a high score, enter it",
+"using the left and right keys and shot to confirm.", rankText };
 
 static float editBlinkInterval = 0.5f;
 static float editBlinkCurrent = 0.0f;
@@ -58,6 +59,9 @@ void InitEndingScreen(void)
 
     editBlinkCurrent = editBlinkInterval;
 
+    int rank = GetHighscoreRank(&highscores, lastGameScore);
+    TextCopy(rankText, TextFormat("%i points, rank %i", lastGameScore, rank + 1));
+
     availableCharacters[0] = ' ';
     char currentChar = 'A';
     for (int i = 1; i < CHAR_COUNT; ++i, ++currentChar) {
@@ -73,9 +77,8 @@ void UpdateEndingScreen(void)
     }
     if (cursorPos >= 3) {
         finishScreen = 1;
-        int pos = GetHighscorePosition(scores, MAX_HIGHSCORES, lastGameScore);
-        InsertHighscore(scores, MAX_HIGHSCORES, pos, inputChars, lastGameScore);
-        WriteHigscores("hight.txt", scores, MAX_HIGHSCORES);
+        InsertHighscore(&highscores, inputChars, lastGameScore);
+        SaveHighscores(&highscores);
         return;
     }
     if (IsKeyPressed(KEY_D)) {
@@ -100,16 +103,16 @@ void DrawEndingScreen(void)
     }
 
     // TODO: Draw ENDING screen here!
-    DrawRectangle(0, 0, GetScreenWidth(), GetScreenHeight(), BLACK);
+    DrawRectangle(0, 0, VIEW_WIDTH, VIEW_HEIGHT, BLACK);
         
-    float y = (float)GetScreenHeight() / 3.0f;
-    for (int i = 0; i < 2; ++i) {
+    float y = (float)VIEW_HEIGHT / 3.0f;
+    for (int i = 0; i < 3; ++i) {
         DrawTextLineCentered(smallFont, text[i], y, 1.0);
         y += (float)largeFont.baseSize * 1.1f;
     }
 
     float charWidth = 40;
-    float x = (float)GetScreenWidth() / 2.0f - charWidth - charWidth / 2.0f;
+    float x = (float)VIEW_WIDTH / 2.0f - charWidth - charWidth / 2.0f;
 
     for (int i = 0; i < 3; ++i) {
         if (i == cursorPos && currentBlinkState) {
@@ -28,6 +28,8 @@
 #include "screens.h"
 
 #include "malloc.h"
+#include <float.h>
+#include <time.h>
 
 //----------------------------------------------------------------------------------
 // Data: see https://www.retrogamedeconstructionzone.com/2019/10/asteroids-by-numbers.html
@@ -53,20 +55,22 @@ Alien ships (both sizes)	4 - 6.5 (depending on your score)
 Bullets	                    17 (ship at rest)
 */
 
-// Small Saucer brain, have it avoid asteroids
 // Add pause
-// Fullscreen mode (16:10 Aspect Ratio check ...) 
 // Add Instructions
 
 //----------------------------------------------------------------------------------
 // Module Variables Definition (local)
 //----------------------------------------------------------------------------------
 static int framesCounter = 0;
-static int finishScreen = 0;
 
+// Score text only gets formatted and laid out again when the score changes
+static TextLayout scoreLayout[MAX_PLAYERS] = { 0 };
+static int scoreLayoutValue[MAX_PLAYERS] = { -1, -1 };
 
 static const Vector2 yUp = { 0, -1 };
 
+static SpectatorStream* spectatorStream = NULL;     // Not owned, see SetGameplaySpectatorStream()
+
 //----------------------------------------------------------------------------------
 // Objects Definition
 //----------------------------------------------------------------------------------
@@ -82,27 +86,21 @@ typedef struct Object {
     float rot;                  // In Degrees
     float rotVel;               // Degrees per sec
     int vertexCount;            // Amount of vertices in initialVertices and vertices
+    int vertexCapacity;         // Amount of vertices allocated in vertices
     Vector2* initialVertices;   // Not Owned here
     Vector2* vertices;          // Owned by the object
     int type;                   // type of data, allows cast
     void* data;                 // Not Owned here
 } Object;
 
-#define MAX_GAME_OBJECTS 100
-static Object gameobjects[MAX_GAME_OBJECTS] = { 0 };
+// Ships, bullets and the saucer pool take 118 objects, the rest is for asteroids
+#define MAX_GAME_OBJECTS 256
 
 //----------------------------------------------------------------------------------
 // Ship Definitions
 //----------------------------------------------------------------------------------
 
-// Ship vertex data (a simple triangle) for size and scaling the ship is 1 unit long
-static Vector2 shipVertices[4] = {
-    {-0.25f, 0.5f},
-    {0.0f, -0.5f},
-    {0.25f, 0.5f},
-    {-0.25f, 0.5f},
-};
-static int shipVertexCount = 4;
+// The ship model, speeds, scores and level rules are in the game definitions, see definitions.c
 
 // Graphics for powered engines
 static Vector2 shipThrustVertices[2][3] = {
@@ -119,13 +117,6 @@ static Vector2 shipThrustVertices[2][3] = {
 };
 static int shipThrustVertexCount = 3;
 
-// Static values that drive the ship behavior
-static float shipAccelerationFactor = .2f;      // Used under thrust
-static float shipRotationFactor = 2.0f;         // Used when the player turns 
-static float shipDecelerationFactor = .995f;    // Slows down the ship
-static float shipMaxSpeed = 14.0f;
-static float shipSpeedCutoff = 0.05f;           // When ship is slower than this, stop it
-
 // Ship is supposed to be 40 px on a fixed 1024 screen
 // Model is 1 unit long => GameScale = 40
 // This affects ALL values and can be used to move the game to a different sized screen 
@@ -138,23 +129,16 @@ static Vector2 shipDebrisVertices[2] = {
 };
 static int shipDebrisVertexCount = 2;
 
-// If the score is larger than threshold, gain one, then increase threshold
-// by distance
-static int nextShipInterval = 5000;         // Distance to next free ship
-static int nextShip = 5000;                 // Threshold for next free ship
-static int nextHyperSpaceInverval = 2500;   // Distance to next hyperspace
-static int nextHyperspace = 2500;           // Threshold for hyperspace
-
-// Contains all the objects of a ship
+// Contains all the objects of a ship, there is one of these for each player
 typedef struct Ship {
     Object* ship;
     Object* thrust[2];
     int thrustCount;
     Object* debris[4];
     int debrisCount;
+    float hyperspaceTime;   // Counts down while the ship is in hyperspace
 } ShipParts;
 
-static ShipParts parts;
 
 //----------------------------------------------------------------------------------
 // Bullet Definition
@@ -170,20 +154,18 @@ static Vector2 bulletVertices[5] = {
 static const int bulletVertexCount = 5;
 
 
-#define SAUCER_MAX_BULLETS 5
+// Every player gets their own range of bullets, followed by one range for each saucer
+#define MAX_SAUCERS 32
+#define SAUCER_MAX_BULLETS 2
 #define SHIP_MAX_BULLETS 5
-#define MAX_BULLETS SAUCER_MAX_BULLETS + SHIP_MAX_BULLETS
+#define SAUCER_BULLETS_START (MAX_PLAYERS * SHIP_MAX_BULLETS)
+#define MAX_BULLETS (SAUCER_BULLETS_START + MAX_SAUCERS * SAUCER_MAX_BULLETS)
 
 typedef struct Bullet {
     Object* object;
     float lifetime;
 } Bullet;
 
-static Bullet bullets[MAX_BULLETS] = { 0 };
-
-static float bulletInitialLifetime = 3.0f;  // Lifetime in seconds
-static float bulletInitialVelocity = 14.0f;
-
 //----------------------------------------------------------------------------------
 // Asteroid Definition
 //---------------------------------------------------------------------------------- 
@@ -194,27 +176,26 @@ typedef struct Asteroid {
 } Asteroid;
 
 #define MAX_ASTEROIDS 100
-static Asteroid asteroids[MAX_ASTEROIDS] = { 0 };
-
-// Large Asteroid 2.4 x 2.4
-static Vector2 asteroidVerticesLarge[11] = {
-    {-0.5f, 1.2f},
-    {-1.2f, 0.6f},
-    {-1.2f, -0.9f},
-    {-0.5f, -1.2f},
-    {0.0f, -0.9f},
-    {0.5f, -1.2f},
-    {1.2f, -0.9f},
-    {1.0f, 0.3f},
-    {1.2f, 0.6f},
-    {0.5f, 1.2f},
-    {-0.5f, 1.2f}
-};
-static int asteroidVertexCount = 11;
 
-// Static data for different sized vertices, will be initialized at start 
-static Vector2 asteroidVerticesMedium[11] = { 0 };
-static Vector2 asteroidVerticesSmall[11] = { 0 };
+// Broadphase for asteroid queries, a uniform grid over the playfield that gets
+// built again every step. Asteroid indices are sorted by cell, the ones in cell c
+// are items[cellStart[c]] up to items[cellStart[c + 1]]
+#define GRID_MAX_COLUMNS 16
+#define GRID_MAX_ROWS 16
+
+typedef struct AsteroidGrid {
+    int columns;
+    int rows;
+    float cellWidth;
+    float cellHeight;
+    short cellStart[GRID_MAX_COLUMNS * GRID_MAX_ROWS + 1];
+    short items[MAX_ASTEROIDS];
+} AsteroidGrid;
+
+// Static data for different sized vertices, scaled from the large asteroid of the
+// definitions at start
+static Vector2 asteroidVerticesMedium[DEFINITION_MAX_VERTICES] = { 0 };
+static Vector2 asteroidVerticesSmall[DEFINITION_MAX_VERTICES] = { 0 };
  
 
 enum {
@@ -225,59 +206,56 @@ enum {
 };
 
 static Vector2* asteroidData[ASTEROID_SIZE_NUM] = {
-    asteroidVerticesLarge,
+    definitions.asteroidVerticesLarge,
     asteroidVerticesMedium,
     asteroidVerticesSmall,
 };
 
-static float asteroidVelocity[ASTEROID_SIZE_NUM] = { 4, 5, 6 };
-static float asteroidRadius[ASTEROID_SIZE_NUM] = { 1.2f, 0.6f, 0.3f};   // Used in collision
-
-static int maxAsteroids = 8;                // Each level adds asteroids, this is the max
-static int startingAsteroids = 2;           // Starting number of asteroids
-static float levelSpeedIncrease = 0.1f;     // Gets multiplied with level and added to speed for each new asteroid
-
 //----------------------------------------------------------------------------------
 // Saucer Definition
 //---------------------------------------------------------------------------------- 
-const int saucerVertexCount = 13;
-static Vector2 saucerDataLarge[13] = {
-    {-0.75f, 0.2f}, // Bottom CCW 
-    {-0.4f, 0.5f},
-    {0.4f, 0.5f},
-    {0.75f, 0.2f},
-    {-0.75f, 0.2f},
-    {-0.4f, -0.1f}, // Middle CW
-    {0.4f, -0.1f},
-    {0.75f, 0.2f},
-    {-0.75f, 0.2f},
-    {-0.4f, -0.1f}, // Repeated (as we're drawing linestrip)
-    {-0.3f, -0.5f}, // Top
-    {0.3f, -0.5f},
-    {0.4f, -0.1f}
-};
-
-static Vector2 saucerDataSmall[13] = { 0 };
+// Scaled from the large saucer of the definitions at start
+static Vector2 saucerDataSmall[DEFINITION_MAX_VERTICES] = { 0 };
 
 enum {
     SAUCER_SIZE_LARGE,
     SAUCER_SIZE_SMALL
 };
 
+// Steering of the small saucer. Planning scores candidate headings against the asteroids
+// around the saucer and the ship it hunts, that is spread over several steps with a fixed
+// amount of asteroid checks per step so the cost per step stays bounded.
+#define SAUCER_HEADINGS 16
+#define SAUCER_THINK_BUDGET 48          // Asteroid checks per step
+#define SAUCER_QUERY_MAX 24             // Asteroids looked at for one heading
+
+typedef struct SaucerBrain {
+    Vector2 heading;        // Result of the last finished plan
+    Vector2 bestHeading;    // Best heading of the plan in progress
+    float bestScore;
+    int nextHeading;        // Next candidate to score, SAUCER_HEADINGS when the plan is done
+    float headingOffset;    // Rotation of the candidates, changes with every plan
+} SaucerBrain;
+
+// Saucers are a pool, every slot has its object and bullets from the start and is
+// in use while the object is active
 typedef struct Saucer {
     Object* object;
     int type;
-    int maxBullets;
     float shotFreq;
     float toShootTime;      // Counts down for next shot
     float toNextActionTime; // Counts down for next course change
+    SaucerBrain brain;
 } Saucer;
 
-static float saucerSpawnFrequency = 5.0f;
-static float saucerSpawnChance = 0.1f;
-static float saucerActionTime = 3.0f;
+static int saucerSoundIds[2] = { SOUND_SAUCER_LARGE, SOUND_SAUCER_SMALL };
+
+static float saucerLookahead = 1.0f;            // Seconds ahead that collisions get predicted
+static float saucerSenseRadius = 8.0f;          // Asteroids further away are ignored when planning
+static float saucerTurnRate = 3.0f;             // Radians per second
+static float saucerHuntNear = 4.0f;             // Distance to the ship it keeps
+static float saucerHuntFar = 8.0f;
 
-Saucer saucer;
 
 //----------------------------------------------------------------------------------
 // Game Definition
@@ -301,7 +279,6 @@ enum GameState {
     LEVEL_DONE,
     RUNNING,
     DYING,
-    HYPERSPACE,
 };
 
 enum Enemies {
@@ -319,17 +296,28 @@ enum Enemies {
 static int asteroidSizeToObject[3] = { ASTEROID_LARGE, ASTEROID_MEDIUM, ASTEROID_SMALL };
 static int saucerSizeToObject[2] = { SAUCER_LARGE, SAUCER_SMALL };
 
-typedef struct Game {
+typedef struct Player {
     int score;
     int lives;          // current number of lives
     int hyperspace;     // current number of jumps
+    int nextShip;       // Threshold for next free ship
+    int nextHyperspace; // Threshold for next hyperspace
+    int shotsFired;     // Statistics for the session log
+    int hits;
+    int deaths[SESSION_DEATH_CAUSES];
+    int hyperspaceJumps;
+} Player;
+
+typedef struct Game {
+    Player players[MAX_PLAYERS];
+    int playerCount;    // 1 for the normal game, 2 for versus
     int level;          // current level
     int state;          // current GameState
     float dt;           // dt 
     float stateTime;    // time spent in current state
+    float time;         // time since the game started
 } Game;
 
-Game game;
 
 //----------------------------------------------------------------------------------
 // Sound Definition
@@ -341,7 +329,6 @@ typedef struct BackgroundSound {
     int beat;
 } BackgroundSound;
 
-BackgroundSound sound;
 
 //----------------------------------------------------------------------------------
 // Particle system Definition
@@ -360,7 +347,55 @@ typedef struct ParticleSystem {
     int back;
 } ParticleSystem;
 
-ParticleSystem particleSystem;
+
+//----------------------------------------------------------------------------------
+// Event Definition
+//----------------------------------------------------------------------------------
+
+// The simulation doesn't play sounds, spawn particles or score by itself, it writes
+// what happened into the event queue, after the step all events get consumed in one
+// batch by each system. Events only drive effects and may be dropped when the queue
+// is full, the score of the step is summed up next to them and is never lost
+enum EventType {
+    EVENT_ASTEROID_DESTROYED,
+    EVENT_SHIP_DESTROYED,
+    EVENT_SAUCER_DESTROYED,
+    EVENT_SHOT_FIRED,
+};
+
+// What destroyed the ship, also the index into Player deaths
+enum DeathCause {
+    DEATH_ASTEROID,
+    DEATH_SAUCER,
+    DEATH_SAUCER_BULLET,
+    DEATH_SHIP,             // Versus only, rammed or shot by the other player
+};
+
+// Who fired a shot
+enum Shooter {
+    SHOOTER_SHIP,
+    SHOOTER_SAUCER,
+};
+
+typedef struct GameEvent {
+    int type;               // EventType
+    union {
+        struct { Vector2 position; int size; } asteroidDestroyed;
+        struct { Vector2 position; int player; int cause; } shipDestroyed;
+        struct { Vector2 position; int type; } saucerDestroyed;
+        struct { Vector2 position; int shooter; int player; } shotFired;
+    };
+} GameEvent;
+
+#define MAX_EVENTS 256
+
+typedef struct EventQueue {
+    GameEvent events[MAX_EVENTS];
+    int count;
+    int dropped;            // Events that didn't fit into the queue
+    int score[MAX_PLAYERS]; // Awarded during the step
+} EventQueue;
+
 
 //----------------------------------------------------------------------------------
 // Gameobject Stack
@@ -372,7 +407,44 @@ typedef struct Stack {
     Object* content[MAX_GAME_OBJECTS];
 } Stack;
 
-Stack stack;
+//----------------------------------------------------------------------------------
+// World Definition
+//----------------------------------------------------------------------------------
+
+// Everything the simulation of one game changes, the screen plays in its own world,
+// the server keeps one world per session
+typedef struct World {
+    Object gameobjects[MAX_GAME_OBJECTS];
+    Stack stack;
+    ShipParts parts[MAX_PLAYERS];
+    Bullet bullets[MAX_BULLETS];
+    Asteroid asteroids[MAX_ASTEROIDS];
+    AsteroidGrid grid;
+    Saucer saucers[MAX_SAUCERS];
+    int saucerLimit;            // Saucers that may be active at once
+    float toNextSaucerTime;     // Counts down until a new saucer may spawn
+    Game game;
+    BackgroundSound sound;
+    ParticleSystem particleSystem;
+    EventQueue events;
+    unsigned int rngState;
+    int width;          // Size of the playfield
+    int height;
+    int finishScreen;
+    long long reportedPools[TELEMETRY_POOL_COUNT];  // Last added to the telemetry gauges
+    bool sessionRecorded;       // The finished game went into the session log
+} World;
+
+static World screenWorld = { 0 };
+
+// The world all simulation functions work on, set per thread so server
+// workers can step different worlds at the same time
+#if defined(_MSC_VER)
+static __declspec(thread) World* world = &screenWorld;
+#else
+static __thread World* world = &screenWorld;
+#endif
+
 
 void StackPush(Stack *stack, Object* object) {
     if (stack->current < stack->size) {
@@ -406,6 +478,18 @@ void StackInit(Stack *stack, Object objects[], int numObjects) {
     }
 }
 
+// Makes sure the object can hold vertexCount vertices, will allocate new space
+// if there was none, or if the object needs more space than it has
+void ObjectReserveVertices(Object* obj, int vertexCount)
+{
+    if (obj->vertices == NULL || vertexCount > obj->vertexCapacity) {
+        RL_FREE(obj->vertices);
+        obj->vertices = (Vector2*)RL_CALLOC(vertexCount, sizeof(Vector2));
+        obj->vertexCapacity = vertexCount;
+    }
+    obj->vertexCount = vertexCount;
+}
+
 // Initializes an object, will allocate new space if there was none, 
 // or if the new object needs more space for vertices
 void ObjectInit(Object* obj, Vector2* initialVertices, int vertexCount)
@@ -419,45 +503,95 @@ void ObjectInit(Object* obj, Vector2* initialVertices, int vertexCount)
         return;
     }
 
-    *obj = (Object){ 0 };
+    // Keep the vertex memory, it can be reused
+    *obj = (Object){ .vertices = obj->vertices, .vertexCapacity = obj->vertexCapacity };
     obj->initialVertices = initialVertices;
-    if (obj->vertices == NULL || vertexCount > obj->vertexCount) {
-        free(obj->vertices);
-        obj->vertices = (Vector2*)RL_CALLOC(vertexCount, sizeof(Vector2));
-    }
-    obj->vertexCount = vertexCount;
+    ObjectReserveVertices(obj, vertexCount);
 }
 
 // Used when changing game state
 void SetState(int state) {
-    game.state = state;
-    game.stateTime = 0;
+    world->game.state = state;
+    world->game.stateTime = 0;
 }
 
-// Adds the score for one specific object that was destroyed
-void AddScore(int type) {
-    static int scores[MAX_TYPES] = { -1, 100, 50, -1, 20, 200, 1000 };
-    if (type > 0 && type < MAX_TYPES) {
-        game.score += scores[type];
+// Adds the score for one specific object that was destroyed to the score of the
+// step, the players get it after the step
+void AddScore(int player, int type) {
+    int scores[MAX_TYPES] = { -1,
+        definitions.asteroidScore[ASTEROID_SIZE_SMALL], definitions.asteroidScore[ASTEROID_SIZE_MEDIUM], -1,
+        definitions.asteroidScore[ASTEROID_SIZE_LARGE],
+        definitions.saucerScore[SAUCER_SIZE_LARGE], definitions.saucerScore[SAUCER_SIZE_SMALL] };
+    if (type > 0 && type < MAX_TYPES && player >= 0 && player < world->game.playerCount) {
+        world->events.score[player] += scores[type];
     }
     else {
         TraceLog(LOG_WARNING, "AddScore: called with invalid type");
     }
 }
 
+// The player that owns a bullet, -1 for saucer bullets
+int GetBulletPlayer(int bullet) {
+    return (bullet < SAUCER_BULLETS_START) ? bullet / SHIP_MAX_BULLETS : -1;
+}
+
+// The player that gets the score for what a bullet destroyed, like in the
+// original the first player also scores for what the saucer shoots
+int GetScoringPlayer(int bullet) {
+    return (bullet < SAUCER_BULLETS_START) ? bullet / SHIP_MAX_BULLETS : 0;
+}
+
+// Queues an event for the end of the step, events that don't fit are dropped
+GameEvent* PushEvent(EventQueue* queue, int type) {
+    if (queue->count >= MAX_EVENTS) {
+        ++queue->dropped;
+        return NULL;
+    }
+    GameEvent* event = &queue->events[queue->count++];
+    *event = (GameEvent){ .type = type };
+    return event;
+}
+
+//----------------------------------------------------------------------------------
+// Random Numbers
+//----------------------------------------------------------------------------------
+
+// The simulation uses its own generator (xorshift32) rather than GetRandomValue(),
+// that way its state can be saved and restored with the rest of the game
+
+void SeedGameRandom(unsigned int seed) {
+    world->rngState = (seed == 0) ? 1 : seed;
+}
+
+// Same contract as GetRandomValue(), returns a value from min to max inclusive
+int GetGameRandomValue(int min, int max) {
+    if (min > max) {
+        int tmp = max;
+        max = min;
+        min = tmp;
+    }
+    unsigned int x = world->rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    world->rngState = x;
+    unsigned int range = (unsigned int)(max - min) + 1u;
+    return (range == 0) ? (int)x : min + (int)(x % range);
+}
+
 // Generate a random position on the edge of the screen
 Vector2 GetRandomEdgePosition() {
     // Start from a border
-    int sector = GetRandomValue(0, 3);
+    int sector = GetGameRandomValue(0, 3);
     switch (sector) {
     case 0:
-        return (Vector2){ 0,(float)GetRandomValue(0, GetScreenHeight()) };
+        return (Vector2){ 0,(float)GetGameRandomValue(0, world->height) };
     case 1:
-        return (Vector2){ (float)GetScreenWidth() , (float)GetRandomValue(0, GetScreenHeight()) };
+        return (Vector2){ (float)world->width , (float)GetGameRandomValue(0, world->height) };
     case 2:
-        return (Vector2) { (float)GetRandomValue(0, GetScreenWidth()), 0 };
+        return (Vector2) { (float)GetGameRandomValue(0, world->width), 0 };
     case 3:
-        return (Vector2){ (float)GetRandomValue(0, GetScreenWidth()), (float)GetScreenHeight() };
+        return (Vector2){ (float)GetGameRandomValue(0, world->width), (float)world->height };
     default:
         TraceLog(LOG_WARNING, "Sector switch received invalid sector");
         return Vector2Zero();
@@ -468,7 +602,7 @@ Vector2 GetRandomEdgePosition() {
 // Use to perturb an angle by this random amount
 inline static float GetRandomAngleRad(int degrees)
 {
-    return (float)GetRandomValue(-degrees/2, degrees/2) * PI / 180.0f;
+    return (float)GetGameRandomValue(-degrees/2, degrees/2) * PI / 180.0f;
 }
 
 //----------------------------------------------------------------------------------
@@ -515,19 +649,20 @@ void UpdateParticles(ParticleSystem* system, float dt) {
 
 void DrawParticles(ParticleSystem* system) {
     for (int i = 0; i <= system->back; ++i) {
-        DrawCircle((int)system->particles[i].position.x,
-                   (int)system->particles[i].position.y, 2, WHITE);
+        CanvasCircle((int)system->particles[i].position.x,
+                     (int)system->particles[i].position.y, 2, WHITE);
     }
 }
 
 // Creates a particle explosion at the given position
 void SpawnExplosion(ParticleSystem* system, Vector2 pos, int count) {
     for (int i = 0; i < count; ++i) {
-        int angle = GetRandomValue(0, 360);
-        float speed = (float)GetRandomValue(25, 75) / 100.0f;
+        int angle = GetGameRandomValue(0, 360);
+        float speed = (float)GetGameRandomValue(25, 75) / 100.0f;
         Vector2 vel = Vector2Scale(Vector2Rotate(yUp, angle * PI / 180.0f), speed);
         if (!AddParticle(system, pos, vel, 2.5)) {
-            TraceLog(LOG_WARNING,"Out of Particles");
+            AddTelemetry(TELEMETRY_DROPPED_PARTICLES, count - i);
+            GAME_LOG_WARNING("Out of Particles");
             return;
         }
     }
@@ -538,28 +673,31 @@ void SpawnExplosion(ParticleSystem* system, Vector2 pos, int count) {
 // Bullet Functions
 //----------------------------------------------------------------------------------
 
-// Create a bullet from the given range [low, high)
-void SpawnBullet(int low, int high, Vector2 pos, Vector2 vel) {
+// Create a bullet from the given range [low, high), returns false if all bullets
+// in the range are in use
+bool SpawnBullet(int low, int high, Vector2 pos, Vector2 vel) {
     for (int i = low; i < high; ++i)
     {
-        if (bullets[i].lifetime < 0) {
-            bullets[i].lifetime = bulletInitialLifetime;
-            Object* obj = bullets[i].object;
+        if (world->bullets[i].lifetime < 0) {
+            world->bullets[i].lifetime = definitions.bulletInitialLifetime;
+            Object* obj = world->bullets[i].object;
             obj->active = true;
             obj->position = pos;
             obj->velocity = vel;
-            return;
+            return true;
         }
     }
 
-    TraceLog(LOG_WARNING, "Out of bullets in [%i, %i)", low, high);
+    AddTelemetry(TELEMETRY_DROPPED_BULLETS, 1);
+    GAME_LOG_WARNING("Out of bullets in [%i, %i)", low, high);
+    return false;
 }
 
 void UpdateBullets() {
     for (int i = 0; i < MAX_BULLETS; ++i) {
-        bullets[i].lifetime = Clamp(bullets[i].lifetime - game.dt, -1.0f, 999.0f);
-        if (bullets[i].lifetime <= 0.0) {
-            Object* obj = bullets[i].object;
+        world->bullets[i].lifetime = Clamp(world->bullets[i].lifetime - world->game.dt, -1.0f, 999.0f);
+        if (world->bullets[i].lifetime <= 0.0) {
+            Object* obj = world->bullets[i].object;
             obj->active = false;
         }
     }
@@ -570,20 +708,23 @@ void UpdateBullets() {
 // Ship Functions
 //----------------------------------------------------------------------------------
 
-// Resets Ship to original position and orientation
-void ResetShip() {
-    Object* ship = parts.ship;
+// Resets Ship to original position and orientation, in versus the
+// ships start next to each other
+void ResetShip(int player) {
+    Object* ship = world->parts[player].ship;
+    float x = world->width * (player + 1.0f) / (world->game.playerCount + 1.0f);
     ship->active = true;
-    ship->position = (Vector2){ GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f };
+    ship->position = (Vector2){ x, world->height / 2.0f };
     ship->velocity = Vector2Zero();
     ship->rot = 0;
     ship->rotVel = 0;
+    world->parts[player].hyperspaceTime = 0;
 }
 
 // Clear all bullets 
 void ResetBullets() {
     for (int i = 0; i < MAX_BULLETS; ++i) {
-        Bullet* bullet = &bullets[i];
+        Bullet* bullet = &world->bullets[i];
         if (bullet->object == NULL) continue;
         bullet->object->active = false;
         bullet->lifetime = -1;
@@ -591,9 +732,9 @@ void ResetBullets() {
 }
 
 // Clear the fragments from a ship explosion
-void ResetFragments() {
-    for (int i = 0; i < parts.debrisCount; ++i) {
-        parts.debris[i]->active = false;
+void ResetFragments(ShipParts* parts) {
+    for (int i = 0; i < parts->debrisCount; ++i) {
+        parts->debris[i]->active = false;
     }
 }
 
@@ -601,9 +742,9 @@ void ResetFragments() {
 // inside an asteroid, uses a bit bigger radius than the normal collision
 bool CheckCollisionAsteroids(Vector2 pos, float radius) {
     for (int i = MAX_ASTEROIDS - 1; i >= 0; --i) {
-        Asteroid* asteroid = &asteroids[i];
+        Asteroid* asteroid = &world->asteroids[i];
         if (asteroid->object == NULL ) continue;
-        if (CheckCollisionCircles(pos, radius * gameScale, asteroid->object->position, asteroidRadius[asteroid->size] * gameScale * 1.2f)) {
+        if (CheckCollisionCircles(pos, radius * gameScale, asteroid->object->position, definitions.asteroidRadius[asteroid->size] * gameScale * 1.2f)) {
             return true;
         }
     }
@@ -612,63 +753,68 @@ bool CheckCollisionAsteroids(Vector2 pos, float radius) {
 
 // Read the input in translate it to the appropriate action
 // This allows to read input from multiple sources but process 
-// through one loop
+// through one loop, the bindings get flattened whenever they change.
+// Presses are queued, one step takes at most one press of each action
 int UpdateInput()
 {
-    int input = 0;
-    //TraceLog(LOG_INFO, "Button: %i", GetKeyPressed());
-    if (IsKeyDown(controlKeys[CONTROL_LEFT]) || IsGamepadButtonDown(0, 9)) {
-        input = input | ACTION_LEFT;
-    }
-    if (IsKeyDown(controlKeys[CONTROL_RIGHT]) || IsGamepadButtonDown(0, 11)) {
-        input = input | ACTION_RIGHT;
-    }
-    if (IsKeyDown(controlKeys[CONTROL_HYPERSPACE]) || IsGamepadButtonDown(0, 3)) {
-        input = input | ACTION_HYPER;
-    }
-    if (IsKeyDown(controlKeys[CONTROL_THRUST]) || IsGamepadButtonDown(0, 7)) {
-        input = input | ACTION_THRUST;
-    }
-    if (IsKeyPressed(controlKeys[CONTROL_FIRE]) || IsGamepadButtonPressed(0, 8)) {
-        input = input | ACTION_FIRE;
+    static const int controlActions[CONTROL_MAX] = {
+        [CONTROL_LEFT] = ACTION_LEFT, [CONTROL_RIGHT] = ACTION_RIGHT, [CONTROL_THRUST] = ACTION_THRUST,
+        [CONTROL_FIRE] = ACTION_FIRE, [CONTROL_HYPERSPACE] = ACTION_HYPER };
+    static ControlLookup lookup = { .revision = -1 };
+    static InputState state = { 0 };
+
+    if (lookup.revision != controlMap.revision) {
+        BuildControlLookup(&lookup, &controlMap, controlActions, 1 << CONTROL_FIRE);
     }
-    return input;
+    SampleInput(&state, &lookup, GetTime());
+    return TakeStepInput(&state);
 }
 
 // React to user input, calculate new orientation, spawn bullets
-void UpdateShip(Object* ship) {
-    int input = UpdateInput();
+// from the bullet range of the player
+void UpdateShip(int player, int input) {
+    ShipParts* shipParts = &world->parts[player];
+    Object* ship = shipParts->ship;
+
+    // Reappear after the jump
+    if (shipParts->hyperspaceTime > 0) {
+        shipParts->hyperspaceTime -= world->game.dt;
+        if (shipParts->hyperspaceTime > 0) return;
+        ship->active = true;
+    }
+
     if ((input & ACTION_LEFT) != 0)
     {
-        ship->rot -= shipRotationFactor;
+        ship->rot -= definitions.shipRotationFactor;
     }
     if ((input & ACTION_RIGHT) != 0) {
-        ship->rot += shipRotationFactor;
+        ship->rot += definitions.shipRotationFactor;
     }
 
-    if ( ((input & ACTION_HYPER) != 0) && game.hyperspace > 0) {
-        SetState(HYPERSPACE);
+    if ( ((input & ACTION_HYPER) != 0) && world->game.players[player].hyperspace > 0) {
+        shipParts->hyperspaceTime = definitions.hyperspaceDuration;
         // Calculate new position for ship, trying to get a bit of 
         // distance from any asteroids
         do {
-            ship->position.x = (float)GetRandomValue(0, GetScreenWidth());
-            ship->position.y = (float)GetRandomValue(0, GetScreenHeight());
+            ship->position.x = (float)GetGameRandomValue(0, world->width);
+            ship->position.y = (float)GetGameRandomValue(0, world->height);
         } while (CheckCollisionAsteroids(ship->position, 1.5));
-        --game.hyperspace;
+        --world->game.players[player].hyperspace;
+        ++world->game.players[player].hyperspaceJumps;
         ship->active = false;
     }
 
     ship->rot = Wrap(ship->rot, 0, 360);
 
-    ship->velocity = Vector2Scale(ship->velocity, shipDecelerationFactor);
+    ship->velocity = Vector2Scale(ship->velocity, definitions.shipDecelerationFactor);
 
     Vector2 fwd = Vector2Rotate(yUp, ship->rot * PI / 180.0f);
-    Vector2 accell = Vector2Scale(fwd, .1f);
+    Vector2 accell = Vector2Scale(fwd, definitions.shipAccelerationFactor);
     if ((input & ACTION_THRUST) != 0) {
         ship->velocity = Vector2Add(ship->velocity, accell);
 
-        for (int i = 0; i < parts.thrustCount; ++i) {
-            Object* obj = parts.thrust[i];
+        for (int i = 0; i < shipParts->thrustCount; ++i) {
+            Object* obj = shipParts->thrust[i];
             obj->active = true;
             obj->position = ship->position;
             obj->velocity = ship->velocity;
@@ -677,38 +823,57 @@ void UpdateShip(Object* ship) {
         }
     }
     else {
-        for (int i = 0; i < parts.thrustCount; ++i) {
-            parts.thrust[i]->active = false;
+        for (int i = 0; i < shipParts->thrustCount; ++i) {
+            shipParts->thrust[i]->active = false;
         }
     }
 
     float mag = Vector2Length(ship->velocity);
-    if (mag < shipSpeedCutoff) {
+    if (mag < definitions.shipSpeedCutoff) {
         ship->velocity = Vector2Zero();
     }
     else {
-        ship->velocity = Vector2ClampValue(ship->velocity, 0, shipMaxSpeed);
+        ship->velocity = Vector2ClampValue(ship->velocity, 0, definitions.shipMaxSpeed);
     }
 
     if ((input & ACTION_FIRE) != 0) {
-        SpawnBullet(0, SHIP_MAX_BULLETS, ship->position, Vector2Scale(fwd, bulletInitialVelocity));
+        int low = player * SHIP_MAX_BULLETS;
+        if (SpawnBullet(low, low + SHIP_MAX_BULLETS, ship->position, Vector2Scale(fwd, definitions.bulletInitialVelocity))) {
+            ++world->game.players[player].shotsFired;
+            GameEvent* event = PushEvent(&world->events, EVENT_SHOT_FIRED);
+            if (event != NULL) {
+                event->shotFired.position = ship->position;
+                event->shotFired.shooter = SHOOTER_SHIP;
+                event->shotFired.player = player;
+            }
+        }
     }
 }
 
 // Breaks the ship into debris parts floating around on the screen
-void BreakShip(ShipParts* parts) {
-    PlaySound(sounds[SOUND_BANG_MEDIUM]);
-    parts->ship->active = false;
-    for (int i = 0; i < parts->debrisCount; ++i) {
-        Object* obj = parts->debris[i];
+void BreakShip(int player, int cause) {
+    ShipParts* shipParts = &world->parts[player];
+    GameEvent* event = PushEvent(&world->events, EVENT_SHIP_DESTROYED);
+    if (event != NULL) {
+        event->shipDestroyed.position = shipParts->ship->position;
+        event->shipDestroyed.player = player;
+        event->shipDestroyed.cause = cause;
+    }
+
+    world->game.players[player].lives -= 1;
+    ++world->game.players[player].deaths[cause];
+
+    shipParts->ship->active = false;
+    for (int i = 0; i < shipParts->debrisCount; ++i) {
+        Object* obj = shipParts->debris[i];
         obj->active = true;
-        obj->position = parts->ship->vertices[i];
-        obj->velocity = Vector2Scale(Vector2Subtract(obj->position, parts->ship->position), (float)GetRandomValue(10, 20) * 0.001f);
-        obj->rot = (float)GetRandomValue(0, 360);
-        obj->rotVel = (float)GetRandomValue(0, 200) / 100.0f;
+        obj->position = shipParts->ship->vertices[i];
+        obj->velocity = Vector2Scale(Vector2Subtract(obj->position, shipParts->ship->position), (float)GetGameRandomValue(10, 20) * 0.001f);
+        obj->rot = (float)GetGameRandomValue(0, 360);
+        obj->rotVel = (float)GetGameRandomValue(0, 200) / 100.0f;
     }
-    for (int i = 0; i < parts->thrustCount; ++i) {
-        parts->thrust[i]->active = false;
+    for (int i = 0; i < shipParts->thrustCount; ++i) {
+        shipParts->thrust[i]->active = false;
     }
 }
 
@@ -721,7 +886,7 @@ void BreakShip(ShipParts* parts) {
 void AddAsteroid() {
     int asteroidId = -1;
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object == 0) {
+        if (world->asteroids[i].object == 0) {
             asteroidId = i;
             break;
         }
@@ -732,45 +897,41 @@ void AddAsteroid() {
         return;
     }
 
-    TraceLog(LOG_INFO, "Adding Asteroid");
+    GAME_LOG_DEBUG("Adding Asteroid");
 
-    Object* obj = StackPop(&stack);
+    Object* obj = StackPop(&world->stack);
 
-    asteroids[asteroidId].object = obj;
-    asteroids[asteroidId].size = ASTEROID_SIZE_LARGE; // Sizes 1,2,4
+    world->asteroids[asteroidId].object = obj;
+    world->asteroids[asteroidId].size = ASTEROID_SIZE_LARGE; // Sizes 1,2,4
 
     obj->active = true;
-    if (obj->vertexCount < asteroidVertexCount || obj->vertices == 0) {
-        free(obj->vertices);
-        obj->vertices = (Vector2*)RL_CALLOC(asteroidVertexCount, sizeof(Vector2));
-    }
-    obj->vertexCount = asteroidVertexCount;
-    obj->initialVertices = asteroidVerticesLarge;
+    ObjectReserveVertices(obj, definitions.asteroidVertexCount);
+    obj->initialVertices = definitions.asteroidVerticesLarge;
     obj->position = GetRandomEdgePosition();
 
-    float rot = (float)GetRandomValue(0, 359) * PI / 180.0f;
-    float vel = asteroidVelocity[ASTEROID_SIZE_LARGE] + levelSpeedIncrease * game.level;
+    float rot = (float)GetGameRandomValue(0, 359) * PI / 180.0f;
+    float vel = definitions.asteroidVelocity[ASTEROID_SIZE_LARGE] + definitions.levelSpeedIncrease * world->game.level;
     obj->velocity = Vector2Scale(Vector2Rotate(yUp, rot), vel);
-    obj->rotVel = (float)GetRandomValue(-100, 100) / 200.0f;
+    obj->rotVel = (float)GetGameRandomValue(-100, 100) / 200.0f;
 }
 
 // Used when an asteroid is hit, breaks it into smaller pieces
-// or removes it from the game, also plays sound and scores accordingly
-void BreakAsteroid(Asteroid* asteroid) {
-    SpawnExplosion(&particleSystem, asteroid->object->position, 5);
+// or removes it from the game
+void BreakAsteroid(Asteroid* asteroid, int player) {
+    GameEvent* event = PushEvent(&world->events, EVENT_ASTEROID_DESTROYED);
+    if (event != NULL) {
+        event->asteroidDestroyed.position = asteroid->object->position;
+        event->asteroidDestroyed.size = asteroid->size;
+    }
 
     if (asteroid->size == ASTEROID_SIZE_SMALL) {
         asteroid->object->active = false;
-        StackPush(&stack, asteroid->object);
+        StackPush(&world->stack, asteroid->object);
         *asteroid = (Asteroid){ .object = NULL, .size = -1 };
-        AddScore(ASTEROID_SMALL);
-        PlaySound(sounds[SOUND_BANG_SMALL]);
+        AddScore(player, ASTEROID_SMALL);
         return;
     }
 
-    int sound = (asteroid->size == ASTEROID_SIZE_LARGE) ? SOUND_BANG_LARGE : SOUND_BANG_MEDIUM;
-    PlaySound(sounds[sound]);
-
     asteroid->size += 1;
     Object* obj = asteroid->object;
     
@@ -779,14 +940,14 @@ void BreakAsteroid(Asteroid* asteroid) {
     obj->initialVertices = asteroidData[asteroid->size];
     Vector2 oldVelocity = obj->velocity;
     Vector2 newVelocity = Vector2Rotate(obj->velocity, PI / 2.0f + GetRandomAngleRad(40));
-    float newSpeed = asteroidVelocity[asteroid->size] + levelSpeedIncrease * game.level;
+    float newSpeed = definitions.asteroidVelocity[asteroid->size] + definitions.levelSpeedIncrease * world->game.level;
     obj->velocity = Vector2Scale(Vector2Normalize(newVelocity), newSpeed);
-    obj->rotVel = (float)GetRandomValue(-100, 100) / 200.0f;
+    obj->rotVel = (float)GetGameRandomValue(-100, 100) / 200.0f;
 
     // Spawn a new asteroid
     int newAsteroid = -1;
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object == NULL) {
+        if (world->asteroids[i].object == NULL) {
             newAsteroid = i;
             break;
         }
@@ -798,24 +959,24 @@ void BreakAsteroid(Asteroid* asteroid) {
     }
 
 
-    Object* newObj = StackPop(&stack);
-    asteroids[newAsteroid] = (Asteroid){ .object= newObj, .size = asteroid->size };
-    ObjectInit(newObj, asteroidData[asteroid->size], asteroidVertexCount);
+    Object* newObj = StackPop(&world->stack);
+    world->asteroids[newAsteroid] = (Asteroid){ .object= newObj, .size = asteroid->size };
+    ObjectInit(newObj, asteroidData[asteroid->size], definitions.asteroidVertexCount);
     newObj->active = true;
 
     newObj->position = obj->position;
     newVelocity = Vector2Rotate(oldVelocity, -(PI / 2.0f) + GetRandomAngleRad(40));
-    newSpeed = asteroidVelocity[asteroid->size] + levelSpeedIncrease * game.level;
+    newSpeed = definitions.asteroidVelocity[asteroid->size] + definitions.levelSpeedIncrease * world->game.level;
     newObj->velocity = Vector2Scale(Vector2Normalize(newVelocity), newSpeed);
-    newObj->rotVel = (float)GetRandomValue(-100, 100) / 200.0f;
+    newObj->rotVel = (float)GetGameRandomValue(-100, 100) / 200.0f;
 }
 
 void ResetAsteroids() {
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object != NULL) {
-            asteroids[i].object->active = false;
-            StackPush(&stack, asteroids[i].object);
-            asteroids[i] = (Asteroid){ .object = NULL, .size = -1 };
+        if (world->asteroids[i].object != NULL) {
+            world->asteroids[i].object->active = false;
+            StackPush(&world->stack, world->asteroids[i].object);
+            world->asteroids[i] = (Asteroid){ .object = NULL, .size = -1 };
         }
     }
 }
@@ -823,9 +984,17 @@ void ResetAsteroids() {
 // Use for debugging to show asteroid collision regions
 void DrawAsteroidCollisions() {
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object != NULL) {
-            Object* obj = asteroids[i].object;
-            DrawCircleLines((int)obj->position.x, (int)obj->position.y, asteroidRadius[asteroids[i].size] * gameScale, DARKGREEN);
+        if (world->asteroids[i].object != NULL) {
+            Object* obj = world->asteroids[i].object;
+            CanvasCircleLines((int)obj->position.x, (int)obj->position.y, definitions.asteroidRadius[world->asteroids[i].size] * gameScale, DARKGREEN);
+        }
+    }
+
+    // Heading the small saucers are steering to
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        Object* saucer = world->saucers[i].object;
+        if (saucer->active && world->saucers[i].type == SAUCER_SIZE_SMALL) {
+            CanvasLine(saucer->position, Vector2Add(saucer->position, Vector2Scale(world->saucers[i].brain.heading, 2 * gameScale)), ORANGE);
         }
     }
 }
@@ -833,77 +1002,215 @@ void DrawAsteroidCollisions() {
 int CountAsteroids() {
     int count = 0;
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object != NULL) {
+        if (world->asteroids[i].object != NULL) {
             ++count;
         }
     }
     return count;
 }
 
+//----------------------------------------------------------------------------------
+// Asteroid Broadphase
+//----------------------------------------------------------------------------------
+
+static int GetGridCell(AsteroidGrid* grid, Vector2 pos) {
+    int x = (int)(pos.x / grid->cellWidth);
+    int y = (int)(pos.y / grid->cellHeight);
+    x = (x < 0) ? 0 : (x >= grid->columns) ? grid->columns - 1 : x;
+    y = (y < 0) ? 0 : (y >= grid->rows) ? grid->rows - 1 : y;
+    return y * grid->columns + x;
+}
+
+// Sorts the asteroids into the grid cells, cells are about the size of 4 game units
+void BuildAsteroidGrid() {
+    AsteroidGrid* grid = &world->grid;
+    grid->columns = (int)Clamp(ceilf(world->width / (4 * gameScale)), 1, GRID_MAX_COLUMNS);
+    grid->rows = (int)Clamp(ceilf(world->height / (4 * gameScale)), 1, GRID_MAX_ROWS);
+    grid->cellWidth = (float)world->width / grid->columns;
+    grid->cellHeight = (float)world->height / grid->rows;
+
+    int cellCount = grid->columns * grid->rows;
+    for (int c = 0; c <= cellCount; ++c) grid->cellStart[c] = 0;
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        if (world->asteroids[i].object == NULL) continue;
+        ++grid->cellStart[GetGridCell(grid, world->asteroids[i].object->position) + 1];
+    }
+    for (int c = 0; c < cellCount; ++c) grid->cellStart[c + 1] += grid->cellStart[c];
+
+    short fill[GRID_MAX_COLUMNS * GRID_MAX_ROWS];
+    for (int c = 0; c < cellCount; ++c) fill[c] = grid->cellStart[c];
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        if (world->asteroids[i].object == NULL) continue;
+        grid->items[fill[GetGridCell(grid, world->asteroids[i].object->position)]++] = (short)i;
+    }
+}
+
+// Writes the indices of the asteroids in the cells touched by the circle into results
+// and returns how many there are, at most maxResults. These are candidates, the cells
+// wrap around the playfield the same way the objects do.
+int QueryAsteroids(Vector2 pos, float radius, short* results, int maxResults) {
+    AsteroidGrid* grid = &world->grid;
+    int left = (int)floorf((pos.x - radius) / grid->cellWidth);
+    int right = (int)floorf((pos.x + radius) / grid->cellWidth);
+    int top = (int)floorf((pos.y - radius) / grid->cellHeight);
+    int bottom = (int)floorf((pos.y + radius) / grid->cellHeight);
+    if (right - left >= grid->columns) right = left + grid->columns - 1;
+    if (bottom - top >= grid->rows) bottom = top + grid->rows - 1;
+
+    int count = 0;
+    for (int y = top; y <= bottom; ++y) {
+        int row = ((y % grid->rows) + grid->rows) % grid->rows;
+        for (int x = left; x <= right; ++x) {
+            int c = row * grid->columns + ((x % grid->columns) + grid->columns) % grid->columns;
+            for (int i = grid->cellStart[c]; i < grid->cellStart[c + 1]; ++i) {
+                if (count == maxResults) return count;
+                results[count++] = grid->items[i];
+            }
+        }
+    }
+    return count;
+}
+
 //----------------------------------------------------------------------------------
 // Saucer Functions
 //----------------------------------------------------------------------------------
 
-void ResetSaucer() {
-    saucer.object->active = false;
-    saucer.toNextActionTime = saucerSpawnFrequency;
+void ResetSaucers() {
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        world->saucers[i].object->active = false;
+    }
+    world->toNextSaucerTime = definitions.saucerSpawnFrequency;
+}
+
+int CountSaucers() {
+    int count = 0;
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        if (world->saucers[i].object->active) ++count;
+    }
+    return count;
 }
 
-void SpawnSaucer(int type) {
-    Object* obj = saucer.object;
-    saucer.type = type;
+// Spawns a saucer in a free slot of the pool, returns NULL when all are in use
+Saucer* SpawnSaucer(int type) {
+    Saucer* saucer = NULL;
+    for (int i = 0; i < MAX_SAUCERS && saucer == NULL; ++i) {
+        if (!world->saucers[i].object->active) saucer = &world->saucers[i];
+    }
+    if (saucer == NULL) return NULL;
+
+    Object* obj = saucer->object;
+    saucer->type = type;
+    saucer->toShootTime = saucer->shotFreq;
+    saucer->toNextActionTime = definitions.saucerActionTime;
 
     // Always Spawn on the RIM
     obj->active = true;
-    obj->initialVertices = (type == SAUCER_SIZE_LARGE) ? saucerDataLarge : saucerDataSmall;
-    float speed = 4 + (float)game.score / 10000.0f;
+    obj->initialVertices = (type == SAUCER_SIZE_LARGE) ? definitions.saucerDataLarge : saucerDataSmall;
+    float speed = 4 + (float)world->game.players[0].score / 10000.0f;
     speed = Clamp(speed, 0, 7);
     obj->velocity = (Vector2Rotate(yUp, GetRandomAngleRad(180)));
     obj->position = GetRandomEdgePosition();
     obj->rot = 0;
     obj->rotVel = 0;
+
+    Vector2 heading = Vector2Normalize(obj->velocity);
+    saucer->brain = (SaucerBrain){ .heading = heading, .bestHeading = heading, .nextHeading = SAUCER_HEADINGS };
+    return saucer;
 }
 
-// Source https://gamedev.net/forums/topic/401165-target-prediction-system--target-leading
-// Code to calculate the correct vector to hit a moving target from a moving platform
-// works ok-ish
-float largest_root_of_quadratic_equation(float A, float B, float C) {
-    return (B + sqrtf(B * B - 4 * A * C)) / (2 * A);
+// Shortest offset from a to b on the wrapping playfield
+static Vector2 GetWrappedOffset(Vector2 a, Vector2 b) {
+    Vector2 d = Vector2Subtract(b, a);
+    d.x -= world->width * floorf(d.x / world->width + 0.5f);
+    d.y -= world->height * floorf(d.y / world->height + 0.5f);
+    return d;
 }
 
+// Target prediction, originally from https://gamedev.net/forums/topic/401165-target-prediction-system--target-leading
+// The bullet of speed s hits a target at offset d moving with v at the earliest t >= 0 with
+// (s*s - v.v) t^2 - 2 (v.d) t - d.d = 0. Returns -1 when there is none. Solved as
+// 2c / (-b - sqrt(disc)) which doesn't divide by a, so a target as fast as the bullet works too.
+static inline float InterceptTime(float a, float b, float c) {
+    float disc = b * b - 4 * a * c;
+    float root = sqrtf((disc > 0) ? disc : 0);
+    float denom = (disc >= 0) ? -b - root : 0;
+    return (denom < 0) ? 2 * c / denom : -1;
+}
+
+// Candidates for the saucer, kept as separate arrays so all of them get solved in one loop
+typedef struct InterceptTargets {
+    int count;
+    Object* objects[MAX_ASTEROIDS + MAX_PLAYERS];
+    float dx[MAX_ASTEROIDS + MAX_PLAYERS];      // Offset from the shooter
+    float dy[MAX_ASTEROIDS + MAX_PLAYERS];
+    float vx[MAX_ASTEROIDS + MAX_PLAYERS];
+    float vy[MAX_ASTEROIDS + MAX_PLAYERS];
+    float times[MAX_ASTEROIDS + MAX_PLAYERS];   // Result of SolveIntercepts(), -1 for unreachable
+} InterceptTargets;
+
+static void AddInterceptTarget(InterceptTargets* targets, Vector2 shooter, Object* obj) {
+    Vector2 d = GetWrappedOffset(shooter, obj->position);
+    int i = targets->count++;
+    targets->objects[i] = obj;
+    targets->dx[i] = d.x;
+    targets->dy[i] = d.y;
+    targets->vx[i] = obj->velocity.x;
+    targets->vy[i] = obj->velocity.y;
+}
+
+// Solves the intercept time of all targets, the loop has no branches so the
+// compiler can vectorize it
+static void SolveIntercepts(InterceptTargets* targets, float bulletSpeed) {
+    float speed2 = bulletSpeed * bulletSpeed;
+    for (int i = 0; i < targets->count; ++i) {
+        float a = speed2 - (targets->vx[i] * targets->vx[i] + targets->vy[i] * targets->vy[i]);
+        float b = -2 * (targets->vx[i] * targets->dx[i] + targets->vy[i] * targets->dy[i]);
+        float c = -(targets->dx[i] * targets->dx[i] + targets->dy[i] * targets->dy[i]);
+        targets->times[i] = InterceptTime(a, b, c);
+    }
+}
+
+// Point where a bullet from the shooter meets the target, when the target can't be
+// reached this is the current position of the target
 Vector2 intercept(Vector2 const shooter, float bullet_speed, Vector2 const target, Vector2 const target_velocity) {
+    Vector2 d = GetWrappedOffset(shooter, target);
     float a = bullet_speed * bullet_speed - Vector2DotProduct(target_velocity, target_velocity);
-    Vector2 shooterToTarget = Vector2Subtract(target, shooter);
-    float b = -2 * Vector2DotProduct(target_velocity, shooterToTarget);
-    float c = -Vector2DotProduct(shooterToTarget, shooterToTarget);
-    return Vector2Add(target, Vector2Scale(target_velocity, largest_root_of_quadratic_equation(a, b, c)));
+    float b = -2 * Vector2DotProduct(target_velocity, d);
+    float c = -Vector2DotProduct(d, d);
+    float t = fmaxf(InterceptTime(a, b, c), 0);
+    return Vector2Add(Vector2Add(shooter, d), Vector2Scale(target_velocity, t));
 }
 
 Vector2 shoot_at(Vector2 const shooter, Vector2 const interception, float bullet_speed) {
     Vector2 v = Vector2Subtract(interception,shooter);
+    if (Vector2Length(v) == 0) return Vector2Scale(yUp, bullet_speed);
     float scale = bullet_speed / Vector2Length(v);
     return Vector2Scale(v, scale);
 }
 
-void BreakSaucer() {
-    saucer.object->active = false;
-    AddScore(saucerSizeToObject[saucer.type]);
-    saucer.toNextActionTime = saucerSpawnFrequency;
-    SpawnExplosion(&particleSystem, saucer.object->position, 8);
-    PlaySound(sounds[SOUND_BANG_MEDIUM]);
+void BreakSaucer(Saucer* saucer, int player) {
+    saucer->object->active = false;
+    AddScore(player, saucerSizeToObject[saucer->type]);
+    world->toNextSaucerTime = definitions.saucerSpawnFrequency;
+
+    GameEvent* event = PushEvent(&world->events, EVENT_SAUCER_DESTROYED);
+    if (event != NULL) {
+        event->saucerDestroyed.position = saucer->object->position;
+        event->saucerDestroyed.type = saucer->type;
+    }
 }
 
 
 // Picks a target when the saucer is the big version
-Object* LargeSaucerSelectTarget() {
+Object* LargeSaucerSelectTarget(Saucer* saucer) {
     int count = CountAsteroids();
 
-    count = GetRandomValue(0, count - 1);
+    count = GetGameRandomValue(0, count - 1);
     Object* target = NULL;
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object != NULL) {
+        if (world->asteroids[i].object != NULL) {
             if (count == 0) {
-                target = asteroids[i].object;
+                target = world->asteroids[i].object;
                 break;
             }
             --count;
@@ -911,364 +1218,1157 @@ Object* LargeSaucerSelectTarget() {
     }
 
     if (target == NULL) {
-        TraceLog(LOG_ERROR, "Could not find target for saucer");
+        GAME_LOG_ERROR("Could not find target for saucer");
         return NULL;
     }
     return target;
 }
 
-// Picks a target when the saucer is the small version
-Object* SmallSaucerSelectTarget() {
-    if (GetRandomValue(0, 100) > 10) {
-        return parts.ship;
-    }
-    else {
-        return LargeSaucerSelectTarget();
+// Picks a target when the saucer is the small version, mostly the player that can be hit
+// first, otherwise the asteroid that can be hit first. Only targets that a bullet reaches
+// within its lifetime count.
+Object* SmallSaucerSelectTarget(Saucer* saucer) {
+    InterceptTargets targets;
+    targets.count = 0;
+    Vector2 shooter = saucer->object->position;
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        if (world->parts[p].ship->active) AddInterceptTarget(&targets, shooter, world->parts[p].ship);
+    }
+    int shipCount = targets.count;
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        if (world->asteroids[i].object != NULL) AddInterceptTarget(&targets, shooter, world->asteroids[i].object);
+    }
+    SolveIntercepts(&targets, definitions.bulletInitialVelocity);
+
+    // Positions are in pixels and velocities in units, so times are scaled by gameScale
+    float maxTime = definitions.bulletInitialLifetime * gameScale;
+    bool preferShip = GetGameRandomValue(0, 100) > 10;
+    int best = -1;
+    for (int pass = 0; pass < 2 && best < 0; ++pass) {
+        bool ships = (pass == 0) == preferShip;
+        int first = ships ? 0 : shipCount;
+        int last = ships ? shipCount : targets.count;
+        for (int i = first; i < last; ++i) {
+            float t = targets.times[i];
+            if (t >= 0 && t <= maxTime && (best < 0 || t < targets.times[best])) best = i;
+        }
     }
+
+    if (best >= 0) return targets.objects[best];
+    return (shipCount > 0) ? targets.objects[0] : LargeSaucerSelectTarget(saucer);
 }
 
-// Shoots at a selected target from the saucer
-void ShootSaucer(Object* shooter, Object* target, float bulletVelocity) {
+// Shoots at a selected target from the saucer, with a bullet from its own range
+void ShootSaucer(Saucer* saucer, Object* target, float bulletVelocity) {
+    Object* shooter = saucer->object;
     Vector2 p = intercept(shooter->position, bulletVelocity, target->position, target->velocity);
     Vector2 bulletVel = shoot_at(shooter->position, p, bulletVelocity);
 
-    SpawnBullet(SHIP_MAX_BULLETS, MAX_BULLETS, shooter->position, bulletVel);
-    PlaySound(sounds[SOUND_FIRE]);
+    int low = SAUCER_BULLETS_START + (int)(saucer - world->saucers) * SAUCER_MAX_BULLETS;
+    if (SpawnBullet(low, low + SAUCER_MAX_BULLETS, shooter->position, bulletVel)) {
+        GameEvent* event = PushEvent(&world->events, EVENT_SHOT_FIRED);
+        if (event != NULL) {
+            event->shotFired.position = shooter->position;
+            event->shotFired.shooter = SHOOTER_SAUCER;
+        }
+    }
 }
 
 // Moves the large saucer
-void LargeSaucerUpdate() {
-    if (saucer.toNextActionTime < 0) {
+void LargeSaucerUpdate(Saucer* saucer) {
+    if (saucer->toNextActionTime < 0) {
         float angle = GetRandomAngleRad(90);
-        saucer.object->velocity = Vector2Rotate(saucer.object->velocity, PI / 2.0f + GetRandomAngleRad(40));
-        saucer.toNextActionTime = saucerActionTime + (float)GetRandomValue(0, (int)saucerActionTime * 10)/10.0f;
+        saucer->object->velocity = Vector2Rotate(saucer->object->velocity, PI / 2.0f + GetRandomAngleRad(40));
+        saucer->toNextActionTime = definitions.saucerActionTime + (float)GetGameRandomValue(0, (int)definitions.saucerActionTime * 10)/10.0f;
     }
 }
 
-// Moves the small saucer
-void SmallSaucerUpdate() {
-    if (saucer.toNextActionTime < 0) {
-        float angle = GetRandomAngleRad(90);
-        saucer.object->velocity = Vector2Rotate(saucer.object->velocity, PI / 2.0f + GetRandomAngleRad(40));
-        saucer.toNextActionTime = saucerActionTime + (float)GetRandomValue(0, (int)saucerActionTime * 10)/10.0f;
+// Nearest ship that is in play, NULL when there is none
+static Object* GetNearestShip(Vector2 pos) {
+    Object* nearest = NULL;
+    float nearestDist = 0;
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        Object* ship = world->parts[p].ship;
+        if (!ship->active) continue;
+        float dist = Vector2LengthSqr(GetWrappedOffset(pos, ship->position));
+        if (nearest == NULL || dist < nearestDist) {
+            nearest = ship;
+            nearestDist = dist;
+        }
+    }
+    return nearest;
+}
+
+// Where the saucer wants to go while hunting, towards the ship when it is far away,
+// away from it when it is too close and around it in between
+static Vector2 GetHuntDirection(Vector2 pos, Vector2 heading) {
+    Object* ship = GetNearestShip(pos);
+    if (ship == NULL) return heading;
+
+    Vector2 offset = GetWrappedOffset(pos, ship->position);
+    float dist = Vector2Length(offset);
+    if (dist < 1.0f) return heading;
+
+    Vector2 toShip = Vector2Scale(offset, 1.0f / dist);
+    if (dist > saucerHuntFar * gameScale) return toShip;
+    if (dist < saucerHuntNear * gameScale) return Vector2Negate(toShip);
+
+    Vector2 side = { -toShip.y, toShip.x };
+    return (Vector2DotProduct(side, heading) >= 0) ? side : Vector2Negate(side);
+}
+
+// How dangerous it is to fly with the given velocity, uses the closest approach
+// to each of the asteroids within the lookahead time
+static float GetSaucerDanger(Vector2 pos, Vector2 velocity, const short* nearby, int count) {
+    float danger = 0;
+    for (int i = 0; i < count; ++i) {
+        Asteroid* asteroid = &world->asteroids[nearby[i]];
+        Vector2 offset = GetWrappedOffset(pos, asteroid->object->position);
+        Vector2 relVel = Vector2Scale(Vector2Subtract(asteroid->object->velocity, velocity), gameScale);
+
+        float relSpeed2 = Vector2DotProduct(relVel, relVel);
+        float t = (relSpeed2 > 0) ? Clamp(-Vector2DotProduct(offset, relVel) / relSpeed2, 0, saucerLookahead) : 0;
+        float miss = Vector2Length(Vector2Add(offset, Vector2Scale(relVel, t)));
+        float clearance = (definitions.asteroidRadius[asteroid->size] + 1.2f) * gameScale;
+        if (miss < clearance) {
+            // Near misses that happen soon count the most
+            danger += (1.0f - miss / clearance) * (1.0f - 0.5f * t / saucerLookahead);
+        }
+    }
+    return danger;
+}
+
+// Scores candidate headings until the think budget of this step is used up, once all
+// of them are scored the best one becomes the heading and the next plan starts
+static void ThinkSaucer(Saucer* saucer) {
+    SaucerBrain* brain = &saucer->brain;
+    Object* obj = saucer->object;
+    float speed = Vector2Length(obj->velocity);
+    Vector2 hunt = GetHuntDirection(obj->position, brain->heading);
+
+    short nearby[SAUCER_QUERY_MAX];
+    int count = QueryAsteroids(obj->position, saucerSenseRadius * gameScale, nearby, SAUCER_QUERY_MAX);
+
+    int budget = SAUCER_THINK_BUDGET;
+    while (budget > 0) {
+        if (brain->nextHeading >= SAUCER_HEADINGS) {
+            // Candidates of the next plan are rotated so over time all directions get tried
+            brain->nextHeading = 0;
+            brain->bestScore = -FLT_MAX;
+            brain->headingOffset = Wrap(brain->headingOffset + 2.4f, 0, 2 * PI);
+        }
+
+        float angle = brain->headingOffset + brain->nextHeading * 2 * PI / SAUCER_HEADINGS;
+        Vector2 heading = Vector2Rotate(yUp, angle);
+        float score = Vector2DotProduct(heading, hunt) + 0.25f * Vector2DotProduct(heading, brain->heading)
+            - 4.0f * GetSaucerDanger(obj->position, Vector2Scale(heading, speed), nearby, count);
+        if (score > brain->bestScore) {
+            brain->bestScore = score;
+            brain->bestHeading = heading;
+        }
+
+        if (++brain->nextHeading == SAUCER_HEADINGS) brain->heading = brain->bestHeading;
+        budget -= count + 1;
     }
 }
 
-void UpdateSaucer() {
-    static int soundIds[2] = { SOUND_SAUCER_LARGE, SOUND_SAUCER_SMALL };
+// Moves the small saucer, it hunts the ship and steers around asteroids
+void SmallSaucerUpdate(Saucer* saucer) {
+    Object* obj = saucer->object;
+    ThinkSaucer(saucer);
+
+    // The plan can be a few steps old, asteroids right next to the saucer push it away at once
+    Vector2 desired = saucer->brain.heading;
+    short close[8];
+    int count = QueryAsteroids(obj->position, 3 * gameScale, close, 8);
+    for (int i = 0; i < count; ++i) {
+        Asteroid* asteroid = &world->asteroids[close[i]];
+        Vector2 offset = GetWrappedOffset(obj->position, asteroid->object->position);
+        float dist = Vector2Length(offset);
+        float clearance = (definitions.asteroidRadius[asteroid->size] + 1.5f) * gameScale;
+        if (dist > 0 && dist < clearance) {
+            desired = Vector2Subtract(desired, Vector2Scale(offset, 2.0f * (1.0f - dist / clearance) / dist));
+        }
+    }
+
+    // Turn towards it with a limited rate, the speed stays the same
+    float current = atan2f(obj->velocity.y, obj->velocity.x);
+    float turn = Wrap(atan2f(desired.y, desired.x) - current + PI, 0, 2 * PI) - PI;
+    float maxTurn = saucerTurnRate * world->game.dt;
+    obj->velocity = Vector2Rotate(obj->velocity, Clamp(turn, -maxTurn, maxTurn));
+}
 
+// Updates all saucers in use and spawns new ones while there are less than the limit
+void UpdateSaucers() {
     // Rather than using case statements to switch between the two types use function
     // tables to modify the behavior for each type of saucer
-    typedef Object* (*ShootFunc)();
+    typedef Object* (*ShootFunc)(Saucer*);
     static ShootFunc targetFunc[2] = { LargeSaucerSelectTarget, SmallSaucerSelectTarget};
     
-    typedef void (*UpdateFunc)();
+    typedef void (*UpdateFunc)(Saucer*);
     static UpdateFunc updateFunc[2] = { LargeSaucerUpdate, SmallSaucerUpdate };
 
-    // When this hits zero, a new saucer may spawn or an existing one may change course
-    saucer.toNextActionTime -= game.dt;
+    int active = 0;
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        Saucer* saucer = &world->saucers[i];
+        if (!saucer->object->active) continue;
+        ++active;
+
+        // When this hits zero the saucer may change course
+        saucer->toNextActionTime -= world->game.dt;
+        updateFunc[saucer->type](saucer);
+
+        saucer->toShootTime -= world->game.dt;
+        if (saucer->toShootTime < 0) {
+            Object* target = targetFunc[saucer->type](saucer);
+            if (target != NULL) ShootSaucer(saucer, target, definitions.bulletInitialVelocity);
+            saucer->toShootTime = saucer->shotFreq;
+        }
+    }
+
+    // When this hits zero a new saucer may spawn
+    world->toNextSaucerTime -= world->game.dt;
+    if (active >= world->saucerLimit || world->toNextSaucerTime > 0) return;
 
-    Object* obj = saucer.object;
-    if (obj->active) {
-        if (!IsSoundPlaying(sounds[soundIds[saucer.type]])) {
-            PlaySound(sounds[soundIds[saucer.type]]);
+    float ran = GetGameRandomValue(0, 100) / 100.0f;
+    if (ran < definitions.saucerSpawnChance) {
+        world->toNextSaucerTime = definitions.saucerActionTime;
+        if (world->game.players[0].score < 100000 || GetGameRandomValue(0,10) < 3) {
+            SpawnSaucer(SAUCER_SIZE_LARGE);
         }
-        updateFunc[saucer.type]();
+        else {
+            SpawnSaucer(SAUCER_SIZE_SMALL);
+        }
+    }
+}
+
 
-        saucer.toShootTime -= game.dt;
-        if (saucer.toShootTime < 0) {
-            Object* target = targetFunc[saucer.type]();
-            ShootSaucer(saucer.object, target, bulletInitialVelocity);
-            saucer.toShootTime = saucer.shotFreq;
+//----------------------------------------------------------------------------------
+// General Functions
+//----------------------------------------------------------------------------------
+
+// Collisions between the players in versus, ships ramming each other
+// or getting shot by the other player
+bool CheckCollisionsVersus() {
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        Object* ship = world->parts[p].ship;
+        if (!ship->active) continue;
+
+        for (int q = p + 1; q < world->game.playerCount; ++q) {
+            Object* other = world->parts[q].ship;
+            if (!other->active) continue;
+            if (CheckCollisionCircles(ship->position, 0.5f * gameScale, other->position, 0.5f * gameScale)) {
+                GAME_LOG_DEBUG("Ships collided");
+                BreakShip(p, DEATH_SHIP);
+                BreakShip(q, DEATH_SHIP);
+                return true;
+            }
         }
 
+        for (int j = 0; j < SAUCER_BULLETS_START; ++j) {
+            Object* bObj = world->bullets[j].object;
+            if (!bObj->active || GetBulletPlayer(j) == p) continue;
+            if (CheckCollisionPointCircle(bObj->position, ship->position, 0.5f * gameScale)) {
+                GAME_LOG_DEBUG("Ship hit by player bullet");
+                ++world->game.players[GetBulletPlayer(j)].hits;
+                BreakShip(p, DEATH_SHIP);
+                world->bullets[j].lifetime = -1;
+                bObj->active = false;
+                return true;
+            }
+        }
     }
-    else {
-        if (saucer.toNextActionTime > 0) return;
+    return false;
+}
 
-        float ran = GetRandomValue(0, 100) / 100.0f;
-        if (ran < saucerSpawnChance) {
-            saucer.toNextActionTime = saucerActionTime;
-            if (game.score < 100000 || GetRandomValue(0,10) < 3) {
-                SpawnSaucer(SAUCER_SIZE_LARGE);
+// Collisions of all saucers and their bullets, done as one batch: the saucers in use
+// are gathered first and asteroids are looked up in the broadphase grid.
+// Returns true if a ship was hit
+bool CheckCollisionsSaucers() {
+    Saucer* active[MAX_SAUCERS];
+    int activeCount = 0;
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        if (world->saucers[i].object->active) active[activeCount++] = &world->saucers[i];
+    }
+
+    if (activeCount > 0) {
+        BuildAsteroidGrid();
+    }
+
+    for (int i = 0; i < activeCount; ++i) {
+        Object* saucerObj = active[i]->object;
+
+        // Check collision of Asteroids w/ saucer
+        short nearby[MAX_ASTEROIDS];
+        int count = QueryAsteroids(saucerObj->position, (0.7f + definitions.asteroidRadius[ASTEROID_SIZE_LARGE]) * gameScale, nearby, MAX_ASTEROIDS);
+        for (int n = 0; n < count && saucerObj->active; ++n) {
+            Asteroid* asteroid = &world->asteroids[nearby[n]];
+            if (asteroid->object == NULL) continue;
+            if (CheckCollisionCircles(saucerObj->position, 0.7f * gameScale, asteroid->object->position, definitions.asteroidRadius[asteroid->size] * gameScale)) {
+                GAME_LOG_DEBUG("Asteroid hit saucer");
+                BreakSaucer(active[i], 0);
+                AddScore(0, asteroidSizeToObject[asteroid->size]);
+                BreakAsteroid(asteroid, 0);
             }
-            else {
-                SpawnSaucer(SAUCER_SIZE_SMALL);
+        }
+        if (!saucerObj->active) continue;
+
+        // Check collision of ships w/ saucer
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            Object* ship = world->parts[p].ship;
+            if (!ship->active) continue;
+            if (CheckCollisionCircles(ship->position, 0.5f * gameScale, saucerObj->position, 0.7f * gameScale)) {
+                GAME_LOG_DEBUG("Ship hit saucer");
+                BreakShip(p, DEATH_SAUCER);
+                return true;
+            }
+        }
+
+        // Check Collision of Saucer w/ ship bullets
+        for (int j = 0; j < SAUCER_BULLETS_START; ++j) {
+            Object* bObj = world->bullets[j].object;
+            if (!bObj->active) continue;
+            if (CheckCollisionPointCircle(bObj->position, saucerObj->position, 0.7f * gameScale)) {
+                GAME_LOG_DEBUG("Saucer hit by bullet");
+                ++world->game.players[GetBulletPlayer(j)].hits;
+                BreakSaucer(active[i], GetBulletPlayer(j));
+                world->bullets[j].lifetime = -1;
+                bObj->active = false;
+                break;
             }
-            saucer.toShootTime = saucer.shotFreq;
         }
     }
-}
 
+    // Check Collision of Ships with Saucer bullets, the ranges of all saucers in one go
+    for (int j = SAUCER_BULLETS_START; j < MAX_BULLETS; ++j) {
+        Object* bObj = world->bullets[j].object;
+        if (!bObj->active) continue;
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            Object* ship = world->parts[p].ship;
+            if (!ship->active) continue;
+            if (CheckCollisionPointCircle(bObj->position, ship->position, 0.5f * gameScale)) {
+                GAME_LOG_DEBUG("Ship hit by bullet");
+                BreakShip(p, DEATH_SAUCER_BULLET);
+                bObj->active = false;
+                return true;
+            }
+        }
+    }
 
-//----------------------------------------------------------------------------------
-// General Functions
-//----------------------------------------------------------------------------------
+    return false;
+}
 
 // Checks for collisions between a variety of objects
-// will return true if the ship was hit
+// will return true if a ship was hit
 bool CheckCollisions() {
-
-    Object* ship = parts.ship;
-    Object* saucerObj = saucer.object;
-
     for (int i = MAX_ASTEROIDS - 1; i >= 0; --i) {
-        Asteroid* asteroid = &asteroids[i];
+        Asteroid* asteroid = &world->asteroids[i];
         if (asteroid->object == NULL) continue;
         Object* aObj = asteroid->object;
 
-        // Check Collision of Asteroid w/ ship
-        if (CheckCollisionCircles(ship->position, 0.5f * gameScale, aObj->position, asteroidRadius[asteroid->size] * gameScale)) {
-            TraceLog(LOG_INFO, "Ship hit by asteroid %d", i);
-            AddScore(asteroidSizeToObject[asteroid->size]);
-            BreakAsteroid(asteroid);
-            BreakShip(&parts);
-            game.lives -= 1;
-            return true;
-        }
-
-        // Check collision of Asteroid w/ saucer
-        if (saucerObj->active && 
-            CheckCollisionCircles(saucerObj->position, 0.7f * gameScale, aObj->position, asteroidRadius[asteroid->size] * gameScale)) {
-                TraceLog(LOG_INFO, "Asteroid hit saucer");
-                BreakSaucer(saucer.object);
-                AddScore(asteroidSizeToObject[asteroid->size]);
-                BreakAsteroid(asteroid);
-                continue;
+        // Check Collision of Asteroid w/ ships
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            Object* ship = world->parts[p].ship;
+            if (!ship->active) continue;
+            if (CheckCollisionCircles(ship->position, 0.5f * gameScale, aObj->position, definitions.asteroidRadius[asteroid->size] * gameScale)) {
+                GAME_LOG_DEBUG("Ship hit by asteroid %d", i);
+                AddScore(p, asteroidSizeToObject[asteroid->size]);
+                BreakAsteroid(asteroid, p);
+                BreakShip(p, DEATH_ASTEROID);
+                return true;
+            }
         }
 
         // Check Collision of Asteroid w/ bullets
         for (int j = 0; j < MAX_BULLETS; ++j) {
-            Object* bObj = bullets[j].object;
+            Object* bObj = world->bullets[j].object;
             if (!bObj->active) continue;
-            if (CheckCollisionPointCircle(bObj->position, aObj->position, asteroidRadius[asteroid->size] * gameScale)) {
-                TraceLog(LOG_INFO, "Asteroid hit by bullet");
-                AddScore(asteroidSizeToObject[asteroid->size]);
-                BreakAsteroid(asteroid);
-                bullets[j].lifetime = -1;
+            if (CheckCollisionPointCircle(bObj->position, aObj->position, definitions.asteroidRadius[asteroid->size] * gameScale)) {
+                GAME_LOG_DEBUG("Asteroid hit by bullet");
+                int player = GetScoringPlayer(j);
+                if (j < SAUCER_BULLETS_START) ++world->game.players[player].hits;
+                AddScore(player, asteroidSizeToObject[asteroid->size]);
+                BreakAsteroid(asteroid, player);
+                world->bullets[j].lifetime = -1;
                 bObj->active = false;
                 break;
             }
         }
     }
 
-    if (saucerObj->active) {
-        // Check collision of ship w/ saucer
-        if (CheckCollisionCircles(ship->position, 0.5f * gameScale, saucerObj->position, 0.7f * gameScale)) {
-            TraceLog(LOG_INFO, "Ship hit saucer");
-            BreakShip(&parts);
-            game.lives -= 1;
-            return true;
-        }
-        // Check Collision of Saucer w/ ship bullets
-        for (int j = 0; j < SHIP_MAX_BULLETS; ++j) {
-            Object* bObj = bullets[j].object;
-            if (!bObj->active) continue;
-            if (CheckCollisionPointCircle(bObj->position, saucerObj->position, 0.7f * gameScale)) {
-                TraceLog(LOG_INFO, "Saucer hit by bullet");
-                BreakSaucer(saucer.object);
-                bullets[j].lifetime = -1;
-                bObj->active = false;
-            }
-        }
+    if (CheckCollisionsSaucers()) {
+        return true;
     }
 
-    // Check Collision of Ship with Saucer bullets
-    for (int j = SHIP_MAX_BULLETS; j < MAX_BULLETS; ++j) {
-        Object* bObj = bullets[j].object;
-        if (!bObj->active) continue;
-        if (CheckCollisionPointCircle(bObj->position, ship->position, 0.5f * gameScale)) {
-            TraceLog(LOG_INFO, "Ship hit by bullet");
-            BreakShip(&parts);
-            bObj->active = false;
-            game.lives -= 1;
-            return true;
-        }
+    if (world->game.playerCount > 1) {
+        return CheckCollisionsVersus();
     }
 
     return false;
 }
 
+// Transform the vertices into the correct position for drawing
+void UpdateObjectVertices(Object* obj) {
+    for (int v = 0; v < obj->vertexCount; ++v) {
+        obj->vertices[v] = Vector2Add(Vector2Scale(Vector2Rotate(obj->initialVertices[v], obj->rot * PI
+            / 180.0f), gameScale), obj->position);
+    }
+}
+
 // Apply velocity and rotation velocity, and transform the vertices into the correct
 // position for drawing
 void UpdateGameObjects() {
-    Object* obj = &gameobjects[0];
+    Object* obj = &world->gameobjects[0];
     for (int i = 0; i < MAX_GAME_OBJECTS; ++i, ++obj) {
         if (!obj->active) continue;
 
-        obj->position = Vector2Add(obj->position, Vector2Scale(obj->velocity, gameScale * game.dt));
-        obj->position.x = Wrap(obj->position.x, 0, (float)GetScreenWidth());
-        obj->position.y = Wrap(obj->position.y, 0, (float)GetScreenHeight());
+        obj->position = Vector2Add(obj->position, Vector2Scale(obj->velocity, gameScale * world->game.dt));
+        obj->position.x = Wrap(obj->position.x, 0, (float)world->width);
+        obj->position.y = Wrap(obj->position.y, 0, (float)world->height);
 
         obj->rot = Wrap(obj->rot + obj->rotVel, 0.0f, 360.0f);
 
-        for (int v = 0; v < obj->vertexCount; ++v) {
-            obj->vertices[v] = Vector2Add(Vector2Scale(Vector2Rotate(obj->initialVertices[v], obj->rot * PI
-                / 180.0f), gameScale), obj->position);
-        }
+        UpdateObjectVertices(obj);
     }
 }
 
-void UpdateBackgroundSound() {
+void UpdateBackgroundSound(bool play) {
     float val = (11.0f - Clamp((float)CountAsteroids(), 1, 10)) * 0.1f;
-    sound.interval = 0.25f + 1.25f * val;
-    sound.elapsed += game.dt;
-    if (sound.elapsed > sound.interval) {
-        sound.elapsed = 0;
-        PlaySound(sounds[sound.beat]);
-        sound.beat = (sound.beat == SOUND_BEAT_1) ? SOUND_BEAT_2 : SOUND_BEAT_1;
+    world->sound.interval = 0.25f + 1.25f * val;
+    world->sound.elapsed += world->game.dt;
+    if (world->sound.elapsed > world->sound.interval) {
+        world->sound.elapsed = 0;
+        if (play) PlayEffect(world->sound.beat);
+        world->sound.beat = (world->sound.beat == SOUND_BEAT_1) ? SOUND_BEAT_2 : SOUND_BEAT_1;
     }
 }
 
 //----------------------------------------------------------------------------------
-// Levels
+// Event Functions
 //----------------------------------------------------------------------------------
 
-// When all asteroids are gone and the saucer is destroyed the level is finished
-bool IsLevelDone() {
-    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        if (asteroids[i].object != NULL && asteroids[i].object->active == true) {
-            return false;
-        }
+// Scores everything that was destroyed during the step
+void ScoreEvents(EventQueue* queue) {
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        world->game.players[p].score += queue->score[p];
+        queue->score[p] = 0;
     }
-    if (saucer.object->active) {
-        return false;
+}
+
+// Explosions for everything that was destroyed during the step
+void SpawnEventParticles(EventQueue* queue) {
+    for (int i = 0; i < queue->count; ++i) {
+        GameEvent* event = &queue->events[i];
+        if (event->type == EVENT_ASTEROID_DESTROYED) {
+            SpawnExplosion(&world->particleSystem, event->asteroidDestroyed.position, 5);
+        }
+        else if (event->type == EVENT_SAUCER_DESTROYED) {
+            SpawnExplosion(&world->particleSystem, event->saucerDestroyed.position, 8);
+        }
     }
-    return true;
 }
 
-// Reseed a level with asteroids
-void CreateLevel() {
-    int count = (int)Clamp((float)(startingAsteroids + game.level), (float)startingAsteroids, (float)maxAsteroids);
-    for (int i = 0; i < count; ++i) {
-        AddAsteroid();
+// Plays the one shot sounds for the step, one per event. How many of them sound at
+// once is up to the voices of each effect in the mixer (audio.c)
+void PlayEventSounds(EventQueue* queue) {
+    static int asteroidSounds[ASTEROID_SIZE_NUM] = { SOUND_BANG_LARGE, SOUND_BANG_MEDIUM, SOUND_BANG_SMALL };
+
+    for (int i = 0; i < queue->count; ++i) {
+        GameEvent* event = &queue->events[i];
+        int effect = -1;
+        switch (event->type) {
+        case EVENT_ASTEROID_DESTROYED: effect = asteroidSounds[event->asteroidDestroyed.size]; break;
+        case EVENT_SHIP_DESTROYED: effect = SOUND_BANG_MEDIUM; break;
+        case EVENT_SAUCER_DESTROYED: effect = SOUND_BANG_MEDIUM; break;
+        case EVENT_SHOT_FIRED:
+            if (event->shotFired.shooter == SHOOTER_SAUCER) effect = SOUND_FIRE;
+            break;
+        default: break;
+        }
+        if (effect >= 0) PlayEffect(effect);
     }
 }
 
-void NextLevel() {
-    game.level += 1;
+// Looping sounds just follow the state of the objects after the step
+void UpdateLoopingSounds() {
+    bool thrusting = false;
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        thrusting = thrusting || (world->parts[p].ship->active && world->parts[p].thrust[0]->active);
+    }
+    if (thrusting) {
+        StartLoopingEffect(SOUND_THRUST);
+    }
+    else {
+        StopLoopingEffect(SOUND_THRUST);
+    }
+
+    bool saucerActive[2] = { false, false };
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        if (world->saucers[i].object->active) saucerActive[world->saucers[i].type] = true;
+    }
+    for (int type = SAUCER_SIZE_LARGE; type <= SAUCER_SIZE_SMALL; ++type) {
+        if (saucerActive[type]) {
+            StartLoopingEffect(saucerSoundIds[type]);
+        }
+        else {
+            StopLoopingEffect(saucerSoundIds[type]);
+        }
+    }
 }
 
-void ResetLevel() {
-    ResetShip();
-    ResetSaucer();
-    ResetBullets();
-    ResetFragments();
-    ResetAsteroids();
-    SetState(LEVEL_START);
+// Hands all events of the step to the systems that consume them and empties the queue,
+// sounds are skipped when steps are simulated again during a rollback
+void ProcessEvents(EventQueue* queue, bool playSounds) {
+    ScoreEvents(queue);
+    SpawnEventParticles(queue);
+    if (playSounds) PlayEventSounds(queue);
+    queue->count = 0;
 }
 
+#ifdef STRESSMODE
 //----------------------------------------------------------------------------------
-// Main Gameplay Functions
+// Stress Mode
 //----------------------------------------------------------------------------------
 
-void InitGameplayScreen(void)
-{
-    StackInit(&stack, gameobjects, MAX_GAME_OBJECTS);
-    InitParticleSystem(&particleSystem);
-
-    game = (Game){ .score = 0, .lives = 3, .hyperspace = 2, .level = -1, .state = LEVEL_START, .stateTime = 0 };
-    sound = (BackgroundSound){ .interval = 2, .elapsed = 0, .beat = SOUND_BEAT_1 };
+// Keeps the screen filled with asteroids and saucers and breaks asteroids at a fixed
+// rate, used to load test the sound, particle, collision and saucer paths
+static int stressAsteroidCount = 40;
+static int stressSaucerCount = 24;
+static float stressBreaksPerSecond = 300.0f;
+static float stressBreaks = 0.0f;
 
-    // Ship
-    parts.ship = StackPop(&stack);
-    ObjectInit(parts.ship, shipVertices, shipVertexCount);
-    ResetShip();
+void UpdateStress() {
+    world->game.players[0].lives = 3; // Stress runs don't end
 
-    // Ship Debris
-    parts.debrisCount = 3;
-    for (int i = 0; i < parts.debrisCount; ++i) {
-        parts.debris[i] = StackPop(&stack);
-        ObjectInit(parts.debris[i], shipDebrisVertices, shipDebrisVertexCount);;
+    while (CountAsteroids() < stressAsteroidCount) {
+        AddAsteroid();
     }
 
-    // Thust Graphics
-    parts.thrustCount = 2;
-    for (int i = 0; i < parts.thrustCount; ++i) {
-        parts.thrust[i] = StackPop(&stack);
-        ObjectInit(parts.thrust[i], shipThrustVertices[i], shipThrustVertexCount);
+    // Keeps the saucer pool busy for the AI and bullet paths
+    for (int i = CountSaucers(); i < stressSaucerCount; ++i) {
+        SpawnSaucer((i % 2 == 0) ? SAUCER_SIZE_SMALL : SAUCER_SIZE_LARGE);
     }
 
-    //Saucer
-    saucer = (Saucer){ .object = 0, .maxBullets = 2, .toShootTime = 0, .shotFreq = 1.5f, .type = 0, .toNextActionTime = saucerSpawnFrequency };
-    saucer.object = StackPop(&stack);
-    saucer.object->active = false;
-    saucer.object->vertexCount = saucerVertexCount;
-    saucer.object->initialVertices = saucerDataLarge;
-    saucer.object->vertices = (Vector2*)RL_CALLOC(saucerVertexCount, sizeof(Vector2));
-
-    for (int i = 0; i < saucerVertexCount; ++i) {
-        saucerDataSmall[i] = Vector2Scale(saucerDataLarge[i], 0.6f);
+    stressBreaks += stressBreaksPerSecond * world->game.dt;
+    while (stressBreaks >= 1.0f) {
+        stressBreaks -= 1.0f;
+        int start = GetGameRandomValue(0, MAX_ASTEROIDS - 1);
+        for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+            Asteroid* asteroid = &world->asteroids[(start + i) % MAX_ASTEROIDS];
+            if (asteroid->object == NULL) continue;
+            BreakAsteroid(asteroid, 0);
+            break;
+        }
     }
+}
+#endif
 
-    // Bullets
+//----------------------------------------------------------------------------------
+// Levels
+//----------------------------------------------------------------------------------
+
+// When all asteroids are gone and the saucers are destroyed the level is finished
+bool IsLevelDone() {
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        if (world->asteroids[i].object != NULL && world->asteroids[i].object->active == true) {
+            return false;
+        }
+    }
+    if (CountSaucers() > 0) {
+        return false;
+    }
+    return true;
+}
+
+// Reseed a level with asteroids
+void CreateLevel() {
+    int count = (int)Clamp((float)(definitions.startingAsteroids + world->game.level), (float)definitions.startingAsteroids, (float)definitions.maxAsteroids);
+    for (int i = 0; i < count; ++i) {
+        AddAsteroid();
+    }
+}
+
+void NextLevel() {
+    world->game.level += 1;
+}
+
+void ResetLevel() {
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        ResetShip(p);
+        ResetFragments(&world->parts[p]);
+    }
+    ResetSaucers();
+    ResetBullets();
+    ResetAsteroids();
+    SetState(LEVEL_START);
+}
+
+// The game is over when any of the players is out of ships
+bool IsGameOver() {
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        if (world->game.players[p].lives <= 0) return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------------
+// Snapshots
+//----------------------------------------------------------------------------------
+
+// Objects only reference static vertex data, in a snapshot that reference is
+// stored as the index into this table
+static Vector2* modelVertices[] = {
+    NULL,
+    definitions.shipVertices,
+    shipThrustVertices[0],
+    shipThrustVertices[1],
+    shipDebrisVertices,
+    bulletVertices,
+    definitions.asteroidVerticesLarge,
+    asteroidVerticesMedium,
+    asteroidVerticesSmall,
+    definitions.saucerDataLarge,
+    saucerDataSmall,
+};
+
+#define MODEL_COUNT (int)(sizeof(modelVertices) / sizeof(modelVertices[0]))
+
+// Vertices each entry of modelVertices holds
+static const int modelVertexLimits[MODEL_COUNT] = {
+    0,
+    DEFINITION_MAX_VERTICES,
+    3,
+    3,
+    2,
+    5,
+    DEFINITION_MAX_VERTICES,
+    DEFINITION_MAX_VERTICES,
+    DEFINITION_MAX_VERTICES,
+    DEFINITION_MAX_VERTICES,
+    DEFINITION_MAX_VERTICES,
+};
+
+// Only what is needed to recreate an object, vertices are calculated on restore
+typedef struct ObjectState {
+    Vector2 position;
+    Vector2 velocity;
+    float rot;
+    float rotVel;
+    unsigned char active;
+    unsigned char model;        // Index into modelVertices
+    unsigned char vertexCount;
+    unsigned char padding;
+} ObjectState;
+
+#define SNAPSHOT_MAGIC 0x50414e53   // "SNAP"
+#define SNAPSHOT_VERSION 5
+
+typedef struct SaucerState {
+    short object;
+    int type;
+    float shotFreq;
+    float toShootTime;
+    float toNextActionTime;
+    SaucerBrain brain;
+} SaucerState;
+
+// The complete simulation state as one flat block, all object pointers are
+// replaced by indices into gameobjects (-1 for none). This is a native memory
+// layout, good for restarts, save states and rollback on the same build
+typedef struct GameplaySnapshot {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int size;
+    unsigned int rngState;
+
+    Game game;
+    BackgroundSound sound;
+
+    ObjectState objects[MAX_GAME_OBJECTS];
+    short stack[MAX_GAME_OBJECTS];
+    int stackCurrent;
+
+    short ship[MAX_PLAYERS];
+    short thrust[MAX_PLAYERS][2];
+    short debris[MAX_PLAYERS][4];
+    int thrustCount[MAX_PLAYERS];
+    int debrisCount[MAX_PLAYERS];
+    float hyperspaceTime[MAX_PLAYERS];
+
+    SaucerState saucers[MAX_SAUCERS];
+    int saucerLimit;
+    float toNextSaucerTime;
+
+    short asteroidObject[MAX_ASTEROIDS];
+    int asteroidSize[MAX_ASTEROIDS];
+
+    short bulletObject[MAX_BULLETS];
+    float bulletLifetime[MAX_BULLETS];
+
+    ParticleSystem particleSystem;
+} GameplaySnapshot;
+
+static short GetObjectIndex(Object* obj) {
+    return (obj == NULL) ? -1 : (short)(obj - world->gameobjects);
+}
+
+static Object* GetObjectAt(short index) {
+    return (index < 0 || index >= MAX_GAME_OBJECTS) ? NULL : &world->gameobjects[index];
+}
+
+static unsigned char GetModelIndex(Vector2* vertices) {
+    for (int i = 0; i < MODEL_COUNT; ++i) {
+        if (modelVertices[i] == vertices) return (unsigned char)i;
+    }
+    return 0;
+}
+
+int GetGameplaySnapshotSize(void) {
+    return (int)sizeof(GameplaySnapshot);
+}
+
+// Writes the complete simulation state into data, returns the amount of bytes
+// written or 0 if the buffer is too small
+int SaveGameplaySnapshot(unsigned char* data, int size) {
+    if (size < (int)sizeof(GameplaySnapshot)) {
+        TraceLog(LOG_WARNING, "Snapshot buffer too small %i, expected %i", size, (int)sizeof(GameplaySnapshot));
+        return 0;
+    }
+
+    GameplaySnapshot* snap = (GameplaySnapshot*)data;
+    *snap = (GameplaySnapshot){ .magic = SNAPSHOT_MAGIC, .version = SNAPSHOT_VERSION, .size = sizeof(GameplaySnapshot) };
+    snap->rngState = world->rngState;
+    snap->game = world->game;
+    snap->sound = world->sound;
+
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        Object* obj = &world->gameobjects[i];
+        snap->objects[i] = (ObjectState){ .position = obj->position, .velocity = obj->velocity,
+            .rot = obj->rot, .rotVel = obj->rotVel, .active = obj->active,
+            .model = GetModelIndex(obj->initialVertices), .vertexCount = (unsigned char)obj->vertexCount };
+    }
+    for (int i = 0; i < world->stack.current; ++i) {
+        snap->stack[i] = GetObjectIndex(world->stack.content[i]);
+    }
+    snap->stackCurrent = world->stack.current;
+
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        snap->ship[p] = GetObjectIndex(world->parts[p].ship);
+        for (int i = 0; i < 2; ++i) snap->thrust[p][i] = GetObjectIndex(world->parts[p].thrust[i]);
+        for (int i = 0; i < 4; ++i) snap->debris[p][i] = GetObjectIndex(world->parts[p].debris[i]);
+        snap->thrustCount[p] = world->parts[p].thrustCount;
+        snap->debrisCount[p] = world->parts[p].debrisCount;
+        snap->hyperspaceTime[p] = world->parts[p].hyperspaceTime;
+    }
+
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        Saucer* saucer = &world->saucers[i];
+        snap->saucers[i] = (SaucerState){ .object = GetObjectIndex(saucer->object), .type = saucer->type,
+            .shotFreq = saucer->shotFreq, .toShootTime = saucer->toShootTime,
+            .toNextActionTime = saucer->toNextActionTime, .brain = saucer->brain };
+    }
+    snap->saucerLimit = world->saucerLimit;
+    snap->toNextSaucerTime = world->toNextSaucerTime;
+
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        snap->asteroidObject[i] = GetObjectIndex(world->asteroids[i].object);
+        snap->asteroidSize[i] = world->asteroids[i].size;
+    }
     for (int i = 0; i < MAX_BULLETS; ++i) {
-        bullets[i] = (Bullet){ 0 };
-        bullets[i].object = StackPop(&stack);
-        ObjectInit(bullets[i].object, bulletVertices, bulletVertexCount);
+        snap->bulletObject[i] = GetObjectIndex(world->bullets[i].object);
+        snap->bulletLifetime[i] = world->bullets[i].lifetime;
     }
 
-    // Asteroids are fully dynamic
+    snap->particleSystem = world->particleSystem;
+
+    return (int)sizeof(GameplaySnapshot);
+}
+
+// An object index of a snapshot has to name an object that no other slot uses, -1
+// (no object) only where the world can hold NULL
+static bool ClaimSnapshotObject(short index, bool optional, bool used[MAX_GAME_OBJECTS]) {
+    if (index == -1) return optional;
+    if (index < 0 || index >= MAX_GAME_OBJECTS || used[index]) return false;
+    used[index] = true;
+    return true;
+}
+
+// Snapshots come from files as well, every count and every index the restore or
+// the next steps use gets checked before anything is touched
+static bool IsSnapshotValid(const GameplaySnapshot* snap) {
+    if (snap->game.playerCount < 1 || snap->game.playerCount > MAX_PLAYERS) return false;
+    if (snap->stackCurrent < 0 || snap->stackCurrent > MAX_GAME_OBJECTS) return false;
+    if (snap->particleSystem.back < -1 || snap->particleSystem.back >= MAX_PARTICLES) return false;
+
+    // The free objects, the parts of the ships in play, the saucers and the bullets
+    // always have an object, asteroids and unused parts may have none
+    bool used[MAX_GAME_OBJECTS] = { 0 };
+    for (int i = 0; i < snap->stackCurrent; ++i) {
+        if (!ClaimSnapshotObject(snap->stack[i], false, used)) return false;
+    }
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        bool playing = p < snap->game.playerCount;
+        if (!ClaimSnapshotObject(snap->ship[p], !playing, used)) return false;
+        for (int i = 0; i < 2; ++i) {
+            if (!ClaimSnapshotObject(snap->thrust[p][i], !playing || i >= snap->thrustCount[p], used)) return false;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (!ClaimSnapshotObject(snap->debris[p][i], !playing || i >= snap->debrisCount[p], used)) return false;
+        }
+    }
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        if (!ClaimSnapshotObject(snap->saucers[i].object, false, used)) return false;
+    }
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        if (!ClaimSnapshotObject(snap->asteroidObject[i], true, used)) return false;
+    }
+    for (int i = 0; i < MAX_BULLETS; ++i) {
+        if (!ClaimSnapshotObject(snap->bulletObject[i], false, used)) return false;
+    }
+
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        const ObjectState* state = &snap->objects[i];
+        if (state->model >= MODEL_COUNT || state->vertexCount > modelVertexLimits[state->model]) return false;
+    }
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        if (snap->thrustCount[p] < 0 || snap->thrustCount[p] > 2) return false;
+        if (snap->debrisCount[p] < 0 || snap->debrisCount[p] > 4) return false;
+    }
     for (int i = 0; i < MAX_ASTEROIDS; ++i) {
-        asteroids[i] = (Asteroid){ .object = NULL, .size = -1 };
+        if (snap->asteroidSize[i] < -1 || snap->asteroidSize[i] >= ASTEROID_SIZE_NUM) return false;
+        if (snap->asteroidObject[i] >= 0 && snap->asteroidSize[i] < 0) return false;
     }
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        if (snap->saucers[i].type < SAUCER_SIZE_LARGE || snap->saucers[i].type > SAUCER_SIZE_SMALL) return false;
+    }
+    return true;
+}
 
-    for (int i = 0; i < asteroidVertexCount; ++i) {
-        asteroidVerticesMedium[i] = Vector2Scale(asteroidVerticesLarge[i], .5);
-        asteroidVerticesSmall[i] = Vector2Scale(asteroidVerticesLarge[i], .25);
+// Restores the simulation state from a snapshot, the gameplay screen needs to be
+// initialized, returns false and leaves the world as it is if the data isn't a
+// valid snapshot
+bool RestoreGameplaySnapshot(const unsigned char* data, int size) {
+    const GameplaySnapshot* snap = (const GameplaySnapshot*)data;
+    if (size < (int)sizeof(GameplaySnapshot) || snap->magic != SNAPSHOT_MAGIC ||
+        snap->version != SNAPSHOT_VERSION || snap->size != sizeof(GameplaySnapshot) ||
+        !IsSnapshotValid(snap)) {
+        TraceLog(LOG_WARNING, "Invalid gameplay snapshot");
+        return false;
     }
 
-    framesCounter = 0;
-    finishScreen = 0;
+    world->rngState = snap->rngState;
+    world->game = snap->game;
+    world->sound = snap->sound;
+
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        const ObjectState* state = &snap->objects[i];
+        Object* obj = &world->gameobjects[i];
+        obj->active = state->active;
+        obj->position = state->position;
+        obj->velocity = state->velocity;
+        obj->rot = state->rot;
+        obj->rotVel = state->rotVel;
+        obj->initialVertices = modelVertices[state->model];
+        if (obj->initialVertices == NULL || state->vertexCount == 0) {
+            obj->vertexCount = 0;
+            continue;
+        }
+        ObjectReserveVertices(obj, state->vertexCount);
+        UpdateObjectVertices(obj);
+    }
+    for (int i = 0; i < snap->stackCurrent; ++i) {
+        world->stack.content[i] = GetObjectAt(snap->stack[i]);
+    }
+    world->stack.current = snap->stackCurrent;
+
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        world->parts[p].ship = GetObjectAt(snap->ship[p]);
+        for (int i = 0; i < 2; ++i) world->parts[p].thrust[i] = GetObjectAt(snap->thrust[p][i]);
+        for (int i = 0; i < 4; ++i) world->parts[p].debris[i] = GetObjectAt(snap->debris[p][i]);
+        world->parts[p].thrustCount = snap->thrustCount[p];
+        world->parts[p].debrisCount = snap->debrisCount[p];
+        world->parts[p].hyperspaceTime = snap->hyperspaceTime[p];
+    }
+
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        const SaucerState* state = &snap->saucers[i];
+        world->saucers[i] = (Saucer){ .object = GetObjectAt(state->object), .type = state->type,
+            .shotFreq = state->shotFreq, .toShootTime = state->toShootTime,
+            .toNextActionTime = state->toNextActionTime, .brain = state->brain };
+    }
+    world->saucerLimit = (int)Clamp((float)snap->saucerLimit, 0, MAX_SAUCERS);
+    world->toNextSaucerTime = snap->toNextSaucerTime;
+
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        world->asteroids[i] = (Asteroid){ .object = GetObjectAt(snap->asteroidObject[i]), .size = snap->asteroidSize[i] };
+    }
+    for (int i = 0; i < MAX_BULLETS; ++i) {
+        world->bullets[i] = (Bullet){ .object = GetObjectAt(snap->bulletObject[i]), .lifetime = snap->bulletLifetime[i] };
+    }
+
+    world->particleSystem = snap->particleSystem;
+    world->events.count = 0;
+    for (int p = 0; p < MAX_PLAYERS; ++p) world->events.score[p] = 0;
+
+    return true;
+}
+
+// Quick save and load, F5 saves the current game, F9 goes back to it
+static void UpdateSaveStates() {
+    static const char* fileName = "quicksave.bin";
+    static GameplaySnapshot quickSave = { 0 };
+
+    if (IsKeyPressed(KEY_F5)) {
+        SaveGameplaySnapshot((unsigned char*)&quickSave, sizeof(quickSave));
+        SaveFileData(fileName, &quickSave, sizeof(quickSave));
+    }
+    if (IsKeyPressed(KEY_F9)) {
+        int size = 0;
+        unsigned char* data = LoadFileData(fileName, &size);
+        if (data != NULL) {
+            bool restored = RestoreGameplaySnapshot(data, size);
+            UnloadFileData(data);
+            if (restored) {
+                ResetTimeTravel();
+                DropReplayRecording();
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------
+// Main Gameplay Functions
+//----------------------------------------------------------------------------------
+
+static void ScaleModels(void)
+{
+    for (int i = 0; i < definitions.saucerVertexCount; ++i) {
+        saucerDataSmall[i] = Vector2Scale(definitions.saucerDataLarge[i], 0.6f);
+    }
+
+    for (int i = 0; i < definitions.asteroidVertexCount; ++i) {
+        asteroidVerticesMedium[i] = Vector2Scale(definitions.asteroidVerticesLarge[i], .5);
+        asteroidVerticesSmall[i] = Vector2Scale(definitions.asteroidVerticesLarge[i], .25);
+    }
+}
+
+// Scaled versions of the models are shared by all worlds, they get calculated when the
+// first world is set up. That isn't synchronized, programs that create worlds on several
+// threads create one on the main thread before they start (server.c, tools/verify.c)
+static void InitModels(void)
+{
+    static bool initialized = false;
+    if (initialized) return;
+    ScaleModels();
+    initialized = true;
+}
+
+// Takes changed definitions over into the running game, objects pick up the new shapes
+// with their next update as they point at the models
+static void ApplyReloadedDefinitions(void)
+{
+    ScaleModels();
+    screenWorld.saucerLimit = (int)Clamp((float)definitions.saucerLimit, 0, MAX_SAUCERS);
+
+    // The recorded steps ran with the old values, they wouldn't play back the same
+    ResetTimeTravel();
+    DropReplayRecording();
+}
+
+// Sets up a new game in w and makes it the current world
+static void InitWorld(World* w, int playerCount, unsigned int seed, int width, int height)
+{
+    InitModels();
+
+    world = w;
+    world->width = width;
+    world->height = height;
+
+    StackInit(&world->stack, world->gameobjects, MAX_GAME_OBJECTS);
+    InitParticleSystem(&world->particleSystem);
+    world->events = (EventQueue){ 0 };
+    world->sessionRecorded = false;
+
+    SeedGameRandom(seed);
+
+    world->game = (Game){ .playerCount = playerCount, .level = -1, .state = LEVEL_START, .stateTime = 0 };
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        world->game.players[p] = (Player){ .score = 0, .lives = 3, .hyperspace = 2,
+            .nextShip = definitions.nextShipInterval, .nextHyperspace = definitions.nextHyperSpaceInverval };
+    }
+    world->sound = (BackgroundSound){ .interval = 2, .elapsed = 0, .beat = SOUND_BEAT_1 };
+
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        ShipParts* shipParts = &world->parts[p];
+
+        // Ship
+        shipParts->ship = StackPop(&world->stack);
+        ObjectInit(shipParts->ship, definitions.shipVertices, definitions.shipVertexCount);
+        ResetShip(p);
+
+        // Ship Debris
+        shipParts->debrisCount = 3;
+        for (int i = 0; i < shipParts->debrisCount; ++i) {
+            shipParts->debris[i] = StackPop(&world->stack);
+            ObjectInit(shipParts->debris[i], shipDebrisVertices, shipDebrisVertexCount);;
+        }
+
+        // Thust Graphics
+        shipParts->thrustCount = 2;
+        for (int i = 0; i < shipParts->thrustCount; ++i) {
+            shipParts->thrust[i] = StackPop(&world->stack);
+            ObjectInit(shipParts->thrust[i], shipThrustVertices[i], shipThrustVertexCount);
+        }
+    }
+    for (int p = world->game.playerCount; p < MAX_PLAYERS; ++p) {
+        world->parts[p] = (ShipParts){ 0 };
+    }
+
+    // Saucers, one at a time unless the difficulty or stress mode asks for more
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        Saucer* saucer = &world->saucers[i];
+        *saucer = (Saucer){ .object = 0, .toShootTime = 0, .shotFreq = 1.5f, .type = 0, .toNextActionTime = definitions.saucerActionTime };
+        saucer->object = StackPop(&world->stack);
+        saucer->object->active = false;
+        saucer->object->initialVertices = definitions.saucerDataLarge;
+        ObjectReserveVertices(saucer->object, definitions.saucerVertexCount);
+    }
+    world->saucerLimit = (int)Clamp((float)definitions.saucerLimit, 0, MAX_SAUCERS);
+    world->toNextSaucerTime = definitions.saucerSpawnFrequency;
+
+    // Bullets
+    for (int i = 0; i < MAX_BULLETS; ++i) {
+        world->bullets[i] = (Bullet){ 0 };
+        world->bullets[i].object = StackPop(&world->stack);
+        ObjectInit(world->bullets[i].object, bulletVertices, bulletVertexCount);
+    }
+
+    // Asteroids are fully dynamic
+    for (int i = 0; i < MAX_ASTEROIDS; ++i) {
+        world->asteroids[i] = (Asteroid){ .object = NULL, .size = -1 };
+    }
+
+    world->finishScreen = 0;
 
     ResetLevel();
 }
 
-void UpdateGameplayScreen(void)
+// Releases the vertices of all objects in w
+static void FreeWorldObjects(World* w)
+{
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        Object* obj = &w->gameobjects[i];
+        RL_FREE(obj->vertices);
+        *obj = (Object){ 0 };
+    }
+    w->stack.current = 0;
+}
+
+// Updates the pool gauges with the current world, each world adds the change since its
+// last report so the gauges of all worlds in the server add up
+static void ReportWorldTelemetry(void)
+{
+    int objects = 0;
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        if (world->gameobjects[i].active) ++objects;
+    }
+    int bullets = 0;
+    for (int i = 0; i < MAX_BULLETS; ++i) {
+        if (world->bullets[i].lifetime >= 0) ++bullets;
+    }
+    long long pools[TELEMETRY_POOL_COUNT] = { objects, world->particleSystem.back + 1, bullets, CountAsteroids() };
+
+    for (int i = 0; i < TELEMETRY_POOL_COUNT; ++i) {
+        AddTelemetry(TELEMETRY_OBJECTS + i, pools[i] - world->reportedPools[i]);
+        MaxTelemetry(TELEMETRY_OBJECTS_MAX + i, pools[i]);
+        world->reportedPools[i] = pools[i];
+    }
+}
+
+// Takes what w added to the gauges back out, before it goes away
+static void ClearWorldTelemetry(World* w)
+{
+    for (int i = 0; i < TELEMETRY_POOL_COUNT; ++i) {
+        AddTelemetry(TELEMETRY_OBJECTS + i, -w->reportedPools[i]);
+        w->reportedPools[i] = 0;
+    }
+}
+
+void InitGameplayScreen(void)
 {
-    game.dt = GetFrameTime();
-    game.stateTime += game.dt;
+    // Both sides of a versus game need to run the exact same simulation
+    unsigned int seed = IsNetplayActive() ? GetNetplaySeed() : (unsigned int)GetRandomValue(1, 0x7fffffff);
+    InitWorld(&screenWorld, IsNetplayActive() ? 2 : 1, seed, VIEW_WIDTH, VIEW_HEIGHT);
+
+    framesCounter = 0;
+    for (int p = 0; p < MAX_PLAYERS; ++p) {
+        scoreLayoutValue[p] = -1;
+    }
 
-    if (game.score > nextShip) {
-        game.lives += 1;
-        nextShip += nextShipInterval;
+    // Rollback already owns the history in versus
+    if (!IsNetplayActive()) {
+        InitTimeTravel();
+        BeginReplayRecording(seed, 1);
     }
+}
+
+// Advances the game by one step, inputs holds the actions for each player. This is
+// the whole simulation, in versus it gets called again for steps that have to be
+// simulated again after a rollback, then presentEffects is false
+void StepGameplay(const int inputs[MAX_PLAYERS], float dt, bool presentEffects)
+{
+    world->game.dt = dt;
+    world->game.stateTime += world->game.dt;
+    world->game.time += world->game.dt;
+
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        Player* player = &world->game.players[p];
+        if (player->score > player->nextShip) {
+            player->lives += 1;
+            player->nextShip += definitions.nextShipInterval;
+        }
 
-    if (game.score > nextHyperspace) {
-        game.hyperspace += 1;
-        nextHyperspace += nextHyperSpaceInverval;
+        if (player->score > player->nextHyperspace) {
+            player->hyperspace += 1;
+            player->nextHyperspace += definitions.nextHyperSpaceInverval;
+        }
     }
 
-    switch (game.state) {
+    switch (world->game.state) {
     case LEVEL_START:
-        parts.ship->active = false;
-        if (game.stateTime > 3.0) {
-            parts.ship->active = true;
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            world->parts[p].ship->active = false;
+        }
+        if (world->game.stateTime > 3.0) {
+            for (int p = 0; p < world->game.playerCount; ++p) {
+                world->parts[p].ship->active = true;
+            }
             CreateLevel();
             SetState(RUNNING);
         } 
         break;
-    case HYPERSPACE:
-    {
-        UpdateBackgroundSound();
-        if (game.stateTime > .75f) {
-            SetState(RUNNING);
-            parts.ship->active = true;
-        }
-        UpdateSaucer();
-        UpdateBullets();
-        UpdateParticles(&particleSystem, game.dt);
-        UpdateGameObjects();
-        break;
-    }
     case RUNNING:
     {
-        UpdateBackgroundSound();
-        UpdateShip(parts.ship);
-        UpdateParticles(&particleSystem, game.dt);
-        UpdateSaucer();
+        UpdateBackgroundSound(presentEffects);
+#ifdef STRESSMODE
+        UpdateStress();
+#endif
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            UpdateShip(p, inputs[p]);
+        }
+        UpdateParticles(&world->particleSystem, world->game.dt);
+        // Saucers stay out of versus games
+        if (world->game.playerCount == 1) {
+            BuildAsteroidGrid();
+            UpdateSaucers();
+        }
         UpdateBullets();
         UpdateGameObjects();
+        // Like the original, while the only ship is in hyperspace nothing collides
+        // and the level can't end
+        if (world->game.playerCount == 1 && world->parts[0].hyperspaceTime > 0) {
+            break;
+        }
         if (CheckCollisions()) {
             SetState(DYING);
         }
@@ -1278,10 +2378,12 @@ void UpdateGameplayScreen(void)
         break;
     }
     case LEVEL_DONE:
-        UpdateShip(parts.ship);
-        UpdateParticles(&particleSystem, game.dt);
+        for (int p = 0; p < world->game.playerCount; ++p) {
+            UpdateShip(p, inputs[p]);
+        }
+        UpdateParticles(&world->particleSystem, world->game.dt);
         UpdateBullets();
-        if (game.stateTime > 2.0f) {
+        if (world->game.stateTime > 2.0f) {
             NextLevel();
             SetState(RUNNING);
         }
@@ -1289,96 +2391,378 @@ void UpdateGameplayScreen(void)
     case DYING:
     {
         UpdateGameObjects();
-        UpdateParticles(&particleSystem, game.dt);
-        if (game.stateTime > 3.0) {
-            if (game.lives > 0) {
+        UpdateParticles(&world->particleSystem, world->game.dt);
+        if (world->game.stateTime > 3.0) {
+            if (!IsGameOver()) {
                 ResetLevel();
             }
+            else if (world->game.playerCount > 1) {
+                world->finishScreen = 2; // Versus games don't go into the highscores
+            }
             else {
-
-                if (GetHighscorePosition(scores, MAX_HIGHSCORES, lastGameScore) < 0)
+                // Every score that makes the venue table gets a name and sees its rank,
+                // not only the top five the title screen shows
+                if (GetHighscoreRank(&highscores, world->game.players[0].score) < 0)
                 {
-                    finishScreen = 2; // Return to title screen
+                    world->finishScreen = 2; // Return to title screen
                 }
                 else {
-                    finishScreen = 1; // Go to ending scree
+                    world->finishScreen = 1; // Go to ending scree
                 }
             }
         }
         break;
     }
     }
+
+    // Side effects of the step
+    ProcessEvents(&world->events, presentEffects);
+    if (presentEffects) UpdateLoopingSounds();
 }
 
-// Gameplay Screen Draw logic
-void DrawGameplayScreen(void)
+void UpdateGameplayScreen(void)
 {
-    DrawTextEx(smallFont, TextFormat("%i", game.score), (Vector2) { 20, 20 }, (float)smallFont.baseSize, 1.0f,RAYWHITE);
+    double start = GetTime();
+
+    // Netplay decides which steps to run, and with which inputs
+    if (IsNetplayActive()) {
+        UpdateNetplay(UpdateInput());
+    }
+    else {
+        // While the time travel debugger is paused it shows the recorded steps instead,
+        // input is only sampled for a step that runs so nothing queued gets thrown away
+        if (UpdateTimeTravel()) return;
+        int input = UpdateInput();
+
+        // Tuning changes apply between steps, versus games keep the values they started with
+        if (ReloadChangedDefinitions()) ApplyReloadedDefinitions();
+
+        UpdateSaveStates();
+
+        int inputs[MAX_PLAYERS] = { input };
+        RecordReplayStep(inputs, GetFrameTime());
+        StepGameplayRecorded(inputs, GetFrameTime());
+    }
 
-    Vector2 pos = { 20, smallFont.baseSize + 1.2f * gameScale };
+    // Rollbacks count into the time of the step that caused them
+    AddTelemetry(TELEMETRY_TICKS, 1);
+    AddTelemetry(TELEMETRY_TICK_TIME, (long long)((GetTime() - start) * 1e6));
+    ReportWorldTelemetry();
 
-    for (int i = 0; i < game.lives; ++i) {
-        Vector2 start = Vector2Add(Vector2Scale(shipVertices[0], gameScale), pos);
-        for (int v = 1; v < shipVertexCount; ++v)
+    if (spectatorStream != NULL) WriteSpectatorFrame(spectatorStream, &screenWorld);
+
+    if (IsWorldFinished(&screenWorld) && !screenWorld.sessionRecorded) {
+        SessionRecord records[MAX_PLAYERS];
+        int count = GetWorldSessionRecords(&screenWorld, records);
+        for (int p = 0; p < count; ++p) AppendSessionRecord(&records[p]);
+        screenWorld.sessionRecorded = true;
+    }
+}
+
+// Draws score, lives and hyperspace jumps of a player, the second player is
+// drawn on the right side of the screen
+void DrawPlayerHud(int p)
+{
+    Player* player = &world->game.players[p];
+    if (player->score != scoreLayoutValue[p]) {
+        LayoutText(&scoreLayout[p], smallFont, TextFormat("%i", player->score), (float)smallFont.baseSize, 1.0f);
+        scoreLayoutValue[p] = player->score;
+    }
+
+    float left = (p == 0) ? 20 : VIEW_WIDTH - 20 - 5 * .8f * gameScale;
+    DrawTextLayout(&scoreLayout[p], (Vector2) { left, 20 }, RAYWHITE);
+
+    Vector2 pos = { left, smallFont.baseSize + 1.2f * gameScale };
+
+    for (int i = 0; i < player->lives; ++i) {
+        Vector2 start = Vector2Add(Vector2Scale(definitions.shipVertices[0], gameScale), pos);
+        for (int v = 1; v < definitions.shipVertexCount; ++v)
         {
-            Vector2 end = Vector2Add(Vector2Scale(shipVertices[v], gameScale), pos);
-            DrawLineV(start, end, RAYWHITE);
+            Vector2 end = Vector2Add(Vector2Scale(definitions.shipVertices[v], gameScale), pos);
+            CanvasLine(start, end, RAYWHITE);
             start = end;
         }
         pos.x += .8f * gameScale;
     }
 
-    pos = (Vector2){ 15, pos.y + 1.2f * gameScale };
+    pos = (Vector2){ left - 5, pos.y + 1.2f * gameScale };
 
-    for (int i = 0; i < game.hyperspace; ++i) {
-        DrawRectangleLines((int)pos.x, (int)pos.y, 10, 20, RAYWHITE);
+    for (int i = 0; i < player->hyperspace; ++i) {
+        CanvasRectangleLines((int)pos.x, (int)pos.y, 10, 20, RAYWHITE);
         pos.x += .8f * gameScale;
     }
+}
 
-    pos.x += 10;
-    Object* obj = &gameobjects[0];
+// Gameplay Screen Draw logic
+void DrawGameplayScreen(void)
+{
+    for (int p = 0; p < world->game.playerCount; ++p) {
+        DrawPlayerHud(p);
+    }
+
+    int drawn = 0;
+    Object* obj = &world->gameobjects[0];
     for (int i = 0; i < MAX_GAME_OBJECTS; ++i, ++obj) {
         if (!obj->active) continue;
-        DrawLineStrip(obj->vertices, obj->vertexCount, RAYWHITE);
+        CanvasLineStrip(obj->vertices, obj->vertexCount, RAYWHITE);
+        ++drawn;
     }
 
-    DrawParticles(&particleSystem);
+    DrawParticles(&world->particleSystem);
+    SetTelemetry(TELEMETRY_DRAW_CALLS, drawn + world->particleSystem.back + 1);
 
-    switch (game.state) {
+    switch (world->game.state) {
     case LEVEL_START:
     {
-        DrawTextLineCentered(largeFont, "START", GetScreenHeight() / 3.0f, 1.0);
+        DrawTextLineCentered(largeFont, "START", VIEW_HEIGHT / 3.0f, 1.0);
         break;
     }
-    case HYPERSPACE: 
+    case RUNNING:
     {
-        DrawTextLineCentered(largeFont, "HYPERSPACE", GetScreenHeight() / 3.0f, 1.0);
+        if (world->parts[GetNetplayLocalPlayer()].hyperspaceTime > 0) {
+            DrawTextLineCentered(largeFont, "HYPERSPACE", VIEW_HEIGHT / 3.0f, 1.0);
+        }
         break;
     }
+    case DYING:
+    {
+        if (world->game.playerCount > 1 && IsGameOver()) {
+            const char* text = (world->game.players[0].lives > 0) ? "PLAYER 1 WINS" :
+                (world->game.players[1].lives > 0) ? "PLAYER 2 WINS" : "DRAW";
+            DrawTextLineCentered(largeFont, text, VIEW_HEIGHT / 3.0f, 1.0);
+        }
+        break;
+    }
+    }
+
+    if (IsNetplayActive()) {
+        if (IsNetplayWaiting()) {
+            DrawTextLineCentered(smallFont, "WAITING FOR OTHER PLAYER", VIEW_HEIGHT * 2.0f / 3.0f, 1.0);
+        }
+        NetplayStats stats = GetNetplayStats();
+        CanvasText(smallFont, TextFormat("PING %i ROLLBACK %i %.1fMS", stats.ping, stats.rollbackFrames, stats.resimulateMs),
+            (Vector2){ 20, VIEW_HEIGHT - 30.0f }, smallFont.baseSize * 0.5f, 1.0f, GRAY);
     }
 
 #ifdef DEBUGDRAW
     DrawAsteroidCollisions();
 #endif
+
+    DrawTimeTravel();
 }
 
 // Gameplay Screen Unload logic
 void UnloadGameplayScreen(void)
 {
-    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
-        Object* obj = &gameobjects[i];
-        free(obj->vertices);
-        obj->vertices = 0;
-        obj->active = false;
-        *obj = (Object){ 0 };
-    }
+    StopAllEffects();
 
-    stack.current = 0;
-    lastGameScore = game.score;
+    ClearWorldTelemetry(&screenWorld);
+    SetTelemetry(TELEMETRY_DRAW_CALLS, 0);
+    FreeWorldObjects(&screenWorld);
+    lastGameScore = screenWorld.game.players[0].score;
+
+    CloseNetplay();
+    CloseTimeTravel();
+    EndReplayRecording();
 }
 
 // Gameplay Screen should finish?
 int FinishGameplayScreen(void)
 {
-    return finishScreen;
-}
\ No newline at end of file
+    return world->finishScreen;
+}
+//----------------------------------------------------------------------------------
+// World Functions, used by the server to run many games in one process
+//----------------------------------------------------------------------------------
+
+World* CreateWorld(int playerCount, unsigned int seed, int width, int height)
+{
+    World* w = (World*)RL_CALLOC(1, sizeof(World));
+    if (w == NULL) return NULL;
+    InitWorld(w, (playerCount > MAX_PLAYERS) ? MAX_PLAYERS : playerCount, seed, width, height);
+    return w;
+}
+
+void DestroyWorld(World* w)
+{
+    if (w == NULL) return;
+    ClearWorldTelemetry(w);
+    FreeWorldObjects(w);
+    if (world == w) world = &screenWorld;
+    RL_FREE(w);
+}
+
+// Runs one step of w on the calling thread, the world doesn't produce sounds
+void StepWorld(World* w, const int inputs[MAX_PLAYERS], float dt)
+{
+    world = w;
+    StepGameplay(inputs, dt, false);
+    ReportWorldTelemetry();
+}
+
+// Draws w like the gameplay screen does, into the canvas raster when one is set
+void DrawWorld(World* w)
+{
+    world = w;
+    DrawGameplayScreen();
+}
+
+// The game in w is over, it would have left the gameplay screen
+bool IsWorldFinished(const World* w)
+{
+    return w->finishScreen != 0;
+}
+
+// Fills in the session log records of the players of w, returns the amount of players.
+// Levels are counted from 1, game.level is -1 during the first one
+int GetWorldSessionRecords(const World* w, SessionRecord records[MAX_PLAYERS])
+{
+    for (int p = 0; p < w->game.playerCount; ++p) {
+        const Player* player = &w->game.players[p];
+        records[p] = (SessionRecord){ .endTime = (long long)time(NULL), .score = player->score,
+            .level = w->game.level + 2, .duration = w->game.time, .shotsFired = player->shotsFired,
+            .hits = player->hits, .hyperspaceJumps = player->hyperspaceJumps,
+            .playerCount = (unsigned char)w->game.playerCount, .player = (unsigned char)p };
+        for (int c = 0; c < SESSION_DEATH_CAUSES; ++c) records[p].deaths[c] = player->deaths[c];
+    }
+    return w->game.playerCount;
+}
+
+// Writes what can be seen of each object slot of w into views, entries of inactive
+// slots are written as well so the index matches the slot, returns the amount of entries
+int GetWorldObjectViews(const World* w, ObjectView* views, int maxViews)
+{
+    int count = (maxViews < MAX_GAME_OBJECTS) ? maxViews : MAX_GAME_OBJECTS;
+    for (int i = 0; i < count; ++i) {
+        const Object* obj = &w->gameobjects[i];
+        views[i] = (ObjectView){ .active = obj->active };
+        if (!obj->active) continue;
+        views[i].position = obj->position;
+        views[i].velocity = Vector2Scale(obj->velocity, gameScale);
+        views[i].rot = obj->rot;
+        views[i].rotVel = obj->rotVel;
+        views[i].model = GetModelIndex(obj->initialVertices);
+    }
+    return count;
+}
+
+WorldStatus GetWorldStatus(const World* w)
+{
+    return (WorldStatus){ .state = w->game.state, .level = w->game.level, .score = w->game.players[0].score,
+        .lives = w->game.players[0].lives, .width = w->width, .height = w->height };
+}
+
+// Every step of the gameplay screen gets written to stream, NULL to stop
+void SetGameplaySpectatorStream(SpectatorStream* stream)
+{
+    spectatorStream = stream;
+}
+
+// The world the gameplay screen plays in
+World* GetGameplayWorld(void)
+{
+    return &screenWorld;
+}
+
+static int WriteU16(unsigned char* data, int at, unsigned int value)
+{
+    data[at] = (unsigned char)(value & 0xff);
+    data[at + 1] = (unsigned char)((value >> 8) & 0xff);
+    return at + 2;
+}
+
+// Writes a compact version of the visible state into data: game state, score and lives
+// for each player, then position (whole pixels), rotation (1/256 turns) and model for
+// every active object. Returns the amount of bytes written, 0 if data is too small
+int EncodeWorldState(World* w, unsigned char* data, int size)
+{
+    int activeCount = 0;
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        if (w->gameobjects[i].active) ++activeCount;
+    }
+
+    int needed = 4 + w->game.playerCount * 6 + 2 + activeCount * 6;
+    if (size < needed) return 0;
+
+    int at = 0;
+    data[at++] = (unsigned char)w->game.state;
+    data[at++] = (unsigned char)w->game.level;
+    data[at++] = (unsigned char)w->game.playerCount;
+    data[at++] = 0;
+    for (int p = 0; p < w->game.playerCount; ++p) {
+        unsigned int score = (unsigned int)w->game.players[p].score;
+        at = WriteU16(data, at, score & 0xffff);
+        at = WriteU16(data, at, score >> 16);
+        data[at++] = (unsigned char)w->game.players[p].lives;
+        data[at++] = (unsigned char)w->game.players[p].hyperspace;
+    }
+
+    at = WriteU16(data, at, (unsigned int)activeCount);
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        Object* obj = &w->gameobjects[i];
+        if (!obj->active) continue;
+        at = WriteU16(data, at, (unsigned int)Clamp(obj->position.x, 0, 65535));
+        at = WriteU16(data, at, (unsigned int)Clamp(obj->position.y, 0, 65535));
+        data[at++] = (unsigned char)((int)(obj->rot * 256.0f / 360.0f) & 0xff);
+        data[at++] = GetModelIndex(obj->initialVertices);
+    }
+
+    return at;
+}
+
+static unsigned int HashBytes(unsigned int hash, const void* data, int size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (int i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over the state the rest of the game follows from: the random state, game state,
+// level and timers, the players and their hyperspace, the lifetimes of the bullets, the
+// timers and brains of the saucers, and every active object with the exact bits of its
+// position, velocity and rotation. Particles and sounds are left out. Golden values of
+// this hash catch any change to how the game plays (tools/verify.c), timers and plans
+// as soon as they differ rather than once they move something
+unsigned int HashWorldState(const World* w)
+{
+    unsigned int hash = 2166136261u;
+    hash = HashBytes(hash, &w->rngState, sizeof(w->rngState));
+    hash = HashBytes(hash, &w->game.state, sizeof(w->game.state));
+    hash = HashBytes(hash, &w->game.level, sizeof(w->game.level));
+    hash = HashBytes(hash, &w->game.stateTime, sizeof(w->game.stateTime));
+    hash = HashBytes(hash, &w->toNextSaucerTime, sizeof(w->toNextSaucerTime));
+    for (int p = 0; p < w->game.playerCount; ++p) {
+        const Player* player = &w->game.players[p];
+        int values[4] = { player->score, player->lives, player->hyperspace, player->nextShip };
+        hash = HashBytes(hash, values, sizeof(values));
+        hash = HashBytes(hash, &w->parts[p].hyperspaceTime, sizeof(w->parts[p].hyperspaceTime));
+    }
+
+    // A free bullet has a negative lifetime, all of them decide which one fires next
+    for (int i = 0; i < MAX_BULLETS; ++i) {
+        hash = HashBytes(hash, &w->bullets[i].lifetime, sizeof(w->bullets[i].lifetime));
+    }
+    for (int i = 0; i < MAX_SAUCERS; ++i) {
+        const Saucer* saucer = &w->saucers[i];
+        if (!saucer->object->active) continue;
+        const SaucerBrain* brain = &saucer->brain;
+        float values[9] = { saucer->shotFreq, saucer->toShootTime, saucer->toNextActionTime,
+            brain->heading.x, brain->heading.y, brain->bestHeading.x, brain->bestHeading.y, brain->bestScore, brain->headingOffset };
+        int ints[3] = { i, saucer->type, brain->nextHeading };
+        hash = HashBytes(hash, ints, sizeof(ints));
+        hash = HashBytes(hash, values, sizeof(values));
+    }
+
+    for (int i = 0; i < MAX_GAME_OBJECTS; ++i) {
+        const Object* obj = &w->gameobjects[i];
+        if (!obj->active) continue;
+        float values[6] = { obj->position.x, obj->position.y, obj->velocity.x, obj->velocity.y, obj->rot, obj->rotVel };
+        unsigned char model = GetModelIndex(obj->initialVertices);
+        hash = HashBytes(hash, &i, sizeof(i));
+        hash = HashBytes(hash, values, sizeof(values));
+        hash = HashBytes(hash, &model, sizeof(model));
+    }
+    return hash;
+}
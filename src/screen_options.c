@@ -65,7 +65,7 @@ void InitOptionsScreen(void)
 
     currentBlinkTime = blinkTime;
     for (int i = 0; i < CONTROL_MAX; ++i) {
-        localKeys[i] = controlKeys[i];
+        localKeys[i] = GetControlKey(&controlMap, i);
     }
 }
 
@@ -117,7 +117,7 @@ void UpdateOptionsScreen(void)
 
     if (key == KEY_ENTER && errorMessage == NULL) {
         for (int i = 0; i < CONTROL_MAX; ++i) {
-            controlKeys[i] = localKeys[i];
+            SetControlKey(&controlMap, i, localKeys[i]);
         }
         finishScreen = 1;
         return;
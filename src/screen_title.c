@@ -35,6 +35,8 @@ static int finishScreen = 0;
 static char* anyKey = "press <return> to start\npress <o> for options";
 static Vector2 anyKeyPos = { 0 };
 
+static TextLayout lastScoreLayout = { 0 };
+
 //----------------------------------------------------------------------------------
 // Title Screen Functions Definition
 //----------------------------------------------------------------------------------
@@ -45,9 +47,12 @@ void InitTitleScreen(void)
     framesCounter = 0;
     finishScreen = 0;
 
-    Vector2 anyKeySize = MeasureTextEx(smallFont, anyKey, (float)smallFont.baseSize, 1.0);
-    anyKeyPos.x = (GetScreenWidth() - anyKeySize.x) / 2.0f;
+    Vector2 anyKeySize = MeasureTextCached(smallFont, anyKey, (float)smallFont.baseSize, 1.0);
+    anyKeyPos.x = (VIEW_WIDTH - anyKeySize.x) / 2.0f;
     anyKeyPos.y = 600;
+
+    // Score doesn't change while on this screen
+    LayoutText(&lastScoreLayout, smallFont, TextFormat("%i", lastGameScore), (float)smallFont.baseSize, 1.0f);
 }
 
 // Title Screen Update logic
@@ -65,9 +70,9 @@ void UpdateTitleScreen(void)
 // Title Screen Draw logic
 void DrawTitleScreen(void)
 {
-    DrawTextEx(smallFont, TextFormat("%i", lastGameScore), (Vector2) { 20, 20 }, (float)smallFont.baseSize, 1.0f, RAYWHITE);
-    DrawHighscores(smallFont, GetScreenHeight() / 3.0f,(float)smallFont.baseSize * 1.05f , 200.0f, scores, MAX_HIGHSCORES);
-    DrawTextEx(smallFont, anyKey, anyKeyPos, (float)smallFont.baseSize,1.0, RAYWHITE);
+    DrawTextLayout(&lastScoreLayout, (Vector2) { 20, 20 }, RAYWHITE);
+    DrawHighscores(smallFont, VIEW_HEIGHT / 3.0f,(float)smallFont.baseSize * 1.05f , 200.0f, &highscores, MAX_HIGHSCORES);
+    DrawTextCached(smallFont, anyKey, anyKeyPos, (float)smallFont.baseSize,1.0, RAYWHITE);
 }
 
 // Title Screen Unload logic
@@ -34,6 +34,12 @@ typedef enum Sounds {
     SOUND_THRUST, SOUND_MAX
 } Sounds;
 
+#define MAX_PLAYERS 2
+
+// Logical screen size, every screen simulates and draws in it whatever the window size
+#define VIEW_WIDTH 1024
+#define VIEW_HEIGHT 768
+
 typedef enum Controls{
     CONTROL_LEFT,
     CONTROL_RIGHT,
@@ -43,6 +49,34 @@ typedef enum Controls{
     CONTROL_MAX,
 } Keys;
 
+#define CONTROL_MAX_BINDINGS 4      // Keys, buttons and axes per control
+#define CONTROL_MAX_UNKNOWN 16      // Entries of newer versions that are kept
+#define CONTROL_MAX_ENTRY_SIZE 32   // Bytes of each kept entry, longer ones get dropped
+
+typedef enum BindingDevice {
+    BINDING_NONE = 0,
+    BINDING_KEY = 1,
+    BINDING_GAMEPAD_BUTTON = 2,
+    BINDING_GAMEPAD_AXIS = 3,   // Down while the axis is past INPUT_AXIS_THRESHOLD
+} BindingDevice;
+
+#define GAMEPAD_ANY 0xff            // Binds every connected gamepad
+#define AXIS_NEGATIVE 0x8000        // Added to the axis of a binding to the negative side
+
+typedef struct ControlBinding {
+    unsigned char device;       // BindingDevice
+    unsigned char gamepad;      // Gamepad bindings only, an index or GAMEPAD_ANY
+    unsigned short code;        // KeyboardKey, GamepadButton or GamepadAxis with AXIS_NEGATIVE
+} ControlBinding;
+
+typedef struct ControlMap {
+    ControlBinding bindings[CONTROL_MAX][CONTROL_MAX_BINDINGS];
+    unsigned char unknown[CONTROL_MAX_UNKNOWN][CONTROL_MAX_ENTRY_SIZE];
+    int unknownCount;
+    int unknownSize;            // Entry size of the file the unknown entries came from
+    int revision;               // Changes with every change of the bindings
+} ControlMap;
+
 
 
 //----------------------------------------------------------------------------------
@@ -52,7 +86,7 @@ extern GameScreen currentScreen;
 extern Font smallFont;
 extern Font largeFont;
 extern Sound sounds[SOUND_MAX];
-extern int controlKeys[CONTROL_MAX];
+extern ControlMap controlMap;
 extern int lastGameScore;
 
 
@@ -97,6 +131,46 @@ void DrawGameplayScreen(void);
 void UnloadGameplayScreen(void);
 int FinishGameplayScreen(void);
 
+void StepGameplay(const int inputs[MAX_PLAYERS], float dt, bool presentEffects);
+
+int GetGameplaySnapshotSize(void);
+int SaveGameplaySnapshot(unsigned char* data, int size);
+bool RestoreGameplaySnapshot(const unsigned char* data, int size);
+
+// Independent games for the server, each world is a complete game of its own
+typedef struct World World;
+
+World* CreateWorld(int playerCount, unsigned int seed, int width, int height);
+void DestroyWorld(World* world);
+void StepWorld(World* world, const int inputs[MAX_PLAYERS], float dt);
+void DrawWorld(World* world);
+bool IsWorldFinished(const World* world);
+int EncodeWorldState(World* world, unsigned char* data, int size);
+unsigned int HashWorldState(const World* world);
+World* GetGameplayWorld(void);
+
+// What a viewer can see of one object, velocity is in pixels and rotVel in degrees per second
+typedef struct ObjectView {
+    bool active;
+    Vector2 position;
+    Vector2 velocity;
+    float rot;
+    float rotVel;
+    int model;
+} ObjectView;
+
+typedef struct WorldStatus {
+    int state;
+    int level;
+    int score;
+    int lives;
+    int width;
+    int height;
+} WorldStatus;
+
+int GetWorldObjectViews(const World* world, ObjectView* views, int maxViews);
+WorldStatus GetWorldStatus(const World* world);
+
 void InitEndingScreen(void);
 void UpdateEndingScreen(void);
 void DrawEndingScreen(void);
@@ -106,26 +180,438 @@ int FinishEndingScreen(void);
 //----------------------------------------------------------------------------------
 // Highscore Handling
 //----------------------------------------------------------------------------------
-typedef struct Highscore
-{
-    char name[4];// 3 chars + 0
-    char score[32];
-} Highscore;
+#define MAX_HIGHSCORES 5                // Shown on the title screen
+#define HIGHSCORE_TABLE_SIZE 10000      // Kept in the file
+#define HIGHSCORE_NAME_LENGTH 3
+#define HIGHSCORE_FILE_NAME_SIZE 256
+
+typedef struct HighscoreEntry {
+    int score;
+    char name[HIGHSCORE_NAME_LENGTH + 1];
+} HighscoreEntry;
+
+// Sorted from the highest score down
+typedef struct HighscoreTable {
+    HighscoreEntry* entries;
+    int count;
+    int capacity;
+    char fileName[HIGHSCORE_FILE_NAME_SIZE];
+} HighscoreTable;
 
-#define MAX_HIGHSCORES 5
-extern Highscore scores[MAX_HIGHSCORES];
+extern HighscoreTable highscores;
 
-void LoadHigscores(const char* fileName, Highscore scores[], int maxScores);
-void WriteHigscores(const char* fileName, Highscore scores[], int maxScores);
+const char* GetHighscoreFileName(const char* venue);
+void LoadHighscores(HighscoreTable* table, const char* fileName, int capacity);
+bool SaveHighscores(const HighscoreTable* table);
+void UnloadHighscores(HighscoreTable* table);
 
-int GetHighscorePosition(Highscore scores[], int maxScores, int score);
-void InsertHighscore(Highscore scores[], int maxScores, int at, char* name, int score);
+int GetHighscoreRank(const HighscoreTable* table, int score);
+int InsertHighscore(HighscoreTable* table, const char* name, int score);
 
 void DrawTextLineCentered(Font font, const char* text, float y, float spacing);
-void DrawHighscores(Font font, float top, float lineSpace, float gap, Highscore* scores, int maxScores);
+void DrawHighscores(Font font, float top, float lineSpace, float gap, const HighscoreTable* table, int maxScores);
+
+//----------------------------------------------------------------------------------
+// Game Definitions
+//----------------------------------------------------------------------------------
+#define DEFINITION_MAX_VERTICES 16
+
+// Everything that tunes the game, the values read every step come first. Sizes go
+// from large to small, lengths are in ship lengths and times in seconds
+typedef struct GameDefinitions {
+    float shipAccelerationFactor;   // Used under thrust
+    float shipRotationFactor;       // Used when the player turns
+    float shipDecelerationFactor;   // Slows down the ship
+    float shipMaxSpeed;
+    float shipSpeedCutoff;          // When ship is slower than this, stop it
+    float bulletInitialLifetime;
+    float bulletInitialVelocity;
+    float asteroidVelocity[3];
+    float asteroidRadius[3];        // Used in collision
+    float levelSpeedIncrease;       // Gets multiplied with level and added to speed for each new asteroid
+    float hyperspaceDuration;       // Time the ship is gone when jumping
+    float saucerSpawnFrequency;
+    float saucerSpawnChance;
+    float saucerActionTime;
+
+    int startingAsteroids;
+    int maxAsteroids;               // Each level adds asteroids, this is the max
+    int saucerLimit;                // Saucers that may be active at once
+    int nextShipInterval;           // Score between free ships
+    int nextHyperSpaceInverval;     // Score between hyperspace jumps
+    int asteroidScore[3];
+    int saucerScore[2];
+
+    // Models, the smaller sizes are scaled from these
+    int shipVertexCount;
+    int asteroidVertexCount;
+    int saucerVertexCount;
+    Vector2 shipVertices[DEFINITION_MAX_VERTICES];
+    Vector2 asteroidVerticesLarge[DEFINITION_MAX_VERTICES];
+    Vector2 saucerDataLarge[DEFINITION_MAX_VERTICES];
+} GameDefinitions;
+
+extern GameDefinitions definitions;
+
+void LoadDefinitions(const char* fileName);
+void WatchDefinitions(void);
+void UnwatchDefinitions(void);
+bool ReloadChangedDefinitions(void);
+
+//----------------------------------------------------------------------------------
+// Text Layout Cache
+//----------------------------------------------------------------------------------
+#define TEXT_LINE_SPACING 30
+#define TEXT_LAYOUT_MAX_GLYPHS 64
+
+// Precalculated glyph quads for one string, dest is relative to the text position
+typedef struct TextLayout {
+    bool valid;
+    unsigned int hash;
+    Texture2D texture;
+    float fontSize;
+    float spacing;
+    char text[TEXT_LAYOUT_MAX_GLYPHS + 1];
+    Vector2 size;
+    int quadCount;
+    Rectangle source[TEXT_LAYOUT_MAX_GLYPHS];
+    Rectangle dest[TEXT_LAYOUT_MAX_GLYPHS];
+} TextLayout;
+
+bool LayoutText(TextLayout* layout, Font font, const char* text, float fontSize, float spacing);
+const TextLayout* GetTextLayout(Font font, const char* text, float fontSize, float spacing);
+void ClearTextLayoutCache(void);
+void DrawTextLayout(const TextLayout* layout, Vector2 position, Color tint);
+void DrawTextCached(Font font, const char* text, Vector2 position, float fontSize, float spacing, Color tint);
+Vector2 MeasureTextCached(Font font, const char* text, float fontSize, float spacing);
+
+//----------------------------------------------------------------------------------
+// Controls
+//----------------------------------------------------------------------------------
+typedef struct ControlLookupEntry {
+    ControlBinding binding;
+    int heldOutput;             // Added while the key or button is down
+    int pressedOutput;          // Added on the frame it gets pressed
+} ControlLookupEntry;
+
+typedef struct ControlLookup {
+    ControlLookupEntry entries[CONTROL_MAX * CONTROL_MAX_BINDINGS];
+    int count;
+    int revision;               // Of the map it was built from
+} ControlLookup;
+
+#define INPUT_MAX_PRESSES 32
+#define INPUT_MAX_GAMEPADS 4
+#define INPUT_AXIS_THRESHOLD 0.5f
+
+typedef struct InputPress {
+    double time;                // GetTime() of the sample that saw it
+    int output;
+} InputPress;
+
+// Input between the samples and the steps, oldest presses first
+typedef struct InputState {
+    bool down[CONTROL_MAX * CONTROL_MAX_BINDINGS];  // Per lookup entry at the last sample
+    int held;
+    InputPress presses[INPUT_MAX_PRESSES];
+    int pressCount;
+    int revision;               // Of the lookup the state belongs to
+} InputState;
+
+void SetDefaultControls(ControlMap* map);
+void LoadControlMap(const char* fileName, ControlMap* map);
+bool WriteControlMap(const char* fileName, const ControlMap* map);
+int GetControlKey(const ControlMap* map, int control);
+void SetControlKey(ControlMap* map, int control, int key);
+void BuildControlLookup(ControlLookup* lookup, const ControlMap* map, const int outputs[CONTROL_MAX], int pressedControls);
+void SampleInput(InputState* state, const ControlLookup* lookup, double time);
+int TakeStepInput(InputState* state);
+void ReportInputLatency(void);
+
+//----------------------------------------------------------------------------------
+// Gamepads
+//----------------------------------------------------------------------------------
+void LoadGamepadMappings(const char* fileName);
+void UnloadGamepadMappings(void);
+void UpdateGamepads(void);
+
+//----------------------------------------------------------------------------------
+// Audio Mixer
+//----------------------------------------------------------------------------------
+void InitAudioMixer(Sound sounds[], int soundCount);
+void UnloadAudioMixer(void);
+void UpdateAudioMixer(void);
+void PlayEffect(int effect);
+void StartLoopingEffect(int effect);
+void StopLoopingEffect(int effect);
+void StopAllEffects(void);
+int GetDroppedEffects(void);
+
+//----------------------------------------------------------------------------------
+// Spectator Stream
+//----------------------------------------------------------------------------------
+typedef struct SpectatorStream SpectatorStream;
+typedef struct SpectatorViewer SpectatorViewer;
+
+SpectatorStream* OpenSpectatorFile(const char* fileName);
+SpectatorStream* OpenSpectatorSocket(int localPort, const char* host, int remotePort);
+void CloseSpectatorStream(SpectatorStream* stream);
+void WriteSpectatorFrame(SpectatorStream* stream, const World* world);
+float GetSpectatorBytesPerSecond(const SpectatorStream* stream);
+void SetGameplaySpectatorStream(SpectatorStream* stream);
+
+SpectatorViewer* CreateSpectatorViewer(void);
+void DestroySpectatorViewer(SpectatorViewer* viewer);
+bool ReadSpectatorFrame(SpectatorViewer* viewer, const unsigned char* data, int size, unsigned int* ackTick);
+int GetSpectatorObjects(const SpectatorViewer* viewer, ObjectView* views, int maxViews);
+
+//----------------------------------------------------------------------------------
+// Network (UDP)
+//----------------------------------------------------------------------------------
+int OpenUdpSocket(int port);
+bool SendUdp(int socket, const char* host, int port, const void* data, int size);
+int ReceiveUdp(int socket, void* data, int size);
+int ReceiveUdpFrom(int socket, void* data, int size, char* host, int hostSize, int* port);
+void CloseUdpSocket(int socket);
+
+typedef int (*HttpTextCallback)(char* text, int size);
+bool StartHttpTextServer(int port, HttpTextCallback callback);
+void StopHttpTextServer(void);
+
+//----------------------------------------------------------------------------------
+// Game Log, for the hot paths, formatted on a background thread
+//----------------------------------------------------------------------------------
+#define LOG_MAX_ARGS 4
+
+// Messages below this level are removed at compile time, release builds drop the debug ones.
+// A number as the preprocessor can't see the TraceLogLevel values, 2 is LOG_DEBUG, 3 LOG_INFO
+#ifndef GAME_LOG_LEVEL
+    #if defined(NDEBUG)
+        #define GAME_LOG_LEVEL 3
+    #else
+        #define GAME_LOG_LEVEL 2
+    #endif
+#endif
+
+// One per call site, also holds its rate limit. The counters are shared by every
+// thread logging from the site and only used through atomics
+typedef struct LogSite {
+    const char* format;
+    int level;
+    long second;
+    long count;
+    long suppressed;
+} LogSite;
+
+void InitGameLog(void);
+void CloseGameLog(void);
+void PushGameLog(LogSite* site, const double* args, int argCount);
+
+// Arguments have to be numbers, at most LOG_MAX_ARGS of them
+#define GAME_LOG(level, format, ...) do { \
+        static LogSite logSite = { format, level, 0, 0, 0 }; \
+        double logArgs[] = { 0, ##__VA_ARGS__ }; \
+        PushGameLog(&logSite, logArgs + 1, (int)(sizeof(logArgs) / sizeof(logArgs[0])) - 1); \
+    } while (0)
+
+#if GAME_LOG_LEVEL <= 2
+    #define GAME_LOG_DEBUG(...) GAME_LOG(LOG_DEBUG, __VA_ARGS__)
+#else
+    #define GAME_LOG_DEBUG(...) do { } while (0)
+#endif
+#if GAME_LOG_LEVEL <= 3
+    #define GAME_LOG_INFO(...) GAME_LOG(LOG_INFO, __VA_ARGS__)
+#else
+    #define GAME_LOG_INFO(...) do { } while (0)
+#endif
+#define GAME_LOG_WARNING(...) GAME_LOG(LOG_WARNING, __VA_ARGS__)
+#define GAME_LOG_ERROR(...) GAME_LOG(LOG_ERROR, __VA_ARGS__)
+
+//----------------------------------------------------------------------------------
+// Telemetry
+//----------------------------------------------------------------------------------
+typedef enum TelemetryMetric {
+    TELEMETRY_TICKS,
+    TELEMETRY_TICK_TIME,            // Microseconds
+    TELEMETRY_FRAMES,
+    TELEMETRY_FRAME_TIME,           // Microseconds
+    TELEMETRY_DRAW_CALLS,
+    TELEMETRY_OBJECTS,              // Gauges of the pools, in this order
+    TELEMETRY_PARTICLES,
+    TELEMETRY_BULLETS,
+    TELEMETRY_ASTEROIDS,
+    TELEMETRY_OBJECTS_MAX,          // High-water marks of the same pools
+    TELEMETRY_PARTICLES_MAX,
+    TELEMETRY_BULLETS_MAX,
+    TELEMETRY_ASTEROIDS_MAX,
+    TELEMETRY_DROPPED_BULLETS,
+    TELEMETRY_DROPPED_PARTICLES,
+    TELEMETRY_INPUT_PRESSES,
+    TELEMETRY_INPUT_LATENCY,
+    TELEMETRY_METRIC_COUNT
+} TelemetryMetric;
+
+#define TELEMETRY_POOL_COUNT 4
+
+typedef struct TelemetrySnapshot {
+    long long values[TELEMETRY_METRIC_COUNT];
+    int threads;
+} TelemetrySnapshot;
+
+void AddTelemetry(TelemetryMetric metric, long long amount);
+void SetTelemetry(TelemetryMetric metric, long long amount);
+void MaxTelemetry(TelemetryMetric metric, long long amount);
+TelemetrySnapshot GetTelemetrySnapshot(void);
+int FormatTelemetry(const TelemetrySnapshot* snapshot, char* text, int size);
+bool StartTelemetryEndpoint(int port);
+void StopTelemetryEndpoint(void);
+
+//----------------------------------------------------------------------------------
+// Session Log, one record per finished game for balancing
+//----------------------------------------------------------------------------------
+#define SESSION_LOG_MAGIC 0x53455352    // "RSES"
+#define SESSION_LOG_VERSION 1
+#define SESSION_DEATH_CAUSES 4
+
+// Starts the file, followed by records that each have an unsigned int length in front
+typedef struct SessionLogHeader {
+    unsigned int magic;
+    unsigned int version;
+} SessionLogHeader;
+
+// One player of one finished game
+typedef struct SessionRecord {
+    long long endTime;                  // Unix time the game ended
+    int score;
+    int level;                          // Level reached
+    float duration;                     // Seconds played
+    int shotsFired;
+    int hits;                           // Asteroids, saucers and ships shot
+    int deaths[SESSION_DEATH_CAUSES];   // Asteroid, saucer, saucer bullet, other ship
+    int hyperspaceJumps;
+    unsigned char playerCount;          // 2 for versus
+    unsigned char player;
+    unsigned char padding[2];
+} SessionRecord;
+
+bool OpenSessionLog(const char* fileName);
+void CloseSessionLog(void);
+void AppendSessionRecord(const SessionRecord* record);
+int GetWorldSessionRecords(const World* world, SessionRecord records[MAX_PLAYERS]);
 
-void LoadControlMap(const char* fileName, int map[], int maxEntries);
-void WriteControlMap(const char* fileName, int map[], int maxEntries);
+//----------------------------------------------------------------------------------
+// Time Travel Debugger
+//----------------------------------------------------------------------------------
+void InitTimeTravel(void);
+void CloseTimeTravel(void);
+void ResetTimeTravel(void);
+void StepGameplayRecorded(const int inputs[MAX_PLAYERS], float dt);
+bool UpdateTimeTravel(void);
+void DrawTimeTravel(void);
+
+//----------------------------------------------------------------------------------
+// Replays, the seed and the inputs of a game
+//----------------------------------------------------------------------------------
+#define REPLAY_MAGIC 0x4c505252         // "RRPL"
+#define REPLAY_VERSION 1
+
+// Starts the file, followed by stepCount steps
+typedef struct ReplayHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int seed;
+    int playerCount;
+    int stepCount;
+} ReplayHeader;
+
+typedef struct ReplayStep {
+    float dt;
+    unsigned char inputs[MAX_PLAYERS];  // ACTION_ bits of each player
+    unsigned char padding[2];
+} ReplayStep;
+
+typedef struct Replay {
+    unsigned int seed;
+    int playerCount;
+    int stepCount;
+    ReplayStep* steps;
+} Replay;
+
+void SetReplayRecordingFile(const char* fileName);
+void BeginReplayRecording(unsigned int seed, int playerCount);
+void RecordReplayStep(const int inputs[MAX_PLAYERS], float dt);
+void RewindReplayRecording(int steps);
+void DropReplayRecording(void);
+void EndReplayRecording(void);
+void CloseReplayRecording(void);
+bool LoadReplay(const char* fileName, Replay* replay);
+void UnloadReplay(Replay* replay);
+
+//----------------------------------------------------------------------------------
+// Netplay
+//----------------------------------------------------------------------------------
+typedef struct NetplayStats {
+    int ping;               // Round trip in ms
+    int rollbackFrames;     // Steps simulated again in the last rollback
+    float resimulateMs;     // Time the last rollback took
+    int rollbacks;
+    int stalls;             // Frames spent waiting for the other side
+} NetplayStats;
+
+bool InitNetplay(int localPlayer, int localPort, const char* host, int remotePort);
+void CloseNetplay(void);
+void UpdateNetplay(int localInput);
+bool IsNetplayActive(void);
+bool IsNetplayWaiting(void);
+int GetNetplayLocalPlayer(void);
+unsigned int GetNetplaySeed(void);
+NetplayStats GetNetplayStats(void);
+
+//----------------------------------------------------------------------------------
+// View
+//----------------------------------------------------------------------------------
+void InitView(const char* title, int renderHeight, bool fullscreen);
+void UnloadView(void);
+void BeginView(void);
+void EndView(void);
+
+//----------------------------------------------------------------------------------
+// Canvas, raylib or the software rasterizer
+//----------------------------------------------------------------------------------
+#define RASTER_TILE 4               // Pixels on each side of a tile
+
+typedef struct Raster {
+    Color* pixels;              // R8G8B8A8, row by row
+    int width;
+    int height;
+    unsigned char* tiles;       // Row by row, 1 where anything but black may have been drawn
+    int tileWidth;
+} Raster;
+
+Raster LoadRaster(int width, int height);
+void UnloadRaster(Raster* raster);
+void ClearRaster(Raster* raster, Color color);
+bool ExportRaster(const Raster* raster, const char* fileName);
+void SetCanvasRaster(Raster* raster);
+Font LoadRasterFont(const char* fileName, int fontSize);
+void UnloadRasterFont(Font font);
+
+void CanvasLine(Vector2 start, Vector2 end, Color color);
+void CanvasLineStrip(const Vector2* points, int pointCount, Color color);
+void CanvasCircle(int centerX, int centerY, float radius, Color color);
+void CanvasCircleLines(int centerX, int centerY, float radius, Color color);
+void CanvasRectangleLines(int posX, int posY, int width, int height, Color color);
+void CanvasTexture(Texture2D texture, Rectangle source, Rectangle dest, Color tint);
+void CanvasText(Font font, const char* text, Vector2 position, float fontSize, float spacing, Color tint);
+
+//----------------------------------------------------------------------------------
+// Glow, phosphor persistence and bloom
+//----------------------------------------------------------------------------------
+void SetGlowEnabled(bool enabled);
+bool IsGlowEnabled(void);
+void DrawGlow(Texture2D scene, Rectangle dest, float dt);
+void ApplyRasterGlow(Raster* raster, float dt);
+void UnloadGlow(void);
 
 #ifdef __cplusplus
 }
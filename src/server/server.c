@@ -0,0 +1,329 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Headless server, runs many independent games in one process
+*
+*   Every session is a world of its own. Sessions are split over worker threads and each
+*   worker steps all of its sessions at 60 Hz. Clients send their input as a bitmask for
+*   a session and get the encoded state of that session back after every step. Once a
+*   second the time spent stepping gets reported, as sessions per core that fit into
+*   the tick budget.
+*
+*   usage: rasteroids_server [sessions] [threads] [port] [seconds] [metrics port] [session log]
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Shared Variables Definition (global)
+// NOTE: The gameplay module links against these, the server doesn't use them
+//----------------------------------------------------------------------------------
+GameScreen currentScreen = SCREEN_GAMEPLAY;
+Font smallFont = { 0 };
+Font largeFont = { 0 };
+Sound sounds[SOUND_MAX] = { 0 };
+ControlMap controlMap = { 0 };
+int lastGameScore = 0;
+HighscoreTable highscores = { 0 };
+
+//----------------------------------------------------------------------------------
+// Server Definition
+//----------------------------------------------------------------------------------
+#define SERVER_TICK_RATE 60
+#define SERVER_WIDTH 1024               // Playfield of every session
+#define SERVER_HEIGHT 768
+#define SERVER_MAGIC 0x56525352         // 'RSRV'
+#define STATE_PACKET_SIZE 2048
+
+// Client to server, the input for one session
+typedef struct InputMessage {
+    unsigned int magic;
+    int session;
+    int input;
+} InputMessage;
+
+// Server to client, followed by the output of EncodeWorldState()
+typedef struct StateHeader {
+    unsigned int magic;
+    int session;
+    unsigned int tick;
+} StateHeader;
+
+typedef struct Session {
+    World* world;
+    unsigned int tick;
+    unsigned int seed;
+    int input;              // Latest input of the client
+    bool hasClient;         // Only sessions with a client send their state
+    char host[64];
+    int port;
+} Session;
+
+typedef struct Worker {
+    pthread_t thread;
+    pthread_mutex_t lock;   // Guards the client data of its sessions and the timings
+    int index;
+    double stepTime;        // Time spent stepping since the last report
+    double maxTickTime;
+    int ticks;
+} Worker;
+
+static Session* sessions = NULL;
+static int sessionCount = 1000;
+static Worker* workers = NULL;
+static int workerCount = 1;
+static int serverSocket = -1;
+
+static volatile sig_atomic_t running = 1;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void SleepUntil(double time)
+{
+    double wait = time - GetSeconds();
+    if (wait <= 0) return;
+    struct timespec duration = { (time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9) };
+    nanosleep(&duration, NULL);
+}
+
+static void StopServer(int signal)
+{
+    running = 0;
+}
+
+// Session i belongs to worker i % workerCount
+static Worker* GetSessionWorker(int session)
+{
+    return &workers[session % workerCount];
+}
+
+static void StepSession(Session* session, Worker* worker, unsigned char* packet)
+{
+    pthread_mutex_lock(&worker->lock);
+    int inputs[MAX_PLAYERS] = { session->input };
+    bool hasClient = session->hasClient;
+    char host[64];
+    int port = session->port;
+    if (hasClient) memcpy(host, session->host, sizeof(host));
+    pthread_mutex_unlock(&worker->lock);
+
+    StepWorld(session->world, inputs, 1.0f / SERVER_TICK_RATE);
+    ++session->tick;
+
+    // Finished games start over right away, the ones with a client go into the session log.
+    // Without memory for the next game the finished one stays and the next tick tries again
+    if (IsWorldFinished(session->world)) {
+        unsigned int seed = session->seed * 1664525u + 1013904223u;
+        World* next = CreateWorld(1, seed, SERVER_WIDTH, SERVER_HEIGHT);
+        if (next == NULL) {
+            GAME_LOG_WARNING("SERVER: Out of memory, session %i can't start a new game", (int)(session - sessions));
+        }
+        else {
+            if (hasClient) {
+                SessionRecord records[MAX_PLAYERS];
+                int count = GetWorldSessionRecords(session->world, records);
+                for (int p = 0; p < count; ++p) AppendSessionRecord(&records[p]);
+            }
+            DestroyWorld(session->world);
+            session->seed = seed;
+            session->world = next;
+            session->tick = 0;
+        }
+    }
+
+    if (hasClient) {
+        StateHeader header = { SERVER_MAGIC, (int)(session - sessions), session->tick };
+        memcpy(packet, &header, sizeof(header));
+        int size = EncodeWorldState(session->world, packet + sizeof(header), STATE_PACKET_SIZE - sizeof(header));
+        if (size > 0) SendUdp(serverSocket, host, port, packet, sizeof(header) + size);
+    }
+}
+
+static void* RunWorker(void* data)
+{
+    Worker* worker = (Worker*)data;
+    unsigned char packet[STATE_PACKET_SIZE];
+    double tickTime = 1.0 / SERVER_TICK_RATE;
+    double nextTick = GetSeconds();
+
+    while (running) {
+        double start = GetSeconds();
+        int stepped = 0;
+        for (int i = worker->index; i < sessionCount; i += workerCount) {
+            StepSession(&sessions[i], worker, packet);
+            ++stepped;
+        }
+        double used = GetSeconds() - start;
+        AddTelemetry(TELEMETRY_TICKS, stepped);
+        AddTelemetry(TELEMETRY_TICK_TIME, (long long)(used * 1e6));
+
+        pthread_mutex_lock(&worker->lock);
+        worker->stepTime += used;
+        if (used > worker->maxTickTime) worker->maxTickTime = used;
+        ++worker->ticks;
+        pthread_mutex_unlock(&worker->lock);
+
+        // Ticks that can't be made up are dropped instead of running in a burst
+        nextTick += tickTime;
+        if (nextTick < GetSeconds() - tickTime) nextTick = GetSeconds();
+        SleepUntil(nextTick);
+    }
+
+    return NULL;
+}
+
+// Reads all waiting input messages and hands them to the sessions
+static void ReceiveInputs(void)
+{
+    InputMessage message;
+    char host[64];
+    int port = 0;
+    while (ReceiveUdpFrom(serverSocket, &message, sizeof(message), host, sizeof(host), &port) == sizeof(message)) {
+        if (message.magic != SERVER_MAGIC) continue;
+        if (message.session < 0 || message.session >= sessionCount) continue;
+
+        Session* session = &sessions[message.session];
+        Worker* worker = GetSessionWorker(message.session);
+        pthread_mutex_lock(&worker->lock);
+        session->input = message.input;
+        session->hasClient = true;
+        memcpy(session->host, host, sizeof(session->host));
+        session->port = port;
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+static void ReportTimings(void)
+{
+    double budget = 1.0 / SERVER_TICK_RATE;
+    double totalStep = 0;
+    double maxTick = 0;
+    int totalTicks = 0;
+    for (int w = 0; w < workerCount; ++w) {
+        Worker* worker = &workers[w];
+        pthread_mutex_lock(&worker->lock);
+        totalStep += worker->stepTime;
+        totalTicks += worker->ticks;
+        if (worker->maxTickTime > maxTick) maxTick = worker->maxTickTime;
+        worker->stepTime = 0;
+        worker->maxTickTime = 0;
+        worker->ticks = 0;
+        pthread_mutex_unlock(&worker->lock);
+    }
+    if (totalTicks == 0) return;
+
+    // Average time of one session step, and how many of those fit into one tick
+    double sessionsPerTick = (double)sessionCount / workerCount;
+    double sessionStep = (totalStep / totalTicks) / sessionsPerTick;
+    printf("%i sessions on %i threads, %.2f us per session step, max tick %.2f ms, %i sessions per core at %i Hz\n",
+        sessionCount, workerCount, sessionStep * 1e6, maxTick * 1000.0, (int)(budget / sessionStep), SERVER_TICK_RATE);
+}
+
+//----------------------------------------------------------------------------------
+// Main entry point
+//----------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    int port = 7100;
+    double duration = 0;       // Run until interrupted
+    int metricsPort = 0;
+    const char* sessionLogFile = NULL;
+    workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc > 1) sessionCount = atoi(argv[1]);
+    if (argc > 2) workerCount = atoi(argv[2]);
+    if (argc > 3) port = atoi(argv[3]);
+    if (argc > 4) duration = atof(argv[4]);
+    if (argc > 5) metricsPort = atoi(argv[5]);
+    if (argc > 6) sessionLogFile = argv[6];
+    if (sessionCount < 1) sessionCount = 1;
+    if (workerCount < 1) workerCount = 1;
+
+    // Only keep warnings and errors of the games
+    SetTraceLogLevel(LOG_WARNING);
+    InitGameLog();
+    LoadDefinitions("resources/definitions.txt");
+    if (sessionLogFile != NULL) OpenSessionLog(sessionLogFile);
+
+    signal(SIGINT, StopServer);
+    signal(SIGTERM, StopServer);
+
+    serverSocket = OpenUdpSocket(port);
+    if (serverSocket < 0) {
+        TraceLog(LOG_ERROR, "SERVER: Could not open port %i", port);
+        return 1;
+    }
+
+    // All worlds get created before the workers start
+    sessions = (Session*)RL_CALLOC(sessionCount, sizeof(Session));
+    for (int i = 0; i < sessionCount; ++i) {
+        sessions[i].seed = (unsigned int)i * 2654435761u + 1u;
+        sessions[i].world = CreateWorld(1, sessions[i].seed, SERVER_WIDTH, SERVER_HEIGHT);
+        if (sessions[i].world == NULL) {
+            TraceLog(LOG_ERROR, "SERVER: Out of memory after %i sessions", i);
+            sessionCount = i;
+            break;
+        }
+    }
+
+    workers = (Worker*)RL_CALLOC(workerCount, sizeof(Worker));
+    for (int w = 0; w < workerCount; ++w) {
+        workers[w].index = w;
+        pthread_mutex_init(&workers[w].lock, NULL);
+        pthread_create(&workers[w].thread, NULL, RunWorker, &workers[w]);
+    }
+
+    if (metricsPort > 0) StartTelemetryEndpoint(metricsPort);
+    printf("Running %i sessions on %i threads, port %i\n", sessionCount, workerCount, port);
+
+    double start = GetSeconds();
+    double nextReport = start + 1.0;
+    while (running) {
+        ReceiveInputs();
+
+        if (GetSeconds() >= nextReport) {
+            ReportTimings();
+            fflush(stdout);
+            nextReport += 1.0;
+        }
+        if (duration > 0 && GetSeconds() - start >= duration) running = 0;
+
+        SleepUntil(GetSeconds() + 0.001);
+    }
+
+    for (int w = 0; w < workerCount; ++w) {
+        pthread_join(workers[w].thread, NULL);
+        pthread_mutex_destroy(&workers[w].lock);
+    }
+
+    for (int i = 0; i < sessionCount; ++i) {
+        DestroyWorld(sessions[i].world);
+    }
+    RL_FREE(sessions);
+    RL_FREE(workers);
+    CloseUdpSocket(serverSocket);
+    StopTelemetryEndpoint();
+    CloseSessionLog();
+    CloseGameLog();
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Session log, one binary record per finished game, for balancing
+*
+*   The file only ever grows: a SessionLogHeader when it is created, then every record
+*   with its length in front, so readers can skip records of a newer, longer layout and
+*   a record cut off by a crash only loses the end of the file. Appending copies the
+*   record into a batch in memory, a background thread writes and flushes the batch a
+*   few times a second, the game never waits for the disk. Records that don't fit into
+*   the batch get dropped and counted. Without the thread (web) the batch is written
+*   when it is full and when the log gets closed.
+*
+*   tools/sessions.c reads and aggregates the files.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(PLATFORM_WEB)
+    // No background thread
+#elif defined(_WIN32)
+    // windows.h doesn't mix with raylib.h, the few functions needed are declared here
+    #include <process.h>
+    #include <intrin.h>
+    __declspec(dllimport) void __stdcall Sleep(unsigned long msTimeout);
+    __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void* handle, unsigned long msTimeout);
+    __declspec(dllimport) int __stdcall CloseHandle(void* handle);
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Session Log Definition
+//----------------------------------------------------------------------------------
+#define SESSION_BATCH_SIZE (256 * (sizeof(unsigned int) + sizeof(SessionRecord)))
+#define SESSION_FLUSH_MS 250
+
+// Only guards the batch while a record gets copied in or the batches get swapped
+#if defined(_MSC_VER)
+    #define SessionLock(lock) while (_InterlockedExchange((volatile long*)(lock), 1) != 0) { }
+    #define SessionUnlock(lock) _InterlockedExchange((volatile long*)(lock), 0)
+#else
+    #define SessionLock(lock) while (__atomic_exchange_n((lock), 1, __ATOMIC_ACQUIRE) != 0) { }
+    #define SessionUnlock(lock) __atomic_store_n((lock), 0, __ATOMIC_RELEASE)
+#endif
+
+typedef struct SessionBatch {
+    unsigned char data[SESSION_BATCH_SIZE];
+    int size;
+} SessionBatch;
+
+typedef struct SessionLog {
+    FILE* file;
+    SessionBatch batches[2];
+    int filling;                // Batch records get appended to, the other one is written
+    long lock;
+    int dropped;                // Records that didn't fit into the batch
+    volatile int running;
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+    void* thread;
+#else
+    pthread_t thread;
+#endif
+} SessionLog;
+
+static SessionLog sessionLog = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+// Swaps the batches and writes out what was appended so far, only one thread may do
+// this at a time
+static void FlushSessionLog(void)
+{
+    SessionLock(&sessionLog.lock);
+    SessionBatch* batch = &sessionLog.batches[sessionLog.filling];
+    sessionLog.filling = 1 - sessionLog.filling;
+    int dropped = sessionLog.dropped;
+    sessionLog.dropped = 0;
+    SessionUnlock(&sessionLog.lock);
+
+    if (batch->size > 0) {
+        if (fwrite(batch->data, 1, batch->size, sessionLog.file) != (size_t)batch->size) {
+            TraceLog(LOG_WARNING, "SESSION: Could not write to the session log");
+        }
+        fflush(sessionLog.file);
+        batch->size = 0;
+    }
+    if (dropped > 0) TraceLog(LOG_WARNING, "SESSION: %i records dropped, the batch was full", dropped);
+}
+
+#if !defined(PLATFORM_WEB)
+#if defined(_WIN32)
+static unsigned __stdcall RunSessionLog(void* data)
+#else
+static void* RunSessionLog(void* data)
+#endif
+{
+    while (sessionLog.running) {
+        FlushSessionLog();
+#if defined(_WIN32)
+        Sleep(SESSION_FLUSH_MS);
+#else
+        usleep(SESSION_FLUSH_MS * 1000);
+#endif
+    }
+    return 0;
+}
+#endif
+
+//----------------------------------------------------------------------------------
+// Session Log Functions
+//----------------------------------------------------------------------------------
+
+// Opens the file for appending, a new file gets its header first
+bool OpenSessionLog(const char* fileName)
+{
+    if (sessionLog.file != NULL) CloseSessionLog();
+
+    sessionLog.file = fopen(fileName, "ab");
+    if (sessionLog.file == NULL) {
+        TraceLog(LOG_WARNING, "SESSION: Could not open %s", fileName);
+        return false;
+    }
+    fseek(sessionLog.file, 0, SEEK_END);
+    if (ftell(sessionLog.file) == 0) {
+        SessionLogHeader header = { SESSION_LOG_MAGIC, SESSION_LOG_VERSION };
+        fwrite(&header, sizeof(header), 1, sessionLog.file);
+        fflush(sessionLog.file);
+    }
+    sessionLog.batches[0].size = 0;
+    sessionLog.batches[1].size = 0;
+    sessionLog.filling = 0;
+    sessionLog.dropped = 0;
+
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+    sessionLog.running = 1;
+    sessionLog.thread = (void*)_beginthreadex(NULL, 0, RunSessionLog, NULL, 0, NULL);
+    if (sessionLog.thread == NULL) sessionLog.running = 0;
+#else
+    sessionLog.running = 1;
+    if (pthread_create(&sessionLog.thread, NULL, RunSessionLog, NULL) != 0) sessionLog.running = 0;
+#endif
+
+    TraceLog(LOG_INFO, "SESSION: Appending finished games to %s", fileName);
+    return true;
+}
+
+// Stops the thread and writes out the last records
+void CloseSessionLog(void)
+{
+    if (sessionLog.file == NULL) return;
+    if (sessionLog.running) {
+        sessionLog.running = 0;
+#if defined(PLATFORM_WEB)
+#elif defined(_WIN32)
+        WaitForSingleObject(sessionLog.thread, 0xFFFFFFFF);
+        CloseHandle(sessionLog.thread);
+#else
+        pthread_join(sessionLog.thread, NULL);
+#endif
+    }
+    FlushSessionLog();
+    fclose(sessionLog.file);
+    sessionLog.file = NULL;
+}
+
+// Copies the record into the batch, safe to call from any thread, does nothing while
+// the log isn't open
+void AppendSessionRecord(const SessionRecord* record)
+{
+    if (sessionLog.file == NULL) return;
+
+    unsigned int length = sizeof(SessionRecord);
+    SessionLock(&sessionLog.lock);
+    SessionBatch* batch = &sessionLog.batches[sessionLog.filling];
+    bool fits = batch->size + sizeof(length) + length <= SESSION_BATCH_SIZE;
+    if (fits) {
+        memcpy(batch->data + batch->size, &length, sizeof(length));
+        memcpy(batch->data + batch->size + sizeof(length), record, length);
+        batch->size += sizeof(length) + length;
+    }
+    else if (sessionLog.running) ++sessionLog.dropped;
+    SessionUnlock(&sessionLog.lock);
+
+    // Without the thread a full batch gets written right here
+    if (!fits && !sessionLog.running) {
+        FlushSessionLog();
+        AppendSessionRecord(record);
+    }
+}
@@ -0,0 +1,455 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Spectator Stream, delta compressed world state for viewers
+*
+*   Objects are sent with their motion: position in whole pixels, velocity in 1/64 pixels
+*   per tick, rotation in 1/256 turns and its change per tick. The viewer moves objects
+*   along on its own, an object only gets sent again when that prediction is off by more
+*   than a pixel (or a rotation step), when it appears or when it goes away. As asteroids
+*   and bullets fly in straight lines most ticks only carry the header.
+*
+*   Every frame is a delta against the last frame the viewer acknowledged. Frames written
+*   to a file count as acknowledged right away, over UDP the viewer sends back the tick
+*   of each frame it read. Without a usable base a key frame is sent.
+*
+*   Frame: u16 tick, u8 ticks since base (0 for a key frame), u16 entry count (bit 15: status follows)
+*       status: u8 state, u8 level, u8 lives, u32 score, u16 width, u16 height
+*       entry:  u16 slot (bit 15: removed), then unless removed
+*               u8 model, u16 x, u16 y, i16 vx, i16 vy, u8 rot, i8 rotVel
+*   In files every frame is preceded by its size as u16. Values are little endian.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------------
+// Stream Definition
+//----------------------------------------------------------------------------------
+#define SPECTATE_MAX_OBJECTS 256
+#define SPECTATE_HISTORY 64                 // Frames kept to delta against, in ticks
+#define SPECTATE_MAX_FRAME (5 + 11 + SPECTATE_MAX_OBJECTS * 13)
+#define SPECTATE_TICK_RATE 60.0f
+#define SPECTATE_ACK_MAGIC 0x4b434153       // 'SACK'
+
+// An object as the viewer knows it, the motion it was last sent with
+typedef struct SpectatorObject {
+    bool active;
+    unsigned char model;
+    unsigned char rot;          // 1/256 turns
+    signed char rotVel;         // 1/2048 turns per tick
+    unsigned short x;           // Pixels
+    unsigned short y;
+    short vx;                   // 1/64 pixels per tick
+    short vy;
+    unsigned int tick;          // Tick the motion is from
+} SpectatorObject;
+
+typedef struct SpectatorStatus {
+    unsigned char state;
+    unsigned char level;
+    unsigned char lives;
+    int score;
+    unsigned short width;
+    unsigned short height;
+} SpectatorStatus;
+
+// Everything the viewer knows after reading the frame for tick
+typedef struct SpectatorFrame {
+    bool valid;
+    unsigned int tick;
+    SpectatorStatus status;
+    SpectatorObject objects[SPECTATE_MAX_OBJECTS];
+} SpectatorFrame;
+
+typedef struct SpectatorAck {
+    unsigned int magic;
+    unsigned int tick;
+} SpectatorAck;
+
+struct SpectatorStream {
+    FILE* file;
+    int socket;
+    char host[64];
+    int port;
+
+    unsigned int tick;
+    bool acked;
+    unsigned int ackTick;
+    SpectatorFrame history[SPECTATE_HISTORY];
+
+    // Object state of the previous tick, to measure how objects actually move
+    ObjectView previous[SPECTATE_MAX_OBJECTS];
+    ObjectView views[SPECTATE_MAX_OBJECTS];
+
+    unsigned int bytes;
+    unsigned int frames;
+};
+
+struct SpectatorViewer {
+    bool started;
+    unsigned int tick;
+    SpectatorFrame history[SPECTATE_HISTORY];
+};
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static float WrapValue(float value, float max)
+{
+    if (max <= 0) return value;
+    value = fmodf(value, max);
+    return (value < 0) ? value + max : value;
+}
+
+// Shortest distance from a to b on a wrapping axis
+static float WrapDelta(float a, float b, float max)
+{
+    float d = b - a;
+    if (max <= 0) return d;
+    if (d > max / 2) d -= max;
+    else if (d < -max / 2) d += max;
+    return d;
+}
+
+static int ClampInt(int value, int min, int max)
+{
+    return (value < min) ? min : (value > max) ? max : value;
+}
+
+// Where the viewer will show the object at tick
+static void PredictObject(const SpectatorObject* obj, unsigned int tick, const SpectatorStatus* status, Vector2* position, float* rot)
+{
+    float elapsed = (float)(tick - obj->tick);
+    position->x = WrapValue(obj->x + obj->vx * elapsed / 64.0f, status->width);
+    position->y = WrapValue(obj->y + obj->vy * elapsed / 64.0f, status->height);
+    *rot = WrapValue(obj->rot + obj->rotVel * elapsed / 8.0f, 256.0f);
+}
+
+static int WriteU16(unsigned char* data, int at, unsigned int value)
+{
+    data[at] = (unsigned char)(value & 0xff);
+    data[at + 1] = (unsigned char)((value >> 8) & 0xff);
+    return at + 2;
+}
+
+static unsigned int ReadU16(const unsigned char* data, int at)
+{
+    return (unsigned int)data[at] | ((unsigned int)data[at + 1] << 8);
+}
+
+static bool IsStatusEqual(const SpectatorStatus* a, const SpectatorStatus* b)
+{
+    return a->state == b->state && a->level == b->level && a->lives == b->lives &&
+        a->score == b->score && a->width == b->width && a->height == b->height;
+}
+
+// Quantizes the view of an object into what gets sent, motion is taken from how far
+// the object actually moved since the last tick, that also covers turning and the
+// variable frame time of the game
+static SpectatorObject QuantizeObject(const ObjectView* view, const ObjectView* previous, unsigned int tick, const SpectatorStatus* status)
+{
+    Vector2 velocity = { view->velocity.x / SPECTATE_TICK_RATE, view->velocity.y / SPECTATE_TICK_RATE };
+    float rotVel = view->rotVel / SPECTATE_TICK_RATE;
+    if (previous->active && previous->model == view->model) {
+        velocity.x = WrapDelta(previous->position.x, view->position.x, status->width);
+        velocity.y = WrapDelta(previous->position.y, view->position.y, status->height);
+        rotVel = WrapDelta(previous->rot, view->rot, 360.0f);
+    }
+
+    SpectatorObject obj = { .active = true, .model = (unsigned char)view->model, .tick = tick };
+    obj.x = (unsigned short)ClampInt((int)roundf(view->position.x), 0, 0xffff);
+    obj.y = (unsigned short)ClampInt((int)roundf(view->position.y), 0, 0xffff);
+    obj.vx = (short)ClampInt((int)roundf(velocity.x * 64.0f), -32768, 32767);
+    obj.vy = (short)ClampInt((int)roundf(velocity.y * 64.0f), -32768, 32767);
+    obj.rot = (unsigned char)((int)roundf(WrapValue(view->rot, 360.0f) * 256.0f / 360.0f) & 0xff);
+    obj.rotVel = (signed char)ClampInt((int)roundf(rotVel * 2048.0f / 360.0f), -128, 127);
+    return obj;
+}
+
+// An object needs to be sent again when the viewer would show it in the wrong place
+static bool IsObjectOff(const SpectatorObject* known, const ObjectView* view, unsigned int tick, const SpectatorStatus* status)
+{
+    if (!known->active || known->model != view->model) return true;
+
+    Vector2 position;
+    float rot;
+    PredictObject(known, tick, status, &position, &rot);
+    if (fabsf(WrapDelta(position.x, view->position.x, status->width)) > 1.0f) return true;
+    if (fabsf(WrapDelta(position.y, view->position.y, status->height)) > 1.0f) return true;
+    return fabsf(WrapDelta(rot, WrapValue(view->rot, 360.0f) * 256.0f / 360.0f, 256.0f)) > 1.0f;
+}
+
+static void ReceiveAcks(SpectatorStream* stream)
+{
+    SpectatorAck ack;
+    while (ReceiveUdp(stream->socket, &ack, sizeof(ack)) == sizeof(ack)) {
+        if (ack.magic != SPECTATE_ACK_MAGIC || ack.tick > stream->tick) continue;
+        if (!stream->acked || ack.tick > stream->ackTick) {
+            stream->ackTick = ack.tick;
+            stream->acked = true;
+        }
+    }
+}
+
+static SpectatorStream* CreateStream(void)
+{
+    SpectatorStream* stream = (SpectatorStream*)RL_CALLOC(1, sizeof(SpectatorStream));
+    if (stream != NULL) stream->socket = -1;
+    return stream;
+}
+
+//----------------------------------------------------------------------------------
+// Stream Functions
+//----------------------------------------------------------------------------------
+
+SpectatorStream* OpenSpectatorFile(const char* fileName)
+{
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL) {
+        TraceLog(LOG_WARNING, "SPECTATE: Could not open %s", fileName);
+        return NULL;
+    }
+
+    SpectatorStream* stream = CreateStream();
+    if (stream == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    stream->file = file;
+    return stream;
+}
+
+SpectatorStream* OpenSpectatorSocket(int localPort, const char* host, int remotePort)
+{
+    int socket = OpenUdpSocket(localPort);
+    if (socket < 0) {
+        TraceLog(LOG_WARNING, "SPECTATE: Could not open port %i", localPort);
+        return NULL;
+    }
+
+    SpectatorStream* stream = CreateStream();
+    if (stream == NULL) {
+        CloseUdpSocket(socket);
+        return NULL;
+    }
+    stream->socket = socket;
+    strncpy(stream->host, host, sizeof(stream->host) - 1);
+    stream->port = remotePort;
+    return stream;
+}
+
+void CloseSpectatorStream(SpectatorStream* stream)
+{
+    if (stream == NULL) return;
+    if (stream->file != NULL) fclose(stream->file);
+    if (stream->socket >= 0) CloseUdpSocket(stream->socket);
+    RL_FREE(stream);
+}
+
+// Writes the frame for the next tick of world
+void WriteSpectatorFrame(SpectatorStream* stream, const World* world)
+{
+    if (stream->socket >= 0) ReceiveAcks(stream);
+
+    unsigned int tick = ++stream->tick;
+    int viewCount = GetWorldObjectViews(world, stream->views, SPECTATE_MAX_OBJECTS);
+    WorldStatus worldStatus = GetWorldStatus(world);
+
+    // The frame the viewer already has, or an empty one for a key frame
+    static const SpectatorFrame emptyFrame = { 0 };
+    const SpectatorFrame* base = &emptyFrame;
+    if (stream->acked && tick - stream->ackTick < SPECTATE_HISTORY) {
+        const SpectatorFrame* acked = &stream->history[stream->ackTick % SPECTATE_HISTORY];
+        if (acked->valid && acked->tick == stream->ackTick) base = acked;
+    }
+
+    SpectatorFrame* frame = &stream->history[tick % SPECTATE_HISTORY];
+    if (frame != base) *frame = *base;
+    frame->valid = true;
+    frame->tick = tick;
+    frame->status = (SpectatorStatus){ (unsigned char)worldStatus.state, (unsigned char)worldStatus.level,
+        (unsigned char)worldStatus.lives, worldStatus.score, (unsigned short)worldStatus.width, (unsigned short)worldStatus.height };
+
+    unsigned char data[SPECTATE_MAX_FRAME];
+    int at = 0;
+    at = WriteU16(data, at, tick & 0xffff);
+    data[at++] = (unsigned char)((base == &emptyFrame) ? 0 : tick - base->tick);
+    int countAt = at;
+    at += 2;
+    int count = 0;
+
+    bool sendStatus = (base == &emptyFrame) || !IsStatusEqual(&base->status, &frame->status);
+    if (sendStatus) {
+        data[at++] = frame->status.state;
+        data[at++] = frame->status.level;
+        data[at++] = frame->status.lives;
+        at = WriteU16(data, at, (unsigned int)frame->status.score & 0xffff);
+        at = WriteU16(data, at, (unsigned int)frame->status.score >> 16);
+        at = WriteU16(data, at, frame->status.width);
+        at = WriteU16(data, at, frame->status.height);
+    }
+
+    for (int i = 0; i < viewCount; ++i) {
+        const ObjectView* view = &stream->views[i];
+        SpectatorObject* known = &frame->objects[i];
+
+        if (!view->active) {
+            if (known->active) {
+                at = WriteU16(data, at, (unsigned int)i | 0x8000);
+                *known = (SpectatorObject){ 0 };
+                ++count;
+            }
+            continue;
+        }
+
+        if (!IsObjectOff(known, view, tick, &frame->status)) continue;
+
+        *known = QuantizeObject(view, &stream->previous[i], tick, &frame->status);
+        at = WriteU16(data, at, (unsigned int)i);
+        data[at++] = known->model;
+        at = WriteU16(data, at, known->x);
+        at = WriteU16(data, at, known->y);
+        at = WriteU16(data, at, (unsigned short)known->vx);
+        at = WriteU16(data, at, (unsigned short)known->vy);
+        data[at++] = known->rot;
+        data[at++] = (unsigned char)known->rotVel;
+        ++count;
+    }
+    WriteU16(data, countAt, (unsigned int)count | (sendStatus ? 0x8000 : 0));
+
+    memcpy(stream->previous, stream->views, sizeof(ObjectView) * viewCount);
+
+    if (stream->file != NULL) {
+        unsigned char size[2] = { (unsigned char)(at & 0xff), (unsigned char)(at >> 8) };
+        fwrite(size, 1, 2, stream->file);
+        fwrite(data, 1, at, stream->file);
+        stream->bytes += at + 2;
+        // A file doesn't lose frames
+        stream->acked = true;
+        stream->ackTick = tick;
+    }
+    else {
+        SendUdp(stream->socket, stream->host, stream->port, data, at);
+        stream->bytes += at;
+    }
+    ++stream->frames;
+}
+
+// Average size of the stream so far
+float GetSpectatorBytesPerSecond(const SpectatorStream* stream)
+{
+    if (stream->frames == 0) return 0;
+    return (float)stream->bytes * SPECTATE_TICK_RATE / stream->frames;
+}
+
+//----------------------------------------------------------------------------------
+// Viewer Functions
+//----------------------------------------------------------------------------------
+
+SpectatorViewer* CreateSpectatorViewer(void)
+{
+    return (SpectatorViewer*)RL_CALLOC(1, sizeof(SpectatorViewer));
+}
+
+void DestroySpectatorViewer(SpectatorViewer* viewer)
+{
+    RL_FREE(viewer);
+}
+
+// Applies one frame (without the size used in files), returns false if the frame can't
+// be used, either it is broken or its base is unknown. On success ackTick is the tick
+// to send back to the stream
+bool ReadSpectatorFrame(SpectatorViewer* viewer, const unsigned char* data, int size, unsigned int* ackTick)
+{
+    if (size < 5) return false;
+
+    // Only the low bits of the tick are sent, the rest comes from the last frame
+    unsigned int low = ReadU16(data, 0);
+    unsigned int tick = (viewer->tick & ~0xffffu) | low;
+    if (viewer->started && tick + 0x8000u < viewer->tick) tick += 0x10000u;
+    int baseAgo = data[2];
+    int count = ReadU16(data, 3) & 0x7fff;
+    bool hasStatus = (ReadU16(data, 3) & 0x8000) != 0;
+
+    static const SpectatorFrame emptyFrame = { 0 };
+    const SpectatorFrame* base = &emptyFrame;
+    if (baseAgo > 0) {
+        base = &viewer->history[(tick - baseAgo) % SPECTATE_HISTORY];
+        if (!base->valid || base->tick != tick - baseAgo) return false;
+    }
+
+    SpectatorFrame frame = *base;
+    frame.valid = true;
+    frame.tick = tick;
+
+    int at = 5;
+    if (hasStatus) {
+        if (size < at + 11) return false;
+        frame.status.state = data[at++];
+        frame.status.level = data[at++];
+        frame.status.lives = data[at++];
+        frame.status.score = (int)(ReadU16(data, at) | (ReadU16(data, at + 2) << 16));
+        at += 4;
+        frame.status.width = (unsigned short)ReadU16(data, at);
+        frame.status.height = (unsigned short)ReadU16(data, at + 2);
+        at += 4;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (size < at + 2) return false;
+        int slot = ReadU16(data, at) & 0x7fff;
+        bool removed = (ReadU16(data, at) & 0x8000) != 0;
+        at += 2;
+        if (slot >= SPECTATE_MAX_OBJECTS) return false;
+        SpectatorObject* obj = &frame.objects[slot];
+        if (removed) {
+            *obj = (SpectatorObject){ 0 };
+            continue;
+        }
+
+        if (size < at + 11) return false;
+        obj->active = true;
+        obj->tick = tick;
+        obj->model = data[at];
+        obj->x = (unsigned short)ReadU16(data, at + 1);
+        obj->y = (unsigned short)ReadU16(data, at + 3);
+        obj->vx = (short)ReadU16(data, at + 5);
+        obj->vy = (short)ReadU16(data, at + 7);
+        obj->rot = data[at + 9];
+        obj->rotVel = (signed char)data[at + 10];
+        at += 11;
+    }
+
+    viewer->history[tick % SPECTATE_HISTORY] = frame;
+    viewer->tick = tick;
+    viewer->started = true;
+    if (ackTick != NULL) *ackTick = tick;
+    return true;
+}
+
+// Objects as they are at the last tick read, rotation in degrees
+int GetSpectatorObjects(const SpectatorViewer* viewer, ObjectView* views, int maxViews)
+{
+    const SpectatorFrame* frame = &viewer->history[viewer->tick % SPECTATE_HISTORY];
+    int count = (maxViews < SPECTATE_MAX_OBJECTS) ? maxViews : SPECTATE_MAX_OBJECTS;
+    for (int i = 0; i < count; ++i) {
+        const SpectatorObject* obj = &frame->objects[i];
+        views[i] = (ObjectView){ .active = viewer->started && obj->active };
+        if (!views[i].active) continue;
+
+        float rot;
+        PredictObject(obj, viewer->tick, &frame->status, &views[i].position, &rot);
+        views[i].rot = rot * 360.0f / 256.0f;
+        views[i].velocity = (Vector2){ obj->vx * SPECTATE_TICK_RATE / 64.0f, obj->vy * SPECTATE_TICK_RATE / 64.0f };
+        views[i].rotVel = obj->rotVel * SPECTATE_TICK_RATE * 360.0f / 2048.0f;
+        views[i].model = obj->model;
+    }
+    return count;
+}
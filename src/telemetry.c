@@ -0,0 +1,171 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Telemetry, live counters of the running game
+*
+*   Every thread that reports gets a block of counters of its own, only that thread
+*   ever writes to it, so updating a counter is a plain load and store without locks or
+*   atomic read-modify-write. Readers sum the blocks of all threads into a snapshot,
+*   high-water marks take the maximum instead. The endpoint serves the snapshot in the
+*   Prometheus text format from a thread of its own, e.g. `curl localhost:9100/metrics`.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+//----------------------------------------------------------------------------------
+// Telemetry Definition
+//----------------------------------------------------------------------------------
+#define TELEMETRY_MAX_THREADS 64
+#define TELEMETRY_SLOTS ((TELEMETRY_METRIC_COUNT + 7) / 8 * 8)     // Whole cache lines
+
+// Single writer per block, only the loads and stores themselves have to be atomic
+#if defined(_MSC_VER)
+    #define TELEMETRY_ALIGNED __declspec(align(64))
+    #define TELEMETRY_THREAD __declspec(thread)
+    #define TelemetryLoad(value) (*(volatile long long*)(value))
+    #define TelemetryStore(value, amount) (*(volatile long long*)(value) = (amount))
+    #define TelemetryIncrement(value) _InterlockedIncrement((volatile long*)(value))
+#else
+    #define TELEMETRY_ALIGNED __attribute__((aligned(64)))
+    #define TELEMETRY_THREAD __thread
+    #define TelemetryLoad(value) __atomic_load_n((value), __ATOMIC_RELAXED)
+    #define TelemetryStore(value, amount) __atomic_store_n((value), (amount), __ATOMIC_RELAXED)
+    #define TelemetryIncrement(value) __atomic_add_fetch((value), 1, __ATOMIC_RELAXED)
+#endif
+
+typedef struct TelemetryBlock {
+    long long values[TELEMETRY_SLOTS];
+} TelemetryBlock;
+
+typedef struct TelemetryInfo {
+    const char* name;
+    const char* type;
+    const char* help;
+    float scale;                // Applied when exporting, times are counted in microseconds
+    bool highWater;             // Aggregated as maximum instead of sum
+} TelemetryInfo;
+
+static const TelemetryInfo telemetryInfo[TELEMETRY_METRIC_COUNT] = {
+    [TELEMETRY_TICKS] = { "rasteroids_ticks_total", "counter", "Simulation steps run", 1, false },
+    [TELEMETRY_TICK_TIME] = { "rasteroids_tick_seconds_total", "counter", "Time spent in simulation steps", 1e-6f, false },
+    [TELEMETRY_FRAMES] = { "rasteroids_frames_total", "counter", "Frames shown", 1, false },
+    [TELEMETRY_FRAME_TIME] = { "rasteroids_frame_seconds_total", "counter", "Time between frames, including the wait for the next frame", 1e-6f, false },
+    [TELEMETRY_DRAW_CALLS] = { "rasteroids_draw_calls", "gauge", "Shapes drawn by the gameplay screen in the last frame", 1, false },
+    [TELEMETRY_OBJECTS] = { "rasteroids_objects", "gauge", "Active game objects", 1, false },
+    [TELEMETRY_PARTICLES] = { "rasteroids_particles", "gauge", "Active particles", 1, false },
+    [TELEMETRY_BULLETS] = { "rasteroids_bullets", "gauge", "Active bullets", 1, false },
+    [TELEMETRY_ASTEROIDS] = { "rasteroids_asteroids", "gauge", "Active asteroids", 1, false },
+    [TELEMETRY_OBJECTS_MAX] = { "rasteroids_objects_max", "gauge", "Most game objects active at once in one game", 1, true },
+    [TELEMETRY_PARTICLES_MAX] = { "rasteroids_particles_max", "gauge", "Most particles active at once in one game", 1, true },
+    [TELEMETRY_BULLETS_MAX] = { "rasteroids_bullets_max", "gauge", "Most bullets active at once in one game", 1, true },
+    [TELEMETRY_ASTEROIDS_MAX] = { "rasteroids_asteroids_max", "gauge", "Most asteroids active at once in one game", 1, true },
+    [TELEMETRY_DROPPED_BULLETS] = { "rasteroids_dropped_bullets_total", "counter", "Bullets not fired as the pool was empty", 1, false },
+    [TELEMETRY_DROPPED_PARTICLES] = { "rasteroids_dropped_particles_total", "counter", "Particles not spawned as the pool was full", 1, false },
+    [TELEMETRY_INPUT_PRESSES] = { "rasteroids_input_presses_total", "counter", "Key and button presses taken by simulation steps", 1, false },
+    [TELEMETRY_INPUT_LATENCY] = { "rasteroids_input_latency_seconds_total", "counter", "Time from sampling a press until the frame using it was shown", 1e-6f, false },
+};
+
+static TELEMETRY_ALIGNED TelemetryBlock blocks[TELEMETRY_MAX_THREADS] = { 0 };
+static long blockCount = 0;
+static TELEMETRY_THREAD TelemetryBlock* threadBlock = NULL;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+// The block of the calling thread, threads past the limit share the last block and
+// may lose some of their updates
+static TelemetryBlock* GetThreadBlock(void)
+{
+    if (threadBlock == NULL) {
+        long index = TelemetryIncrement(&blockCount) - 1;
+        threadBlock = &blocks[(index < TELEMETRY_MAX_THREADS) ? index : TELEMETRY_MAX_THREADS - 1];
+    }
+    return threadBlock;
+}
+
+static int FormatTelemetryText(char* text, int size)
+{
+    TelemetrySnapshot snapshot = GetTelemetrySnapshot();
+    return FormatTelemetry(&snapshot, text, size);
+}
+
+//----------------------------------------------------------------------------------
+// Telemetry Functions
+//----------------------------------------------------------------------------------
+
+void AddTelemetry(TelemetryMetric metric, long long amount)
+{
+    long long* value = &GetThreadBlock()->values[metric];
+    TelemetryStore(value, TelemetryLoad(value) + amount);
+}
+
+// Sets the value of the calling thread, the snapshot still sums all threads
+void SetTelemetry(TelemetryMetric metric, long long amount)
+{
+    TelemetryStore(&GetThreadBlock()->values[metric], amount);
+}
+
+void MaxTelemetry(TelemetryMetric metric, long long amount)
+{
+    long long* value = &GetThreadBlock()->values[metric];
+    if (amount > TelemetryLoad(value)) TelemetryStore(value, amount);
+}
+
+// Adds up the blocks of all threads, the metrics are read one by one so the snapshot
+// isn't exact while other threads are running
+TelemetrySnapshot GetTelemetrySnapshot(void)
+{
+    TelemetrySnapshot snapshot = { 0 };
+    long threads = TelemetryLoad(&blockCount);
+    snapshot.threads = (threads < TELEMETRY_MAX_THREADS) ? (int)threads : TELEMETRY_MAX_THREADS;
+
+    for (int t = 0; t < snapshot.threads; ++t) {
+        for (int m = 0; m < TELEMETRY_METRIC_COUNT; ++m) {
+            long long value = TelemetryLoad(&blocks[t].values[m]);
+            if (!telemetryInfo[m].highWater) snapshot.values[m] += value;
+            else if (value > snapshot.values[m]) snapshot.values[m] = value;
+        }
+    }
+    return snapshot;
+}
+
+// Writes the snapshot in the Prometheus text format, returns the length of the text
+int FormatTelemetry(const TelemetrySnapshot* snapshot, char* text, int size)
+{
+    int length = 0;
+    for (int m = 0; m < TELEMETRY_METRIC_COUNT && length < size; ++m) {
+        const TelemetryInfo* info = &telemetryInfo[m];
+        int written = (info->scale == 1) ?
+            snprintf(text + length, size - length, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n",
+                info->name, info->help, info->name, info->type, info->name, snapshot->values[m]) :
+            snprintf(text + length, size - length, "# HELP %s %s\n# TYPE %s %s\n%s %.6f\n",
+                info->name, info->help, info->name, info->type, info->name, snapshot->values[m] * (double)info->scale);
+        if (written < 0) break;
+        length += written;
+    }
+    return (length < size) ? length : size - 1;
+}
+
+bool StartTelemetryEndpoint(int port)
+{
+    if (!StartHttpTextServer(port, FormatTelemetryText)) {
+        TraceLog(LOG_WARNING, "TELEMETRY: Could not listen on port %i", port);
+        return false;
+    }
+    TraceLog(LOG_INFO, "TELEMETRY: Serving metrics on http://127.0.0.1:%i/metrics", port);
+    return true;
+}
+
+void StopTelemetryEndpoint(void)
+{
+    StopHttpTextServer();
+}
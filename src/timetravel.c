@@ -0,0 +1,223 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Time Travel Debugger, scrub back and forth through the last seconds of the game
+*
+*   Every TIMETRAVEL_INTERVAL steps a snapshot of the game is kept, together with the
+*   inputs and frame time of every step. Any recorded step can be shown by restoring the
+*   snapshot before it and simulating the steps in between again, the simulation is
+*   deterministic so this gives back the exact state. All buffers are allocated once,
+*   old snapshots get overwritten, that is about 150 KB for ten seconds.
+*
+*   F6 pauses and resumes, while paused LEFT/RIGHT move one step, UP/DOWN one second,
+*   END goes back to the present and the timeline can be clicked. Resuming continues
+*   from the step that is shown.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+//----------------------------------------------------------------------------------
+// Time Travel Definition
+//----------------------------------------------------------------------------------
+#define TIMETRAVEL_SECONDS 10
+#define TIMETRAVEL_INTERVAL 60                  // Steps between snapshots, one second
+#define TIMETRAVEL_SNAPSHOTS (TIMETRAVEL_SECONDS * 60 / TIMETRAVEL_INTERVAL + 1)
+#define TIMETRAVEL_STEPS (TIMETRAVEL_SNAPSHOTS * TIMETRAVEL_INTERVAL)
+
+typedef struct RecordedStep {
+    int inputs[MAX_PLAYERS];
+    float dt;
+} RecordedStep;
+
+typedef struct TimeTravel {
+    bool paused;
+    int recorded;               // Steps recorded, also the step that runs next
+    int shown;                  // Step shown while paused
+
+    int snapshotSize;
+    unsigned char* snapshots;   // TIMETRAVEL_SNAPSHOTS snapshots, one every TIMETRAVEL_INTERVAL steps
+    int snapshotSteps[TIMETRAVEL_SNAPSHOTS];
+    unsigned char* present;     // State when pausing
+    RecordedStep* steps;        // TIMETRAVEL_STEPS entries
+
+    double captureTime;         // Time spent taking snapshots, to report the overhead
+    double stepTime;            // Estimated time of all steps, from the steps with a snapshot
+} TimeTravel;
+
+static TimeTravel timeTravel = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static Rectangle GetTimeline(void)
+{
+    return (Rectangle){ 20, VIEW_HEIGHT - 40.0f, VIEW_WIDTH - 40.0f, 12 };
+}
+
+static unsigned char* GetSnapshot(int step)
+{
+    return timeTravel.snapshots + (size_t)((step / TIMETRAVEL_INTERVAL) % TIMETRAVEL_SNAPSHOTS) * timeTravel.snapshotSize;
+}
+
+// Oldest step that can still be shown
+static int GetFirstStep(void)
+{
+    int first = (timeTravel.recorded / TIMETRAVEL_INTERVAL - (TIMETRAVEL_SNAPSHOTS - 1)) * TIMETRAVEL_INTERVAL;
+    return (first < 0) ? 0 : first;
+}
+
+// Puts the game into the state before the given step
+static void ShowStep(int step)
+{
+    if (step < GetFirstStep()) step = GetFirstStep();
+    if (step > timeTravel.recorded) step = timeTravel.recorded;
+
+    if (step == timeTravel.recorded) {
+        RestoreGameplaySnapshot(timeTravel.present, timeTravel.snapshotSize);
+    }
+    else {
+        int from = step - step % TIMETRAVEL_INTERVAL;
+        if (timeTravel.snapshotSteps[(from / TIMETRAVEL_INTERVAL) % TIMETRAVEL_SNAPSHOTS] != from) {
+            TraceLog(LOG_WARNING, "TIMETRAVEL: No snapshot for step %i", from);
+            return;
+        }
+        RestoreGameplaySnapshot(GetSnapshot(from), timeTravel.snapshotSize);
+        for (int i = from; i < step; ++i) {
+            RecordedStep* recorded = &timeTravel.steps[i % TIMETRAVEL_STEPS];
+            StepGameplay(recorded->inputs, recorded->dt, false);
+        }
+    }
+    timeTravel.shown = step;
+}
+
+//----------------------------------------------------------------------------------
+// Time Travel Functions
+//----------------------------------------------------------------------------------
+
+// Allocates the buffers, the history starts with the current state of the game
+void InitTimeTravel(void)
+{
+    CloseTimeTravel();
+
+    timeTravel.snapshotSize = GetGameplaySnapshotSize();
+    timeTravel.snapshots = (unsigned char*)MemAlloc(timeTravel.snapshotSize * TIMETRAVEL_SNAPSHOTS);
+    timeTravel.present = (unsigned char*)MemAlloc(timeTravel.snapshotSize);
+    timeTravel.steps = (RecordedStep*)MemAlloc(sizeof(RecordedStep) * TIMETRAVEL_STEPS);
+    ResetTimeTravel();
+}
+
+void CloseTimeTravel(void)
+{
+    MemFree(timeTravel.snapshots);
+    MemFree(timeTravel.present);
+    MemFree(timeTravel.steps);
+    timeTravel = (TimeTravel){ 0 };
+}
+
+// Forgets the history, used when the game state changes outside of the steps
+void ResetTimeTravel(void)
+{
+    timeTravel.paused = false;
+    timeTravel.recorded = 0;
+    timeTravel.shown = 0;
+    timeTravel.captureTime = 0;
+    timeTravel.stepTime = 0;
+    for (int i = 0; i < TIMETRAVEL_SNAPSHOTS; ++i) {
+        timeTravel.snapshotSteps[i] = -1;
+    }
+}
+
+// Steps the game and records the step
+void StepGameplayRecorded(const int inputs[MAX_PLAYERS], float dt)
+{
+    if (timeTravel.steps == NULL) {
+        StepGameplay(inputs, dt, true);
+        return;
+    }
+
+    int step = timeTravel.recorded;
+    RecordedStep* recorded = &timeTravel.steps[step % TIMETRAVEL_STEPS];
+    for (int p = 0; p < MAX_PLAYERS; ++p) recorded->inputs[p] = inputs[p];
+    recorded->dt = dt;
+
+    // Only the steps with a snapshot get timed, so timing doesn't add to the overhead of the others
+    if (step % TIMETRAVEL_INTERVAL == 0) {
+        double start = GetTime();
+        SaveGameplaySnapshot(GetSnapshot(step), timeTravel.snapshotSize);
+        timeTravel.snapshotSteps[(step / TIMETRAVEL_INTERVAL) % TIMETRAVEL_SNAPSHOTS] = step;
+        double captured = GetTime();
+        StepGameplay(inputs, dt, true);
+        timeTravel.captureTime += captured - start;
+        timeTravel.stepTime += (GetTime() - captured) * TIMETRAVEL_INTERVAL;
+    }
+    else {
+        StepGameplay(inputs, dt, true);
+    }
+    ++timeTravel.recorded;
+}
+
+// Handles the debugger keys, returns true while the game is paused
+bool UpdateTimeTravel(void)
+{
+    if (timeTravel.steps == NULL) return false;
+
+    if (IsKeyPressed(KEY_F6)) {
+        if (!timeTravel.paused) {
+            SaveGameplaySnapshot(timeTravel.present, timeTravel.snapshotSize);
+            timeTravel.shown = timeTravel.recorded;
+            timeTravel.paused = true;
+        }
+        else {
+            // Continue from the step shown, what came after it is gone
+            RewindReplayRecording(timeTravel.recorded - timeTravel.shown);
+            timeTravel.recorded = timeTravel.shown;
+            int next = (timeTravel.recorded + TIMETRAVEL_INTERVAL - 1) / TIMETRAVEL_INTERVAL * TIMETRAVEL_INTERVAL;
+            for (int i = 0; i < TIMETRAVEL_SNAPSHOTS; ++i) {
+                if (timeTravel.snapshotSteps[i] >= next) timeTravel.snapshotSteps[i] = -1;
+            }
+            timeTravel.paused = false;
+        }
+        return timeTravel.paused;
+    }
+    if (!timeTravel.paused) return false;
+
+    int step = timeTravel.shown;
+    if (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) step -= 1;
+    if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) step += 1;
+    if (IsKeyPressed(KEY_DOWN) || IsKeyPressedRepeat(KEY_DOWN)) step -= 60;
+    if (IsKeyPressed(KEY_UP) || IsKeyPressedRepeat(KEY_UP)) step += 60;
+    if (IsKeyPressed(KEY_END)) step = timeTravel.recorded;
+
+    Rectangle timeline = GetTimeline();
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(GetMousePosition(), timeline)) {
+        float t = (GetMousePosition().x - timeline.x) / timeline.width;
+        step = GetFirstStep() + (int)(t * (timeTravel.recorded - GetFirstStep()) + 0.5f);
+    }
+
+    if (step != timeTravel.shown) ShowStep(step);
+    return true;
+}
+
+// Timeline and timings while paused, drawn on top of the game
+void DrawTimeTravel(void)
+{
+    if (timeTravel.steps == NULL || !timeTravel.paused) return;
+
+    int first = GetFirstStep();
+    int range = timeTravel.recorded - first;
+    Rectangle timeline = GetTimeline();
+    DrawRectangleLinesEx(timeline, 1, GRAY);
+    if (range > 0) {
+        float x = timeline.x + timeline.width * (timeTravel.shown - first) / (float)range;
+        DrawRectangleRec((Rectangle){ timeline.x, timeline.y, x - timeline.x, timeline.height }, Fade(YELLOW, 0.4f));
+        DrawLineV((Vector2){ x, timeline.y - 4 }, (Vector2){ x, timeline.y + timeline.height + 4 }, YELLOW);
+    }
+
+    // Capture overhead relative to the time spent in the steps themselves
+    float overhead = (timeTravel.stepTime > 0) ? (float)(100.0 * timeTravel.captureTime / timeTravel.stepTime) : 0;
+    DrawTextEx(smallFont, TextFormat("PAUSED STEP %i OF %i %+.2fS CAPTURE %.2f%%", timeTravel.shown, timeTravel.recorded,
+        (timeTravel.shown - timeTravel.recorded) / 60.0f, overhead), (Vector2){ 20, VIEW_HEIGHT - 24.0f }, smallFont.baseSize * 0.5f, 1.0f, YELLOW);
+}
@@ -0,0 +1,348 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Headless frame capture, draws games with the software rasterizer
+*
+*   Runs a game from its seed without a window or a GPU and draws every step through the
+*   same calls the gameplay screen uses, rasterized on the CPU (see canvas.c). Nobody
+*   steers the ship, so the frames of a seed are always the same, for comparing frames
+*   between versions. The frames go either into a directory as PNG files or one after
+*   the other as raw RGBA (VIEW_WIDTH x VIEW_HEIGHT) into a file or to stdout, e.g.
+*
+*       rasteroids_render 7 60 - | ffmpeg -f rawvideo -pix_fmt rgba -s 1024x768 -r 60 -i - game.mp4
+*
+*   --export draws every step of a replay (see replay.c) instead, one frame per step at
+*   60 frames per second, as Y4M to a .y4m file or to stdout, or as raw RGBA:
+*
+*       rasteroids_render --export last.replay - | ffmpeg -i - game.mp4
+*
+*   Drawing and encoding run on two threads with a few frames queued between them, an
+*   export takes as long as the slower of the two and not their sum. --glow adds the
+*   phosphor glow of the game (glow.c) to the frames.
+*
+*   usage: rasteroids_render [--glow] <seed> <seconds> <directory | file.rgba | -> [every nth step]
+*          rasteroids_render [--glow] --export <replay> <file.y4m | file.rgba | ->
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//----------------------------------------------------------------------------------
+// Shared Variables Definition (global)
+// NOTE: The gameplay module links against these, only the fonts are used
+//----------------------------------------------------------------------------------
+GameScreen currentScreen = SCREEN_GAMEPLAY;
+Font smallFont = { 0 };
+Font largeFont = { 0 };
+Sound sounds[SOUND_MAX] = { 0 };
+ControlMap controlMap = { 0 };
+int lastGameScore = 0;
+HighscoreTable highscores = { 0 };
+
+//----------------------------------------------------------------------------------
+// Export Definition
+//----------------------------------------------------------------------------------
+#define EXPORT_QUEUE 4              // Frames drawn ahead of the encoder
+
+typedef struct ExportQueue {
+    Raster frames[EXPORT_QUEUE];
+    int drawn;                      // Frames handed to the encoder
+    int written;                    // Frames the encoder is done with
+    bool finished;                  // No more frames get drawn
+    bool failed;                    // Writing failed, drawing stops
+    pthread_mutex_t lock;
+    pthread_cond_t changed;         // Any of the above changed
+
+    FILE* file;
+    bool y4m;
+    unsigned char* encoded;         // One Y4M frame as it gets written
+    int encodedSize;
+    double encodeTime;
+} ExportQueue;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Same sizes as LoadFont() and LoadFontEx() in the game
+static bool LoadResources(void)
+{
+    SetTraceLogLevel(LOG_WARNING);
+    InitGameLog();
+    LoadDefinitions("resources/definitions.txt");
+
+    smallFont = LoadRasterFont("resources/Hyperspace.ttf", 32);
+    largeFont = LoadRasterFont("resources/Hyperspace.ttf", 72);
+    if (smallFont.glyphs == NULL || largeFont.glyphs == NULL) {
+        fprintf(stderr, "Could not load resources/Hyperspace.ttf\n");
+        return false;
+    }
+    return true;
+}
+
+static void UnloadResources(void)
+{
+    UnloadRasterFont(smallFont);
+    UnloadRasterFont(largeFont);
+    UnloadGlow();
+    CloseGameLog();
+}
+
+static inline unsigned char GetLuma(Color c)
+{
+    return (unsigned char)(((66 * c.r + 129 * c.g + 25 * c.b + 128) >> 8) + 16);
+}
+
+// BT.601 in video range, chroma averaged over every 2x2 block (C420jpeg siting), in
+// fixed point. The frame size is even
+static void ConvertFrameToYuv(const Raster* frame, unsigned char* yuv)
+{
+    int width = frame->width;
+    unsigned char* lumaPlane = yuv;
+    unsigned char* cbPlane = yuv + width * frame->height;
+    unsigned char* crPlane = cbPlane + (width / 2) * (frame->height / 2);
+
+    for (int y = 0; y < frame->height; y += 2) {
+        const Color* top = frame->pixels + y * width;
+        const Color* bottom = top + width;
+        unsigned char* lumaTop = lumaPlane + y * width;
+        unsigned char* lumaBottom = lumaTop + width;
+        unsigned char* cb = cbPlane + (y / 2) * (width / 2);
+        unsigned char* cr = crPlane + (y / 2) * (width / 2);
+
+        for (int x = 0; x < width; x += 2) {
+            Color c0 = top[x], c1 = top[x + 1], c2 = bottom[x], c3 = bottom[x + 1];
+            lumaTop[x] = GetLuma(c0);
+            lumaTop[x + 1] = GetLuma(c1);
+            lumaBottom[x] = GetLuma(c2);
+            lumaBottom[x + 1] = GetLuma(c3);
+
+            // Sums of the four pixels, the offset keeps the values positive before the shift
+            int r = c0.r + c1.r + c2.r + c3.r;
+            int g = c0.g + c1.g + c2.g + c3.g;
+            int b = c0.b + c1.b + c2.b + c3.b;
+            cb[x / 2] = (unsigned char)((-38 * r - 74 * g + 112 * b + (128 << 10) + 512) >> 10);
+            cr[x / 2] = (unsigned char)((112 * r - 94 * g - 18 * b + (128 << 10) + 512) >> 10);
+        }
+    }
+}
+
+static bool WriteFrame(ExportQueue* queue, const Raster* frame)
+{
+    size_t pixels = (size_t)frame->width * frame->height;
+    if (!queue->y4m) return fwrite(frame->pixels, sizeof(Color), pixels, queue->file) == pixels;
+
+    static const char frameTag[] = "FRAME\n";
+    memcpy(queue->encoded, frameTag, sizeof(frameTag) - 1);
+    ConvertFrameToYuv(frame, queue->encoded + sizeof(frameTag) - 1);
+    return fwrite(queue->encoded, 1, queue->encodedSize, queue->file) == (size_t)queue->encodedSize;
+}
+
+// Encoder thread, writes the frames in the order they were drawn
+static void* EncodeFrames(void* arg)
+{
+    ExportQueue* queue = (ExportQueue*)arg;
+
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (queue->written == queue->drawn && !queue->finished) pthread_cond_wait(&queue->changed, &queue->lock);
+        if (queue->written == queue->drawn) break;
+        const Raster* frame = &queue->frames[queue->written % EXPORT_QUEUE];
+        pthread_mutex_unlock(&queue->lock);
+
+        double start = GetSeconds();
+        bool written = WriteFrame(queue, frame);
+        double seconds = GetSeconds() - start;
+
+        pthread_mutex_lock(&queue->lock);
+        queue->encodeTime += seconds;
+        ++queue->written;
+        queue->failed = !written;
+        pthread_cond_signal(&queue->changed);
+        if (!written) break;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Draws every step of the replay on this thread while another one encodes and writes
+static int ExportReplay(const char* replayFile, const char* output)
+{
+    Replay replay = { 0 };
+    if (!LoadReplay(replayFile, &replay)) {
+        fprintf(stderr, "Could not load the replay %s\n", replayFile);
+        return 1;
+    }
+
+    ExportQueue queue = { 0 };
+    queue.y4m = !IsFileExtension(output, ".rgba");
+    queue.file = TextIsEqual(output, "-") ? stdout : fopen(output, "wb");
+    if (queue.file == NULL) {
+        fprintf(stderr, "Could not open %s\n", output);
+        UnloadReplay(&replay);
+        return 1;
+    }
+    if (queue.y4m) {
+        fprintf(queue.file, "YUV4MPEG2 W%i H%i F60:1 Ip A1:1 C420jpeg\n", VIEW_WIDTH, VIEW_HEIGHT);
+        queue.encodedSize = 6 + VIEW_WIDTH * VIEW_HEIGHT * 3 / 2;
+        queue.encoded = (unsigned char*)RL_MALLOC(queue.encodedSize);
+    }
+    for (int i = 0; i < EXPORT_QUEUE; ++i) {
+        queue.frames[i] = LoadRaster(VIEW_WIDTH, VIEW_HEIGHT);
+    }
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.changed, NULL);
+
+    pthread_t encoder;
+    pthread_create(&encoder, NULL, EncodeFrames, &queue);
+
+    World* world = CreateWorld(replay.playerCount, replay.seed, VIEW_WIDTH, VIEW_HEIGHT);
+    double drawTime = 0;
+    double start = GetSeconds();
+    for (int step = 0; step < replay.stepCount; ++step) {
+        int inputs[MAX_PLAYERS] = { 0 };
+        for (int p = 0; p < MAX_PLAYERS; ++p) {
+            inputs[p] = replay.steps[step].inputs[p];
+        }
+        StepWorld(world, inputs, replay.steps[step].dt);
+
+        // Wait for a free frame
+        pthread_mutex_lock(&queue.lock);
+        while (queue.drawn - queue.written == EXPORT_QUEUE && !queue.failed) pthread_cond_wait(&queue.changed, &queue.lock);
+        bool failed = queue.failed;
+        pthread_mutex_unlock(&queue.lock);
+        if (failed) break;
+
+        double drawStart = GetSeconds();
+        Raster* frame = &queue.frames[step % EXPORT_QUEUE];
+        SetCanvasRaster(frame);
+        ClearRaster(frame, BLACK);
+        DrawWorld(world);
+        ApplyRasterGlow(frame, replay.steps[step].dt);
+        drawTime += GetSeconds() - drawStart;
+
+        pthread_mutex_lock(&queue.lock);
+        ++queue.drawn;
+        pthread_cond_signal(&queue.changed);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.finished = true;
+    pthread_cond_signal(&queue.changed);
+    pthread_mutex_unlock(&queue.lock);
+    pthread_join(encoder, NULL);
+    double seconds = GetSeconds() - start;
+
+    if (queue.failed) fprintf(stderr, "Could not write frame %i\n", queue.written - 1);
+    int frames = queue.written;
+    fprintf(stderr, "%i of %i steps in %.2f s, %.0f frames per second, drawing %.3f ms and encoding %.3f ms per frame\n",
+        frames, replay.stepCount, seconds, (seconds > 0) ? frames / seconds : 0.0,
+        (frames > 0) ? 1000.0 * drawTime / frames : 0.0, (frames > 0) ? 1000.0 * queue.encodeTime / frames : 0.0);
+
+    SetCanvasRaster(NULL);
+    DestroyWorld(world);
+    pthread_cond_destroy(&queue.changed);
+    pthread_mutex_destroy(&queue.lock);
+    for (int i = 0; i < EXPORT_QUEUE; ++i) {
+        UnloadRaster(&queue.frames[i]);
+    }
+    RL_FREE(queue.encoded);
+    if (queue.file != stdout) fclose(queue.file);
+    UnloadReplay(&replay);
+    return queue.failed ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------------
+// Main entry point
+//----------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    const char* program = argv[0];
+    if (argc > 1 && TextIsEqual(argv[1], "--glow")) {
+        SetGlowEnabled(true);
+        --argc;
+        ++argv;
+    }
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s [--glow] <seed> <seconds> <directory | file.rgba | -> [every nth step]\n", program);
+        fprintf(stderr, "       %s [--glow] --export <replay> <file.y4m | file.rgba | ->\n", program);
+        return 1;
+    }
+    if (TextIsEqual(argv[1], "--export")) {
+        if (!LoadResources()) return 1;
+        int result = ExportReplay(argv[2], argv[3]);
+        UnloadResources();
+        return result;
+    }
+
+    unsigned int seed = (unsigned int)TextToInteger(argv[1]);
+    int steps = TextToInteger(argv[2]) * 60;
+    const char* output = argv[3];
+    int every = (argc > 4) ? TextToInteger(argv[4]) : 1;
+    if (every < 1) every = 1;
+
+    if (!LoadResources()) return 1;
+
+    // Raw frames go into one stream, PNG files into the directory
+    bool raw = TextIsEqual(output, "-") || IsFileExtension(output, ".rgba");
+    FILE* rawFile = NULL;
+    if (raw) {
+        rawFile = TextIsEqual(output, "-") ? stdout : fopen(output, "wb");
+        if (rawFile == NULL) {
+            fprintf(stderr, "Could not open %s\n", output);
+            return 1;
+        }
+    }
+
+    Raster raster = LoadRaster(VIEW_WIDTH, VIEW_HEIGHT);
+    World* world = CreateWorld(1, seed, VIEW_WIDTH, VIEW_HEIGHT);
+    SetCanvasRaster(&raster);
+
+    int inputs[MAX_PLAYERS] = { 0 };
+    int frames = 0;
+    double drawTime = 0;
+    double start = GetSeconds();
+    for (int step = 0; step < steps && !IsWorldFinished(world); ++step) {
+        StepWorld(world, inputs, 1.0f / 60.0f);
+        if (step % every != 0) continue;
+
+        double drawStart = GetSeconds();
+        ClearRaster(&raster, BLACK);
+        DrawWorld(world);
+        ApplyRasterGlow(&raster, every / 60.0f);
+        drawTime += GetSeconds() - drawStart;
+
+        bool written = raw ? fwrite(raster.pixels, sizeof(Color), (size_t)VIEW_WIDTH * VIEW_HEIGHT, rawFile) == (size_t)VIEW_WIDTH * VIEW_HEIGHT :
+            ExportRaster(&raster, TextFormat("%s/frame%06i.png", output, frames));
+        if (!written) {
+            fprintf(stderr, "Could not write frame %i\n", frames);
+            break;
+        }
+        ++frames;
+    }
+    double seconds = GetSeconds() - start;
+
+    SetCanvasRaster(NULL);
+    DestroyWorld(world);
+    UnloadRaster(&raster);
+    if (rawFile != NULL && rawFile != stdout) fclose(rawFile);
+    UnloadResources();
+
+    fprintf(stderr, "%i frames in %.2f s, %.0f frames per second, drawing %.3f ms per frame\n", frames, seconds,
+        (seconds > 0) ? frames / seconds : 0.0, (frames > 0) ? 1000.0 * drawTime / frames : 0.0);
+    return 0;
+}
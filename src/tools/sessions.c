@@ -0,0 +1,168 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Session log reader, sums up the finished games of one or more session logs
+*
+*   The files are mapped into memory and walked record by record, nothing gets copied
+*   or allocated per record, so millions of games take well under a second. Logs of
+*   newer versions are read too: their records may only grow, so each one is read as
+*   far as the known SessionRecord goes and the rest is skipped by its length. A record
+*   cut off at the end of a file is skipped.
+*
+*   usage: rasteroids_sessions <session log> [more session logs]
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Aggregation Definition
+//----------------------------------------------------------------------------------
+#define LEVEL_BUCKETS 32                // The last bucket holds all higher levels
+
+typedef struct SessionTotals {
+    long long games;
+    long long versusGames;
+    long long score;
+    int maxScore;
+    double duration;
+    long long shotsFired;
+    long long hits;
+    long long deaths[SESSION_DEATH_CAUSES];
+    long long hyperspaceJumps;
+    long long levels[LEVEL_BUCKETS];
+    long long truncated;                // Files that ended in the middle of a record
+} SessionTotals;
+
+static const char* deathNames[SESSION_DEATH_CAUSES] = { "asteroid", "saucer", "saucer bullet", "other ship" };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static void AddRecord(SessionTotals* totals, const SessionRecord* record)
+{
+    ++totals->games;
+    if (record->playerCount > 1) ++totals->versusGames;
+    totals->score += record->score;
+    if (record->score > totals->maxScore) totals->maxScore = record->score;
+    totals->duration += record->duration;
+    totals->shotsFired += record->shotsFired;
+    totals->hits += record->hits;
+    for (int c = 0; c < SESSION_DEATH_CAUSES; ++c) totals->deaths[c] += record->deaths[c];
+    totals->hyperspaceJumps += record->hyperspaceJumps;
+
+    int level = (record->level < 0) ? 0 : (record->level >= LEVEL_BUCKETS) ? LEVEL_BUCKETS - 1 : record->level;
+    ++totals->levels[level];
+}
+
+// Walks all records of the mapped file, returns false if it isn't a session log. The
+// version isn't checked, every version keeps the length in front of its records
+static bool ScanSessionLog(const unsigned char* data, size_t size, SessionTotals* totals)
+{
+    SessionLogHeader header = { 0 };
+    if (size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != SESSION_LOG_MAGIC) return false;
+
+    size_t at = sizeof(header);
+    while (at + sizeof(unsigned int) <= size) {
+        unsigned int length = 0;
+        memcpy(&length, data + at, sizeof(length));
+        at += sizeof(length);
+        if (length > size - at) {
+            ++totals->truncated;
+            break;
+        }
+
+        // Records are only aligned to 4 bytes, older ones may be shorter and the unknown
+        // trailing fields of newer ones get skipped with the length
+        SessionRecord record = { 0 };
+        memcpy(&record, data + at, (length < sizeof(record)) ? length : sizeof(record));
+        AddRecord(totals, &record);
+        at += length;
+    }
+    return true;
+}
+
+static bool ReadSessionLog(const char* fileName, SessionTotals* totals)
+{
+    int file = open(fileName, O_RDONLY);
+    if (file < 0) {
+        fprintf(stderr, "Could not open %s\n", fileName);
+        return false;
+    }
+
+    struct stat info;
+    bool read = false;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+            read = ScanSessionLog((const unsigned char*)data, (size_t)info.st_size, totals);
+            munmap(data, (size_t)info.st_size);
+        }
+    }
+    close(file);
+
+    if (!read) fprintf(stderr, "%s is not a session log\n", fileName);
+    return read;
+}
+
+static double PerGame(const SessionTotals* totals, double value)
+{
+    return (totals->games > 0) ? value / (double)totals->games : 0;
+}
+
+static void PrintTotals(const SessionTotals* totals)
+{
+    printf("games            %lld (%lld versus)\n", totals->games, totals->versusGames);
+    printf("time played      %.1f h, %.1f s per game\n", totals->duration / 3600.0, PerGame(totals, totals->duration));
+    printf("score            %.0f per game, best %i\n", PerGame(totals, (double)totals->score), totals->maxScore);
+    printf("shots fired      %.1f per game, %.1f%% hit\n", PerGame(totals, (double)totals->shotsFired),
+        (totals->shotsFired > 0) ? 100.0 * (double)totals->hits / (double)totals->shotsFired : 0.0);
+    printf("hyperspace       %.2f jumps per game\n", PerGame(totals, (double)totals->hyperspaceJumps));
+
+    long long deaths = 0;
+    for (int c = 0; c < SESSION_DEATH_CAUSES; ++c) deaths += totals->deaths[c];
+    printf("deaths           %.2f per game\n", PerGame(totals, (double)deaths));
+    for (int c = 0; c < SESSION_DEATH_CAUSES; ++c) {
+        printf("  %-14s %5.1f%%\n", deathNames[c], (deaths > 0) ? 100.0 * (double)totals->deaths[c] / (double)deaths : 0.0);
+    }
+
+    printf("level reached\n");
+    for (int l = 0; l < LEVEL_BUCKETS; ++l) {
+        if (totals->levels[l] == 0) continue;
+        printf("  %2i%s %14lld %5.1f%%\n", l, (l == LEVEL_BUCKETS - 1) ? "+" : " ", totals->levels[l],
+            100.0 * PerGame(totals, (double)totals->levels[l]));
+    }
+    if (totals->truncated > 0) printf("%lld files end with a cut off record\n", totals->truncated);
+}
+
+//----------------------------------------------------------------------------------
+// Main entry point
+//----------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <session log> [more session logs]\n", argv[0]);
+        return 1;
+    }
+
+    SessionTotals totals = { 0 };
+    int failed = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!ReadSessionLog(argv[i], &totals)) ++failed;
+    }
+    PrintTotals(&totals);
+
+    return (failed > 0) ? 1 : 0;
+}
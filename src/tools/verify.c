@@ -0,0 +1,302 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   Golden state check, replays a corpus of games and compares hashes of their state
+*
+*   Every replay (see replay.c) gets simulated without a window and the state of its
+*   world hashed (HashWorldState()) every VERIFY_INTERVAL steps and after the last one.
+*   The hashes are compared with the golden values next to the replay, name.golden for
+*   name.replay, one "<step> <hash>" line each. Any change to how the game plays, from
+*   collisions to ship handling, changes a hash, the first step that differs tells when
+*   the game went off. A change that is meant to change the game runs --update to write
+*   the golden files again.
+*
+*   The replays are spread over worker threads, every worker takes the next replay that
+*   nobody runs yet. Run it from src like the game, the golden values depend on
+*   resources/definitions.txt as well. Hashes take the exact bits of floats, golden
+*   values made with one compiler or platform can differ on another.
+*
+*   usage: rasteroids_verify [--update] [--threads n] <replay | directory>...
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------------
+// Shared Variables Definition (global)
+// NOTE: The gameplay module links against these, the check doesn't use them
+//----------------------------------------------------------------------------------
+GameScreen currentScreen = SCREEN_GAMEPLAY;
+Font smallFont = { 0 };
+Font largeFont = { 0 };
+Sound sounds[SOUND_MAX] = { 0 };
+ControlMap controlMap = { 0 };
+int lastGameScore = 0;
+HighscoreTable highscores = { 0 };
+
+//----------------------------------------------------------------------------------
+// Verify Definition
+//----------------------------------------------------------------------------------
+#define VERIFY_INTERVAL 60              // Steps between hashes
+#define VERIFY_MAX_THREADS 64
+#define VERIFY_PATH_SIZE 512
+
+typedef enum {
+    VERIFY_PASSED = 0,
+    VERIFY_UPDATED,
+    VERIFY_DRIFTED,                     // A hash differs from the golden value
+    VERIFY_FAILED,                      // Replay or golden file missing or broken
+} VerifyStatus;
+
+typedef struct VerifyJob {
+    char replayFile[VERIFY_PATH_SIZE];
+    char goldenFile[VERIFY_PATH_SIZE];
+    VerifyStatus status;
+    int stepCount;
+    int step;                           // Of the first hash that differs
+    unsigned int expected;
+    unsigned int actual;
+    char message[128];
+} VerifyJob;
+
+typedef struct VerifyRun {
+    VerifyJob* jobs;
+    int jobCount;
+    int nextJob;                        // Taken by the workers with an atomic add
+    bool update;
+} VerifyRun;
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+static double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Reads the "<step> <hash>" lines, returns the amount of hashes in the file, of which
+// up to maxHashes are kept, or -1
+static int LoadGoldenHashes(const char* fileName, int* steps, unsigned int* hashes, int maxHashes)
+{
+    char* text = LoadFileText(fileName);
+    if (text == NULL) return -1;
+
+    int count = 0;
+    for (const char* line = text; *line != '\0'; ) {
+        int step = 0;
+        unsigned int hash = 0;
+        if (sscanf(line, "%d %x", &step, &hash) == 2) {
+            if (count < maxHashes) {
+                steps[count] = step;
+                hashes[count] = hash;
+            }
+            ++count;
+        }
+        line = strchr(line, '\n');
+        if (line == NULL) break;
+        ++line;
+    }
+    UnloadFileText(text);
+    return count;
+}
+
+static bool SaveGoldenHashes(const char* fileName, const int* steps, const unsigned int* hashes, int count)
+{
+    char* text = (char*)RL_MALLOC(count * 24 + 1);
+    if (text == NULL) return false;
+    int length = 0;
+    text[0] = '\0';
+    for (int i = 0; i < count; ++i) {
+        length += sprintf(text + length, "%i %08x\n", steps[i], hashes[i]);
+    }
+    bool saved = SaveFileText(fileName, text);
+    RL_FREE(text);
+    return saved;
+}
+
+// Simulates one replay, hashing the world at the same steps the golden file lists
+static void RunJob(VerifyJob* job, bool update)
+{
+    Replay replay = { 0 };
+    if (!LoadReplay(job->replayFile, &replay)) {
+        job->status = VERIFY_FAILED;
+        snprintf(job->message, sizeof(job->message), "not a replay");
+        return;
+    }
+    int maxHashes = replay.stepCount / VERIFY_INTERVAL + 1;
+    int* steps = (int*)RL_MALLOC(2 * maxHashes * sizeof(int));
+    unsigned int* hashes = (unsigned int*)RL_MALLOC(2 * maxHashes * sizeof(unsigned int));
+    int* goldenSteps = steps + maxHashes;
+    unsigned int* goldenHashes = hashes + maxHashes;
+
+    int goldenCount = 0;
+    if (!update) {
+        goldenCount = LoadGoldenHashes(job->goldenFile, goldenSteps, goldenHashes, maxHashes);
+        if (goldenCount < 0) {
+            job->status = VERIFY_FAILED;
+            snprintf(job->message, sizeof(job->message), "no golden values, --update makes them");
+            RL_FREE(steps);
+            RL_FREE(hashes);
+            UnloadReplay(&replay);
+            return;
+        }
+    }
+
+    job->stepCount = replay.stepCount;
+    World* world = CreateWorld(replay.playerCount, replay.seed, VIEW_WIDTH, VIEW_HEIGHT);
+    int count = 0;
+    for (int step = 1; step <= replay.stepCount; ++step) {
+        int inputs[MAX_PLAYERS] = { 0 };
+        for (int p = 0; p < MAX_PLAYERS; ++p) {
+            inputs[p] = replay.steps[step - 1].inputs[p];
+        }
+        StepWorld(world, inputs, replay.steps[step - 1].dt);
+
+        if (step % VERIFY_INTERVAL != 0 && step != replay.stepCount) continue;
+        steps[count] = step;
+        hashes[count] = HashWorldState(world);
+        ++count;
+    }
+    DestroyWorld(world);
+
+    job->status = VERIFY_PASSED;
+    if (update) {
+        job->status = SaveGoldenHashes(job->goldenFile, steps, hashes, count) ? VERIFY_UPDATED : VERIFY_FAILED;
+        if (job->status == VERIFY_FAILED) snprintf(job->message, sizeof(job->message), "could not write the golden values");
+    }
+    else if (goldenCount != count) {
+        job->status = VERIFY_FAILED;
+        snprintf(job->message, sizeof(job->message), "%i golden values for %i hashes, the replay changed", goldenCount, count);
+    }
+    else {
+        for (int i = 0; i < count; ++i) {
+            if (goldenSteps[i] == steps[i] && goldenHashes[i] == hashes[i]) continue;
+            job->status = VERIFY_DRIFTED;
+            job->step = steps[i];
+            job->expected = goldenHashes[i];
+            job->actual = hashes[i];
+            break;
+        }
+    }
+
+    RL_FREE(steps);
+    RL_FREE(hashes);
+    UnloadReplay(&replay);
+}
+
+static void* RunJobs(void* arg)
+{
+    VerifyRun* run = (VerifyRun*)arg;
+    for (;;) {
+        int job = __atomic_fetch_add(&run->nextJob, 1, __ATOMIC_RELAXED);
+        if (job >= run->jobCount) break;
+        RunJob(&run->jobs[job], run->update);
+    }
+    return NULL;
+}
+
+static int CompareJobs(const void* a, const void* b)
+{
+    return strcmp(((const VerifyJob*)a)->replayFile, ((const VerifyJob*)b)->replayFile);
+}
+
+// name.replay gets name.golden
+static bool AddJob(VerifyRun* run, const char* replayFile)
+{
+    VerifyJob* jobs = (VerifyJob*)RL_REALLOC(run->jobs, (run->jobCount + 1) * sizeof(VerifyJob));
+    if (jobs == NULL) return false;
+    run->jobs = jobs;
+
+    VerifyJob* job = &run->jobs[run->jobCount++];
+    memset(job, 0, sizeof(VerifyJob));
+    snprintf(job->replayFile, sizeof(job->replayFile), "%s", replayFile);
+    int length = (int)strlen(replayFile);
+    if (IsFileExtension(replayFile, ".replay")) length -= (int)strlen(".replay");
+    snprintf(job->goldenFile, sizeof(job->goldenFile), "%.*s.golden", length, replayFile);
+    return true;
+}
+
+//----------------------------------------------------------------------------------
+// Main entry point
+//----------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    VerifyRun run = { 0 };
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; ++i) {
+        if (TextIsEqual(argv[i], "--update")) {
+            run.update = true;
+        }
+        else if (TextIsEqual(argv[i], "--threads") && i + 1 < argc) {
+            threadCount = TextToInteger(argv[++i]);
+        }
+        else if (DirectoryExists(argv[i])) {
+            FilePathList files = LoadDirectoryFilesEx(argv[i], ".replay", false);
+            for (unsigned int f = 0; f < files.count; ++f) {
+                AddJob(&run, files.paths[f]);
+            }
+            UnloadDirectoryFiles(files);
+        }
+        else {
+            AddJob(&run, argv[i]);
+        }
+    }
+    if (run.jobCount == 0) {
+        fprintf(stderr, "usage: %s [--update] [--threads n] <replay | directory>...\n", argv[0]);
+        return 1;
+    }
+    qsort(run.jobs, run.jobCount, sizeof(VerifyJob), CompareJobs);
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > VERIFY_MAX_THREADS) threadCount = VERIFY_MAX_THREADS;
+    if (threadCount > run.jobCount) threadCount = run.jobCount;
+
+    SetTraceLogLevel(LOG_WARNING);
+    InitGameLog();
+    LoadDefinitions("resources/definitions.txt");
+
+    // The first world scales the shared models, that has to happen before the workers
+    // create theirs at the same time
+    DestroyWorld(CreateWorld(1, 1, VIEW_WIDTH, VIEW_HEIGHT));
+
+    double start = GetSeconds();
+    pthread_t threads[VERIFY_MAX_THREADS];
+    for (int t = 0; t < threadCount; ++t) {
+        pthread_create(&threads[t], NULL, RunJobs, &run);
+    }
+    for (int t = 0; t < threadCount; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    double seconds = GetSeconds() - start;
+
+    int failed = 0;
+    long long steps = 0;
+    for (int i = 0; i < run.jobCount; ++i) {
+        const VerifyJob* job = &run.jobs[i];
+        steps += job->stepCount;
+        switch (job->status) {
+            case VERIFY_PASSED: printf("ok       %s, %i steps\n", job->replayFile, job->stepCount); break;
+            case VERIFY_UPDATED: printf("updated  %s, %i steps\n", job->replayFile, job->stepCount); break;
+            case VERIFY_DRIFTED: printf("DRIFTED  %s at step %i of %i, %08x instead of %08x\n", job->replayFile,
+                job->step, job->stepCount, job->actual, job->expected); break;
+            default: printf("FAILED   %s, %s\n", job->replayFile, job->message); break;
+        }
+        if (job->status == VERIFY_DRIFTED || job->status == VERIFY_FAILED) ++failed;
+    }
+    printf("%i of %i replays %s, %lld steps in %.2f s on %i threads\n", run.jobCount - failed, run.jobCount,
+        run.update ? "updated" : "passed", steps, seconds, threadCount);
+
+    RL_FREE(run.jobs);
+    CloseGameLog();
+    return (failed > 0) ? 1 : 0;
+}
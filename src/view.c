@@ -0,0 +1,114 @@
+/*******************************************************************************************
+*
+*   rAsteroids
+*   View, draws the fixed logical screen into a window of any size
+*
+*   Every screen simulates and draws in VIEW_WIDTH x VIEW_HEIGHT. By default the window
+*   has exactly that size and everything gets drawn straight into it. With a render height
+*   or in fullscreen the frame goes into a render texture of that height instead (the
+*   logical coordinates are scaled by a 2D camera), which then gets scaled to the window
+*   keeping the aspect ratio, with black bars on the sides that don't fit. A kiosk with a
+*   weak GPU can draw at 720 lines and still fill a 4K screen. The mouse gets mapped back
+*   to logical coordinates. The glow (glow.c) needs the frame in a texture as well, while
+*   it is on the frame goes into one at the logical size.
+*
+********************************************************************************************/
+
+#include "raylib.h"
+#include "screens.h"
+
+//----------------------------------------------------------------------------------
+// View Definition
+//----------------------------------------------------------------------------------
+typedef struct View {
+    bool offscreen;             // Scaled, always drawn into the render texture
+    bool drawing;               // Into the render texture, this frame
+    int renderHeight;
+    RenderTexture2D target;     // Made when it is first needed
+    Camera2D camera;            // Logical to render texture coordinates
+    Rectangle dest;             // Of the texture in the window, updated every frame
+} View;
+
+static View view = { 0 };
+
+//----------------------------------------------------------------------------------
+// Local Functions
+//----------------------------------------------------------------------------------
+
+// Largest rectangle of the logical aspect ratio that fits centered into the window
+static Rectangle GetLetterbox(void)
+{
+    float width = (float)GetScreenWidth();
+    float height = (float)GetScreenHeight();
+    float scale = (width * VIEW_HEIGHT < height * VIEW_WIDTH) ? width / VIEW_WIDTH : height / VIEW_HEIGHT;
+    Rectangle dest = { 0, 0, VIEW_WIDTH * scale, VIEW_HEIGHT * scale };
+    dest.x = (width - dest.width) / 2.0f;
+    dest.y = (height - dest.height) / 2.0f;
+    return dest;
+}
+
+//----------------------------------------------------------------------------------
+// View Functions
+//----------------------------------------------------------------------------------
+
+// Opens the window. renderHeight 0 draws straight into a window of the logical size,
+// unless it is fullscreen, then the frame is drawn at the logical height
+void InitView(const char* title, int renderHeight, bool fullscreen)
+{
+    view.offscreen = renderHeight > 0 || fullscreen;
+    view.renderHeight = (renderHeight > 0) ? renderHeight : VIEW_HEIGHT;
+    if (view.offscreen) SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(VIEW_WIDTH, VIEW_HEIGHT, title);
+    if (!view.offscreen) return;
+
+    if (fullscreen) {
+        int monitor = GetCurrentMonitor();
+        SetWindowSize(GetMonitorWidth(monitor), GetMonitorHeight(monitor));
+        ToggleFullscreen();
+    }
+    TraceLog(LOG_INFO, "VIEW: Drawing %i lines, scaled to the window", view.renderHeight);
+}
+
+void UnloadView(void)
+{
+    if (view.target.id != 0) UnloadRenderTexture(view.target);
+    view = (View){ 0 };
+}
+
+// Call right after BeginDrawing(), the frame goes into the render texture from here on
+void BeginView(void)
+{
+    view.drawing = view.offscreen || IsGlowEnabled();
+    if (!view.drawing) return;
+
+    if (view.target.id == 0) {
+        int renderWidth = view.renderHeight * VIEW_WIDTH / VIEW_HEIGHT;
+        view.target = LoadRenderTexture(renderWidth, view.renderHeight);
+        SetTextureFilter(view.target.texture, TEXTURE_FILTER_BILINEAR);
+        view.camera = (Camera2D){ .zoom = (float)view.renderHeight / VIEW_HEIGHT };
+    }
+
+    // The window can change its size any time
+    view.dest = GetLetterbox();
+    SetMouseOffset((int)-view.dest.x, (int)-view.dest.y);
+    SetMouseScale(VIEW_WIDTH / view.dest.width, VIEW_HEIGHT / view.dest.height);
+
+    BeginTextureMode(view.target);
+    BeginMode2D(view.camera);
+}
+
+// Call right before EndDrawing(), scales the render texture into the window and adds
+// the glow
+void EndView(void)
+{
+    if (!view.drawing) return;
+
+    EndMode2D();
+    EndTextureMode();
+
+    // Render textures are upside down
+    Rectangle source = { 0, 0, (float)view.target.texture.width, -(float)view.target.texture.height };
+    ClearBackground(BLACK);
+    DrawTexturePro(view.target.texture, source, view.dest, (Vector2){ 0, 0 }, 0.0f, WHITE);
+    DrawGlow(view.target.texture, view.dest, GetFrameTime());
+}